@@ -153,5 +153,19 @@
 # define isclr(a,i)	(((a)[(i)/NBBY] & (1<<((i)%NBBY))) == 0)
 #endif
 
+/*
+ * Byte-wise tests for 64-bit words, all return non-zero if any byte in the
+ * word @w matches. Useful to scan strings by words rather than by bytes.
+ */
+#define UL_WORD_ONES	0x0101010101010101ULL
+#define UL_WORD_HIGHS	0x8080808080808080ULL
+
+/* any byte less than @n (where n <= 0x80) */
+#define ul_word_has_less(w, n)	(((w) - UL_WORD_ONES * (n)) & ~(w) & UL_WORD_HIGHS)
+/* any byte equal to @c */
+#define ul_word_has_byte(w, c)	ul_word_has_less((w) ^ (UL_WORD_ONES * (c)), 1)
+/* any byte with the highest bit set */
+#define ul_word_has_high(w)	((w) & UL_WORD_HIGHS)
+
 #endif /* BITOPS_H */
 
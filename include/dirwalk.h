@@ -0,0 +1,66 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_DIRWALK_H
+#define UTIL_LINUX_DIRWALK_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* ul_dirwalk() mask, see statx(2) */
+#ifndef STATX_TYPE
+# define STATX_TYPE		0x00000001U
+# define STATX_MODE		0x00000002U
+# define STATX_NLINK		0x00000004U
+# define STATX_UID		0x00000008U
+# define STATX_GID		0x00000010U
+# define STATX_ATIME		0x00000020U
+# define STATX_MTIME		0x00000040U
+# define STATX_CTIME		0x00000080U
+# define STATX_INO		0x00000100U
+# define STATX_SIZE		0x00000200U
+# define STATX_BLOCKS		0x00000400U
+# define STATX_BASIC_STATS	0x000007ffU
+#endif
+
+/**
+ * struct ul_dirwalk_entry - Information about a file for ul_dirwalk() callback
+ * @path:  The path of the file (root path + relative path)
+ * @base:  The offset of the basename in @path
+ * @level: Depth of the file, 0 for the root
+ * @type:  UL_DIRWALK_{FILE,DIR,DNR,NS}
+ * @err:   errno for UL_DIRWALK_DNR and UL_DIRWALK_NS
+ * @st:    The stat information, only the fields requested by the mask
+ *         (and st_dev, st_ino, st_mode) are valid
+ */
+struct ul_dirwalk_entry {
+	const char *path;
+	size_t base;
+	size_t level;
+	int type;
+	int err;
+	struct stat st;
+};
+
+enum {
+	UL_DIRWALK_FILE = 0,	/* not a directory */
+	UL_DIRWALK_DIR,		/* directory, called before the directory is read */
+	UL_DIRWALK_DNR,		/* unreadable directory */
+	UL_DIRWALK_NS		/* stat failed */
+};
+
+/* ul_dirwalk() flags */
+#define UL_DIRWALK_MOUNT	(1 << 0)	/* stay within the same filesystem */
+#define UL_DIRWALK_REGONLY	(1 << 1)	/* report only regular files and directories */
+
+/* callback return codes, negative number stops the walk */
+#define UL_DIRWALK_CONTINUE	0
+#define UL_DIRWALK_SKIP		1		/* don't read the directory */
+
+typedef int (*ul_dirwalk_callback)(struct ul_dirwalk_entry *ent, void *data);
+
+extern int ul_dirwalk(const char *root, int flags, unsigned int mask,
+		      size_t nthreads, ul_dirwalk_callback cb, void *data);
+
+#endif /* UTIL_LINUX_DIRWALK_H */
@@ -7,6 +7,7 @@
 #define UTIL_LINUX_FILEEQ
 
 #include <stdlib.h>
+#include <sys/types.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -23,6 +24,7 @@ struct ul_fileeq_data {
 	unsigned char *blocks;
 	size_t nblocks;
 	size_t maxblocks;
+	size_t readsiz;		/* size of the block hashed to one digest */
 	int fd;
 	const char *name;
 	bool is_eof;
@@ -53,6 +55,17 @@ extern void ul_fileeq_data_init(struct ul_fileeq_data *data);
 extern void ul_fileeq_data_deinit(struct ul_fileeq_data *data);
 extern void ul_fileeq_data_set_file(struct ul_fileeq_data *data,
 				    const char *name);
+extern ssize_t ul_fileeq_data_get_digests(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				const unsigned char **intro,
+				const unsigned char **digests,
+				size_t *readsiz, bool *is_eof);
+extern int ul_fileeq_data_set_digests(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				const unsigned char *intro,
+				const unsigned char *digests, size_t ndigests,
+				size_t readsiz, bool is_eof);
+extern size_t ul_fileeq_get_digest_size(struct ul_fileeq *eq);
 extern size_t ul_fileeq_set_size(struct ul_fileeq *eq, uint64_t filesiz,
                                  size_t readsiz, size_t memsiz);
 
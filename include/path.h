@@ -25,6 +25,21 @@ struct path_cxt {
 	void	*dialect;
 	void	(*free_dialect)(struct path_cxt *);
 	int	(*redirect_on_enoent)(struct path_cxt *, const char *, int *);
+
+	char	*attrs_buffer;		/* scratch buffer for ul_path_read_attrs() */
+	size_t	attrs_bufsz;
+};
+
+/*
+ * Attribute for ul_path_read_attrs(). The caller sets @name, the function
+ * sets @rc (size of the value or negative errno) and @value (the value
+ * without the trailing newline, or NULL on error).
+ */
+struct ul_path_attr {
+	const char	*name;
+
+	int		rc;
+	const char	*value;
 };
 
 struct path_cxt *ul_new_path(const char *dir, ...)
@@ -98,6 +113,17 @@ int ul_path_readf_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const cha
 int ul_path_vreadf_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const char *path, va_list ap)
 				__attribute__ ((__format__ (__printf__, 4, 0)));
 
+int ul_path_read_attrs(struct path_cxt *pc, struct ul_path_attr *attrs, size_t nattrs,
+			const char *dir);
+int ul_path_readf_attrs(struct path_cxt *pc, struct ul_path_attr *attrs, size_t nattrs,
+			const char *dir, ...)
+				__attribute__ ((__format__ (__printf__, 4, 5)));
+
+int ul_path_attr_s32(const struct ul_path_attr *attr, int32_t *res);
+int ul_path_attr_u32(const struct ul_path_attr *attr, uint32_t *res);
+int ul_path_attr_s64(const struct ul_path_attr *attr, int64_t *res);
+int ul_path_attr_u64(const struct ul_path_attr *attr, uint64_t *res);
+
 int ul_path_scanf(struct path_cxt *pc, const char *path, const char *fmt, ...)
 				__attribute__ ((__format__ (__scanf__, 3, 4)));
 int ul_path_scanff(struct path_cxt *pc, const char *path, va_list ap, const char *fmt, ...)
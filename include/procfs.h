@@ -61,6 +61,64 @@ extern int procfs_dirent_match_uid(DIR *procfs, struct dirent *d, uid_t uid);
 extern int procfs_dirent_get_name(DIR *procfs, struct dirent *d, char *buf, size_t bufsz);
 extern int procfs_dirent_match_name(DIR *procfs, struct dirent *d, const char *name);
 
+/*
+ * procfs_snapshot -- all processes read by one /proc walk
+ *
+ * The data are stored in arrays indexed by the process index (0..nprocs-1);
+ * only arrays requested by the mask are allocated. The processes are sorted
+ * by PID.
+ */
+enum {
+	PROCFS_NS_CGROUP = 0,
+	PROCFS_NS_IPC,
+	PROCFS_NS_MNT,
+	PROCFS_NS_NET,
+	PROCFS_NS_PID,
+	PROCFS_NS_TIME,
+	PROCFS_NS_USER,
+	PROCFS_NS_UTS,
+
+	PROCFS_NS_NTYPES
+};
+
+#define PROCFS_SNAP_STAT	(1 << 0)	/* ppids[] and states[] */
+#define PROCFS_SNAP_UID		(1 << 1)	/* uids[] */
+#define PROCFS_SNAP_COMM	(1 << 2)	/* comms[] */
+#define PROCFS_SNAP_NS		(1 << 3)	/* ns_inos[][] */
+
+#define PROCFS_COMM_SIZE	64	/* kworkers have long names */
+
+/* Called by the walker threads for every process while the process is pinned;
+ * @pc is initialized for /proc/<pid>. The returned data (or NULL) is stored in
+ * procfs_snapshot->priv[] and deallocated by free(). */
+typedef void *(*procfs_snapshot_reader)(struct path_cxt *pc, pid_t pid, void *data);
+
+struct procfs_snapshot {
+	int	mask;		/* PROCFS_SNAP_* */
+	size_t	nprocs;
+
+	pid_t	*pids;
+	pid_t	*ppids;
+	char	*states;
+	uid_t	*uids;
+	char	(*comms)[PROCFS_COMM_SIZE];
+	ino_t	*ns_inos[PROCFS_NS_NTYPES];	/* 0 if not available */
+
+	size_t	*ns_index[PROCFS_NS_NTYPES];	/* process indexes sorted by ns inode */
+
+	void	**priv;		/* returned by procfs_snapshot_reader */
+};
+
+extern const char *procfs_ns_type_to_name(int type);
+
+extern struct procfs_snapshot *ul_new_procfs_snapshot(int mask, size_t nworkers);
+extern struct procfs_snapshot *ul_new_procfs_snapshot_reader(int mask, size_t nworkers,
+				procfs_snapshot_reader reader, void *data);
+extern void ul_free_procfs_snapshot(struct procfs_snapshot *snap);
+extern ssize_t procfs_snapshot_find_pid(struct procfs_snapshot *snap, pid_t pid);
+extern size_t procfs_snapshot_get_ns_procs(struct procfs_snapshot *snap,
+				int type, ino_t ino, const size_t **idxs);
+
 extern int fd_is_procfs(int fd);
 extern char *pid_get_cmdname(pid_t pid);
 extern char *pid_get_cmdline(pid_t pid);
@@ -10,8 +10,11 @@
 
 void ul_buffer_reset_data(struct ul_buffer *buf)
 {
-	if (buf->begin)
-		memset(buf->begin, 0, buf->sz);
+	/* The area behind the data is always zeroized (see
+	 * ul_buffer_alloc_data()), so it's enough to reset the data and the
+	 * terminator rather than the whole allocated buffer. */
+	if (buf->begin && buf->end)
+		memset(buf->begin, 0, min((size_t) (buf->end - buf->begin) + 1, buf->sz));
 	buf->end = buf->begin;
 
 	if (buf->ptrs && buf->nptrs)
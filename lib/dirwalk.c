@@ -0,0 +1,609 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * dirwalk -- walk a directory tree, an alternative to nftw() for large trees.
+ *
+ * The directories are read by getdents64() with a large buffer, and d_type
+ * is used to skip stat() for files the caller is not interested in. The
+ * entries of the directory are sorted by inode number (to improve disk
+ * locality) and stat-ed by statx() with only the fields requested by the
+ * caller. Only one directory is open at the same time in each thread.
+ *
+ * The subdirectories are queued and read by a pool of threads. The callback
+ * is never called concurrently, but the order of the files is undefined if
+ * more than one thread is used. The callback is called for a directory
+ * before the directory is read, so it's possible to skip the subtree.
+ *
+ * Example:
+ *
+ *	static int cb(struct ul_dirwalk_entry *ent, void *data)
+ *	{
+ *		if (ent->type == UL_DIRWALK_FILE)
+ *			printf("%s %ju\n", ent->path, (uintmax_t) ent->st.st_size);
+ *		return UL_DIRWALK_CONTINUE;
+ *	}
+ *
+ *	ul_dirwalk("/usr", UL_DIRWALK_REGONLY, STATX_SIZE, 0, cb, NULL);
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/sysmacros.h>
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#include "c.h"
+#include "xalloc.h"
+#include "fileutils.h"
+#include "dirwalk.h"
+
+#define DIRWALK_MAX_WORKERS	16
+#define DIRWALK_BUFSIZ		(256 * 1024)	/* getdents64() buffer */
+
+#if defined(HAVE_STATX) && defined(HAVE_STRUCT_STATX)
+# define USE_DIRWALK_STATX	1
+#endif
+
+#ifdef SYS_getdents64
+struct linux_dirent64 {
+	uint64_t	d_ino;
+	int64_t		d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char		d_name[];
+};
+#endif
+
+/* directory entry as returned by getdents64() */
+struct dw_entry {
+	ino_t ino;
+	unsigned char type;
+	size_t name;		/* offset in dw_worker->names */
+};
+
+/* queued directory */
+struct dw_dir {
+	struct dw_dir *next;
+	size_t level;
+	char path[];
+};
+
+/* per-thread buffers */
+struct dw_worker {
+	char *buf;		/* getdents64() buffer */
+
+	struct dw_entry *ents;
+	size_t nents;
+	size_t maxents;
+
+	char *names;
+	size_t namesz;
+	size_t maxnames;
+
+	char *path;
+	size_t maxpath;
+};
+
+struct dw_walk {
+	int flags;
+	unsigned int mask;
+	dev_t rootdev;
+	bool nostatx;		/* statx() not supported */
+
+	ul_dirwalk_callback cb;
+	void *data;
+	int cbrc;		/* the callback requested stop */
+
+	struct dw_dir *queue;	/* directories to read */
+	size_t nbusy;		/* number of directories being read */
+	int rc;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t mutex;	/* protects @queue, @nbusy and @rc */
+	pthread_cond_t cond;
+	pthread_mutex_t cbmutex; /* serializes callbacks, protects @cbrc */
+#endif
+};
+
+static int call_callback(struct dw_walk *walk, struct ul_dirwalk_entry *ent)
+{
+	int rc;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&walk->cbmutex);
+#endif
+	rc = walk->cbrc;
+	if (rc >= 0) {
+		rc = walk->cb(ent, walk->data);
+		if (rc < 0)
+			walk->cbrc = rc;
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&walk->cbmutex);
+#endif
+	return rc;
+}
+
+#ifdef USE_DIRWALK_STATX
+static void statx_to_stat(const struct statx *stx, struct stat *st)
+{
+	memset(st, 0, sizeof(*st));
+
+	st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+	st->st_ino = stx->stx_ino;
+	st->st_mode = stx->stx_mode;
+	st->st_nlink = stx->stx_nlink;
+	st->st_uid = stx->stx_uid;
+	st->st_gid = stx->stx_gid;
+	st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+	st->st_size = stx->stx_size;
+	st->st_blksize = stx->stx_blksize;
+	st->st_blocks = stx->stx_blocks;
+	st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+	st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+	st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+	st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+	st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+	st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+#endif
+
+static int stat_entry(struct dw_walk *walk, int dirfd, const char *name,
+		      struct stat *st)
+{
+#ifdef USE_DIRWALK_STATX
+	if (!walk->nostatx) {
+		struct statx stx;
+
+		if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+			  walk->mask, &stx) != 0)
+			return -errno;
+		statx_to_stat(&stx, st);
+		return 0;
+	}
+#endif
+	if (fstatat(dirfd, name, st, AT_SYMLINK_NOFOLLOW) != 0)
+		return -errno;
+	return 0;
+}
+
+static void add_entry(struct dw_worker *w, ino_t ino, unsigned char type,
+		      const char *name)
+{
+	size_t sz;
+
+	if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+		return;
+
+	if (w->nents == w->maxents) {
+		w->maxents = w->maxents ? w->maxents * 2 : 256;
+		w->ents = xreallocarray(w->ents, w->maxents, sizeof(*w->ents));
+	}
+
+	sz = strlen(name) + 1;
+	if (w->namesz + sz > w->maxnames) {
+		w->maxnames = max(w->maxnames * 2, w->namesz + sz);
+		w->names = xrealloc(w->names, w->maxnames);
+	}
+	memcpy(w->names + w->namesz, name, sz);
+
+	w->ents[w->nents].ino = ino;
+	w->ents[w->nents].type = type;
+	w->ents[w->nents].name = w->namesz;
+	w->nents++;
+	w->namesz += sz;
+}
+
+/* read all entries of the directory to worker's buffers */
+static int read_entries(struct dw_worker *w, int fd)
+{
+	w->nents = 0;
+	w->namesz = 0;
+
+#ifdef SYS_getdents64
+	if (!w->buf)
+		w->buf = xmalloc(DIRWALK_BUFSIZ);
+
+	while (1) {
+		long n = syscall(SYS_getdents64, fd, w->buf, DIRWALK_BUFSIZ);
+		long off;
+
+		if (n < 0)
+			return -errno;
+		if (n == 0)
+			break;
+
+		for (off = 0; off < n; ) {
+			struct linux_dirent64 *d =
+				(struct linux_dirent64 *) (w->buf + off);
+
+			add_entry(w, d->d_ino, d->d_type, d->d_name);
+			off += d->d_reclen;
+		}
+	}
+#else
+	{
+		struct dirent *d;
+		DIR *dir;
+		int dupfd = dup_fd_cloexec(fd, STDERR_FILENO + 1);
+
+		if (dupfd < 0)
+			return -errno;
+		dir = fdopendir(dupfd);
+		if (!dir) {
+			close(dupfd);
+			return -errno;
+		}
+		while ((d = readdir(dir)))
+			add_entry(w, d->d_ino, d->d_type, d->d_name);
+		closedir(dir);
+	}
+#endif
+	return 0;
+}
+
+static int cmp_entries_ino(const void *a, const void *b)
+{
+	const struct dw_entry *ea = a, *eb = b;
+
+	return ea->ino < eb->ino ? -1 : ea->ino > eb->ino ? 1 : 0;
+}
+
+static const char *entry_path(struct dw_worker *w, const char *dir,
+			      const char *name, size_t *base)
+{
+	size_t dsz = strlen(dir), nsz = strlen(name);
+	bool slash = dsz && dir[dsz - 1] != '/';
+
+	if (dsz + slash + nsz + 1 > w->maxpath) {
+		w->maxpath = dsz + slash + nsz + 1 + 256;
+		w->path = xrealloc(w->path, w->maxpath);
+	}
+	memcpy(w->path, dir, dsz);
+	if (slash)
+		w->path[dsz] = '/';
+	memcpy(w->path + dsz + slash, name, nsz + 1);
+
+	*base = dsz + slash;
+	return w->path;
+}
+
+static struct dw_dir *new_dir(const char *path, size_t level)
+{
+	size_t sz = strlen(path) + 1;
+	struct dw_dir *d = xmalloc(sizeof(*d) + sz);
+
+	d->next = NULL;
+	d->level = level;
+	memcpy(d->path, path, sz);
+	return d;
+}
+
+/*
+ * Reads the directory and calls the callback for all entries. The
+ * subdirectories are returned in @subdirs, sorted by inode numbers.
+ */
+static int process_dir(struct dw_walk *walk, struct dw_worker *w,
+		       struct dw_dir *dir, struct dw_dir **subdirs)
+{
+	struct dw_dir *last = NULL;
+	struct ul_dirwalk_entry ent;
+	size_t i;
+	int fd, rc, err;
+
+	*subdirs = NULL;
+
+	fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC
+			     | (dir->level ? O_NOFOLLOW : 0));
+	rc = fd < 0 ? -errno : read_entries(w, fd);
+	if (rc < 0) {
+		memset(&ent, 0, sizeof(ent));
+		ent.path = dir->path;
+		ent.base = strrchr(dir->path, '/') ?
+				strrchr(dir->path, '/') - dir->path + 1 : 0;
+		ent.level = dir->level;
+		ent.type = UL_DIRWALK_DNR;
+		ent.err = -rc;
+		if (fd >= 0)
+			close(fd);
+		return min(call_callback(walk, &ent), 0);
+	}
+
+	qsort(w->ents, w->nents, sizeof(*w->ents), cmp_entries_ino);
+	rc = 0;
+
+	for (i = 0; i < w->nents; i++) {
+		struct dw_entry *e = &w->ents[i];
+		const char *name = w->names + e->name;
+
+		if ((walk->flags & UL_DIRWALK_REGONLY)
+		    && e->type != DT_REG && e->type != DT_DIR
+		    && e->type != DT_UNKNOWN)
+			continue;
+
+		memset(&ent, 0, sizeof(ent));
+		ent.path = entry_path(w, dir->path, name, &ent.base);
+		ent.level = dir->level + 1;
+
+		err = stat_entry(walk, fd, name, &ent.st);
+		if (err < 0) {
+			if (err == -ENOENT)
+				continue;	/* removed in the meantime */
+			ent.type = UL_DIRWALK_NS;
+			ent.err = -err;
+		} else if (S_ISDIR(ent.st.st_mode))
+			ent.type = UL_DIRWALK_DIR;
+		else if ((walk->flags & UL_DIRWALK_REGONLY) && !S_ISREG(ent.st.st_mode))
+			continue;
+		else
+			ent.type = UL_DIRWALK_FILE;
+
+		if (ent.type != UL_DIRWALK_NS
+		    && (walk->flags & UL_DIRWALK_MOUNT)
+		    && ent.st.st_dev != walk->rootdev)
+			continue;
+
+		rc = call_callback(walk, &ent);
+		if (rc < 0)
+			break;
+		if (ent.type == UL_DIRWALK_DIR && rc != UL_DIRWALK_SKIP) {
+			struct dw_dir *d = new_dir(ent.path, ent.level);
+
+			if (last)
+				last->next = d;
+			else
+				*subdirs = d;
+			last = d;
+		}
+	}
+
+	close(fd);
+	return min(rc, 0);
+}
+
+static struct dw_dir *next_dir(struct dw_walk *walk)
+{
+	struct dw_dir *d = NULL;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&walk->mutex);
+	while (!walk->queue && walk->nbusy && walk->rc >= 0)
+		pthread_cond_wait(&walk->cond, &walk->mutex);
+#endif
+	if (walk->queue && walk->rc >= 0) {
+		d = walk->queue;
+		walk->queue = d->next;
+		walk->nbusy++;
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&walk->mutex);
+#endif
+	return d;
+}
+
+static void done_dir(struct dw_walk *walk, struct dw_dir *subdirs, int rc)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&walk->mutex);
+#endif
+	if (subdirs) {
+		struct dw_dir *last = subdirs;
+
+		/* depth-first, keep the order of the inodes */
+		while (last->next)
+			last = last->next;
+		last->next = walk->queue;
+		walk->queue = subdirs;
+	}
+	if (rc < 0)
+		walk->rc = rc;
+	walk->nbusy--;
+#ifdef HAVE_LIBPTHREAD
+	pthread_cond_broadcast(&walk->cond);
+	pthread_mutex_unlock(&walk->mutex);
+#endif
+}
+
+static void *dirwalk_worker(void *data)
+{
+	struct dw_walk *walk = data;
+	struct dw_worker w = { 0 };
+	struct dw_dir *dir;
+
+	while ((dir = next_dir(walk))) {
+		struct dw_dir *subdirs = NULL;
+		int rc = process_dir(walk, &w, dir, &subdirs);
+
+		free(dir);
+		done_dir(walk, subdirs, rc);
+	}
+
+	free(w.buf);
+	free(w.ents);
+	free(w.names);
+	free(w.path);
+	return NULL;
+}
+
+/**
+ * ul_dirwalk:
+ * @root: file or directory
+ * @flags: UL_DIRWALK_* flags
+ * @mask: STATX_* fields required in &struct ul_dirwalk_entry.st
+ * @nthreads: number of threads, 0 means number of online CPUs (max 16)
+ * @cb: callback
+ * @data: callback data
+ *
+ * Calls @cb for @root and for all files in the @root directory tree. The
+ * symbolic links are not followed. The callback is not called for other
+ * files than regular files and directories if UL_DIRWALK_REGONLY is
+ * specified, and it's not called for files on other filesystems if
+ * UL_DIRWALK_MOUNT is specified.
+ *
+ * The callback returns UL_DIRWALK_CONTINUE, UL_DIRWALK_SKIP to not read
+ * the directory, or a negative number to stop the walk.
+ *
+ * Returns: 0 or the negative number returned by the callback.
+ */
+int ul_dirwalk(const char *root, int flags, unsigned int mask,
+	       size_t nthreads, ul_dirwalk_callback cb, void *data)
+{
+	struct dw_walk walk = {
+		.flags = flags,
+		.mask = mask | STATX_TYPE | STATX_INO,
+		.cb = cb,
+		.data = data,
+#ifdef HAVE_LIBPTHREAD
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+		.cbmutex = PTHREAD_MUTEX_INITIALIZER
+#endif
+	};
+	struct ul_dirwalk_entry ent = { .path = root };
+	const char *p = strrchr(root, '/');
+	int rc;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t *threads = NULL;
+	size_t i;
+#endif
+
+	ent.base = p ? (size_t) (p - root) + 1 : 0;
+
+	rc = stat_entry(&walk, AT_FDCWD, root, &ent.st);
+#ifdef USE_DIRWALK_STATX
+	if (rc == -ENOSYS || rc == -EOPNOTSUPP || rc == -EINVAL) {
+		walk.nostatx = 1;
+		rc = stat_entry(&walk, AT_FDCWD, root, &ent.st);
+	}
+#endif
+	if (rc < 0) {
+		ent.type = UL_DIRWALK_NS;
+		ent.err = -rc;
+		return min(cb(&ent, data), 0);
+	}
+
+	if (S_ISDIR(ent.st.st_mode))
+		ent.type = UL_DIRWALK_DIR;
+	else if ((flags & UL_DIRWALK_REGONLY) && !S_ISREG(ent.st.st_mode))
+		return 0;
+	else
+		ent.type = UL_DIRWALK_FILE;
+
+	walk.rootdev = ent.st.st_dev;
+
+	rc = cb(&ent, data);
+	if (rc < 0 || ent.type != UL_DIRWALK_DIR || rc == UL_DIRWALK_SKIP)
+		return min(rc, 0);
+
+	walk.queue = new_dir(root, 0);
+
+#ifdef HAVE_LIBPTHREAD
+	if (nthreads == 0) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nthreads = ncpus > 0 ? (size_t) ncpus : 1;
+	}
+	nthreads = min(nthreads, (size_t) DIRWALK_MAX_WORKERS);
+
+	/* the current thread works too */
+	if (nthreads > 1)
+		threads = xcalloc(nthreads - 1, sizeof(*threads));
+	for (i = 0; i + 1 < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, dirwalk_worker, &walk) != 0)
+			break;
+	}
+	nthreads = i;
+#endif
+	dirwalk_worker(&walk);
+#ifdef HAVE_LIBPTHREAD
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+#endif
+	/* stopped by the callback */
+	while (walk.queue) {
+		struct dw_dir *d = walk.queue;
+
+		walk.queue = d->next;
+		free(d);
+	}
+	return min(walk.rc, 0);
+}
+
+#ifdef TEST_PROGRAM_DIRWALK
+# include <getopt.h>
+
+struct print_data {
+	size_t count;
+	const char *skip;	/* don't read directories of this name */
+};
+
+static int print_entry(struct ul_dirwalk_entry *ent, void *data)
+{
+	struct print_data *pd = data;
+
+	pd->count++;
+
+	switch (ent->type) {
+	case UL_DIRWALK_DNR:
+	case UL_DIRWALK_NS:
+		warnx("%s: %s", ent->path, strerror(ent->err));
+		break;
+	case UL_DIRWALK_DIR:
+		printf("%s/\n", ent->path);
+		if (pd->skip && strcmp(ent->path + ent->base, pd->skip) == 0)
+			return UL_DIRWALK_SKIP;
+		break;
+	default:
+		printf("%s %ju\n", ent->path, (uintmax_t) ent->st.st_size);
+		break;
+	}
+	return UL_DIRWALK_CONTINUE;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longopts[] = {
+		{ "mount",    no_argument,       NULL, 'x' },
+		{ "regular",  no_argument,       NULL, 'r' },
+		{ "skip",     required_argument, NULL, 's' },
+		{ "threads",  required_argument, NULL, 't' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct print_data pd = { .count = 0 };
+	size_t nthreads = 1;
+	int c, flags = 0;
+
+	while ((c = getopt_long(argc, argv, "xrs:t:", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'x':
+			flags |= UL_DIRWALK_MOUNT;
+			break;
+		case 'r':
+			flags |= UL_DIRWALK_REGONLY;
+			break;
+		case 's':
+			pd.skip = optarg;
+			break;
+		case 't':
+			nthreads = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			errx(EXIT_FAILURE, "usage: %s [--mount] [--regular] "
+					   "[--skip <name>] [--threads <num>] <path> ...",
+					   program_invocation_short_name);
+		}
+	}
+
+	for (; optind < argc; optind++)
+		ul_dirwalk(argv[optind], flags, STATX_SIZE, nthreads,
+			   print_entry, &pd);
+
+	fprintf(stderr, "%zu entries\n", pd.count);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_DIRWALK */
@@ -24,6 +24,11 @@
  *  send to the kernel hash functions (sha1, ...), and only hash digest is read
  *  and cached in userspace. Fast for large set of (large) files.
  *
+ *  * xxh3: data blocks are read to userspace and hashed by XXH3-128 (AVX2
+ *  variant is selected at runtime if supported by CPU), only digests are
+ *  cached. No syscall per digest. The hash is not collision resistant, so
+ *  content of the files is compared by memcmp() when all digests match.
+ *
  *
  * No copyright is claimed.  This code is in the public domain; do with
  * it what you wish.
@@ -50,6 +55,18 @@
 #include "fileeq.h"
 #include "debug.h"
 
+/* XXH3, AVX2 code is compiled in and selected at runtime on x86-64 */
+#if defined(__x86_64__) && defined(__GNUC__)
+# include <immintrin.h>
+# define USE_FILEEQ_XXH3_AVX2	1
+# define XXH_DISPATCH_AVX2	1
+# define XXH_TARGET_AVX2	__attribute__((__target__("avx2")))
+# define XXH_ACC_ALIGN		32
+#endif
+#define UL_WANT_XXH3
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
 static UL_DEBUG_DEFINE_MASK(ulfileeq);
 UL_DEBUG_DEFINE_MASKNAMES(ulfileeq) = UL_DEBUG_EMPTY_MASKNAMES;
 
@@ -73,6 +90,7 @@ static void ul_fileeq_init_debug(void)
 
 enum {
 	UL_FILEEQ_MEMCMP,
+	UL_FILEEQ_XXH3,
 	UL_FILEEQ_SHA1,
 	UL_FILEEQ_SHA256,
 	UL_FILEEQ_CRC32
@@ -83,12 +101,17 @@ struct ul_fileeq_method {
 	const char *kname;	/* name used by kernel crypto */
 	int id;
 	short digsiz;
+	bool verify;		/* compare content if digests match */
 };
 
 static const struct ul_fileeq_method ul_eq_methods[] = {
 	[UL_FILEEQ_MEMCMP] = {
 		.id = UL_FILEEQ_MEMCMP, .name = "memcmp"
 	},
+	[UL_FILEEQ_XXH3] = {
+		.id = UL_FILEEQ_XXH3, .name = "xxh3",
+		.digsiz = sizeof(XXH128_canonical_t), .verify = true
+	},
 #ifdef USE_FILEEQ_CRYPTOAPI
 	[UL_FILEEQ_SHA1] = {
 		.id = UL_FILEEQ_SHA1, .name = "sha1",
@@ -106,6 +129,43 @@ static const struct ul_fileeq_method ul_eq_methods[] = {
 #endif
 };
 
+typedef XXH128_hash_t (*xxh3_func_t)(const void *, size_t);
+
+static XXH128_hash_t xxh3_default(const void *data, size_t len)
+{
+	return XXH3_128bits(data, len);
+}
+
+#ifdef USE_FILEEQ_XXH3_AVX2
+static XXH_TARGET_AVX2 XXH128_hash_t xxh3_avx2(const void *data, size_t len)
+{
+	if (len <= XXH3_MIDSIZE_MAX)
+		return XXH3_128bits(data, len);
+
+	return XXH3_hashLong_128b_internal(data, len,
+				XXH3_kSecret, sizeof(XXH3_kSecret),
+				XXH3_accumulate_512_avx2, XXH3_scrambleAcc_avx2);
+}
+#endif
+
+static xxh3_func_t xxh3_func;
+
+static void init_xxh3(void)
+{
+	if (xxh3_func)
+		return;
+#ifdef USE_FILEEQ_XXH3_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		DBG(EQ, ul_debug("xxh3: using AVX2"));
+		xxh3_func = xxh3_avx2;
+		return;
+	}
+#endif
+	DBG(EQ, ul_debug("xxh3: using default"));
+	xxh3_func = xxh3_default;
+}
+
 #ifdef USE_FILEEQ_CRYPTOAPI
 static void deinit_crypto_api(struct ul_fileeq *eq)
 {
@@ -175,8 +235,10 @@ int ul_fileeq_init(struct ul_fileeq *eq, const char *method)
 
 	if (!eq->method)
 		return -1;
+	if (eq->method->id == UL_FILEEQ_XXH3)
+		init_xxh3();
 #ifdef USE_FILEEQ_CRYPTOAPI
-	if (eq->method->id != UL_FILEEQ_MEMCMP
+	if (eq->method->kname
 	    && init_crypto_api(eq) != 0)
 		return -1;
 #endif
@@ -229,12 +291,22 @@ void ul_fileeq_data_deinit(struct ul_fileeq_data *data)
 	data->blocks = NULL;
 	data->nblocks = 0;
 	data->maxblocks = 0;
+	data->readsiz = 0;
 	data->is_eof = 0;
 	data->name = NULL;
 
 	ul_fileeq_data_close_file(data);
 }
 
+#define get_cached_nblocks(_d) \
+			((_d)->nblocks ? (_d)->nblocks - 1 : 0)
+
+#define get_cached_offset(_e, _d) \
+			((_d)->nblocks == 0 ? 0 : \
+				sizeof((_d)->intro) \
+				+ (get_cached_nblocks(_d) * (_e)->readsiz))
+
+
 int ul_fileeq_data_associated(struct ul_fileeq_data *data)
 {
 	return data->name != NULL;
@@ -250,6 +322,77 @@ void ul_fileeq_data_set_file(struct ul_fileeq_data *data, const char *name)
 	data->name = name;
 }
 
+/*
+ * Returns the intro and the block digests cached for the file and the number
+ * of the digests, or a negative number if nothing is cached. The application
+ * may store the data and use them later by ul_fileeq_data_set_digests() to
+ * avoid reading the file again.
+ */
+ssize_t ul_fileeq_data_get_digests(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				const unsigned char **intro,
+				const unsigned char **digests,
+				size_t *readsiz, bool *is_eof)
+{
+	assert(eq);
+	assert(data);
+
+	if (!eq->method->digsiz || data->nblocks == 0)
+		return -EINVAL;
+
+	*intro = data->intro;
+	*digests = data->blocks;
+	*readsiz = data->readsiz;
+	*is_eof = data->is_eof;
+
+	return get_cached_nblocks(data);
+}
+
+/*
+ * Sets the intro and the block digests previously returned by
+ * ul_fileeq_data_get_digests(). The file has to be already set by
+ * ul_fileeq_data_set_file(), and the caller is responsible to use the data
+ * only if the file has not been modified since. The digests are ignored if
+ * @readsiz does not match the block size used for the comparison.
+ */
+int ul_fileeq_data_set_digests(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				const unsigned char *intro,
+				const unsigned char *digests, size_t ndigests,
+				size_t readsiz, bool is_eof)
+{
+	size_t sz;
+
+	assert(eq);
+	assert(data);
+
+	sz = eq->method->digsiz;
+	if (!sz || !ul_fileeq_data_associated(data) || data->nblocks)
+		return -EINVAL;
+
+	if (ndigests) {
+		data->blocks = malloc(ndigests * sz);
+		if (!data->blocks)
+			return -ENOMEM;
+		memcpy(data->blocks, digests, ndigests * sz);
+		data->maxblocks = ndigests;
+	}
+
+	DBG(DATA, ul_debugobj(data, "set %zu digests [readsiz=%zu]", ndigests, readsiz));
+	memcpy(data->intro, intro, sizeof(data->intro));
+	data->nblocks = ndigests + 1;
+	data->readsiz = readsiz;
+	data->is_eof = is_eof;
+	return 0;
+}
+
+/* Returns size of one digest, or 0 for the memcmp method */
+size_t ul_fileeq_get_digest_size(struct ul_fileeq *eq)
+{
+	assert(eq);
+	return eq->method->digsiz;
+}
+
 size_t ul_fileeq_set_size(struct ul_fileeq *eq, uint64_t filesiz,
 			 size_t readsiz, size_t memsiz)
 {
@@ -311,15 +454,6 @@ static unsigned char *get_buffer(struct ul_fileeq *eq)
 	return eq->buf_last;
 }
 
-#define get_cached_nblocks(_d) \
-			((_d)->nblocks ? (_d)->nblocks - 1 : 0)
-
-#define get_cached_offset(_e, _d) \
-			((_d)->nblocks == 0 ? 0 : \
-				sizeof((_d)->intro) \
-				+ (get_cached_nblocks(_d) * (_e)->readsiz))
-
-
 static int get_fd(struct ul_fileeq *eq, struct ul_fileeq_data *data, off_t *off)
 {
 	off_t o = get_cached_offset(eq, data);
@@ -397,7 +531,18 @@ static ssize_t read_block(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	return rsz;
 }
 
-#ifdef USE_FILEEQ_CRYPTOAPI
+/* drop digests calculated for another block size */
+static void reset_digests(struct ul_fileeq *eq, struct ul_fileeq_data *data)
+{
+	DBG(DATA, ul_debugobj(data, " reset digests [readsiz %zu->%zu]",
+				data->readsiz, eq->readsiz));
+	/* only intro[] is still valid */
+	data->nblocks = 1;
+	data->is_eof = 0;
+	/* reopen to seek after intro */
+	ul_fileeq_data_close_file(data);
+}
+
 static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 				size_t n, unsigned char **block)
 {
@@ -409,6 +554,9 @@ static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	if (n > eq->blocksmax)
 		return 0;
 
+	if (data->nblocks > 1 && data->readsiz != eq->readsiz)
+		reset_digests(eq, data);
+
 	/* return already cached if available */
 	if (n < get_cached_nblocks(data)) {
 		DBG(DATA, ul_debugobj(data, " digest cached"));
@@ -431,26 +579,54 @@ static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 
 	sz = eq->method->digsiz;
 
-	if (!data->blocks) {
+	if (data->maxblocks < eq->blocksmax) {
+		unsigned char *x;
+
 		DBG(DATA, ul_debugobj(data, "  alloc cache %" PRIu64, eq->blocksmax * sz));
-		data->blocks = malloc(eq->blocksmax * sz);
-		if (!data->blocks)
+		x = realloc(data->blocks, eq->blocksmax * sz);
+		if (!x)
 			return -ENOMEM;
+		data->blocks = x;
+		data->maxblocks = eq->blocksmax;
 	}
+	data->readsiz = eq->readsiz;
 
 	assert(n <= eq->blocksmax);
 
-	rsz = sendfile(eq->fd_cip, data->fd, NULL, eq->readsiz);
-	DBG(DATA, ul_debugobj(data, "  sent %zu [%zu wanted] to cipher", rsz, eq->readsiz));
+	/* get block digest (note 1st block is data->intro */
+	*block = data->blocks + (n * eq->method->digsiz);
 
-	if (rsz < 0)
-		return rsz;
+	if (eq->method->id == UL_FILEEQ_XXH3) {
+		unsigned char *buf = get_buffer(eq);
 
-	off += rsz;
+		if (!buf)
+			return -ENOMEM;
 
-	/* get block digest (note 1st block is data->intro */
-	*block = data->blocks + (n * eq->method->digsiz);
-	rsz = read_all(eq->fd_cip, (char *) *block, sz);
+		rsz = read_all(data->fd, (char *) buf, eq->readsiz);
+		DBG(DATA, ul_debugobj(data, "  read %zu [%zu wanted] to hash", rsz, eq->readsiz));
+		if (rsz < 0)
+			return rsz;
+
+		off += rsz;
+
+		XXH128_canonicalFromHash((XXH128_canonical_t *) *block,
+					 xxh3_func(buf, rsz));
+		rsz = sz;
+	} else {
+#ifdef USE_FILEEQ_CRYPTOAPI
+		rsz = sendfile(eq->fd_cip, data->fd, NULL, eq->readsiz);
+		DBG(DATA, ul_debugobj(data, "  sent %zu [%zu wanted] to cipher", rsz, eq->readsiz));
+
+		if (rsz < 0)
+			return rsz;
+
+		off += rsz;
+
+		rsz = read_all(eq->fd_cip, (char *) *block, sz);
+#else
+		return -1;
+#endif
+	}
 
 	if (rsz > 0)
 		data->nblocks++;
@@ -461,7 +637,48 @@ static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	DBG(DATA, ul_debugobj(data, "  get %zuB digest", rsz));
 	return rsz;
 }
-#endif
+
+/*
+ * Compares content of the files, used when the digests of all blocks
+ * match but the digest is not collision resistant.
+ */
+static int verify_content(struct ul_fileeq *eq,
+			  struct ul_fileeq_data *a, struct ul_fileeq_data *b)
+{
+	unsigned char *buf_a, *buf_b;
+	int fd_a = -1, fd_b = -1, rc = 0;
+
+	DBG(EQ, ul_debugobj(eq, "verify content"));
+
+	buf_a = get_buffer(eq);
+	buf_b = get_buffer(eq);
+	if (!buf_a || !buf_b)
+		goto done;
+
+	fd_a = open(a->name, O_RDONLY|O_CLOEXEC);
+	fd_b = open(b->name, O_RDONLY|O_CLOEXEC);
+	if (fd_a < 0 || fd_b < 0)
+		goto done;
+
+	do {
+		ssize_t ca = read_all(fd_a, (char *) buf_a, eq->readsiz);
+		ssize_t cb = read_all(fd_b, (char *) buf_b, eq->readsiz);
+
+		if (ca < 0 || ca != cb || memcmp(buf_a, buf_b, ca) != 0)
+			goto done;
+		if (ca == 0)
+			break;
+	} while (1);
+
+	rc = 1;
+done:
+	if (fd_a >= 0)
+		close(fd_a);
+	if (fd_b >= 0)
+		close(fd_b);
+	DBG(EQ, ul_debugobj(eq, " content %s", rc ? "match" : "not-match"));
+	return rc;
+}
 
 static ssize_t get_intro(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 				unsigned char **block)
@@ -498,11 +715,7 @@ static ssize_t get_cmp_data(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	default:
 		break;
 	}
-#ifdef USE_FILEEQ_CRYPTOAPI
 	return get_digest(eq, data, blockno, block);
-#else
-	return -1;
-#endif
 }
 
 #define CMP(a, b) ((a) > (b) ? 1 : ((a) < (b) ? -1 : 0))
@@ -545,6 +758,8 @@ int ul_fileeq(struct ul_fileeq *eq,
 	if (cmp == 0) {
 		if (!a->is_eof || !b->is_eof)
 			goto done; /* filesize changed? */
+		if (eq->method->verify && !verify_content(eq, a, b))
+			goto done;
 
 		DBG(EQ, ul_debugobj(eq, "<-- MATCH"));
 		return 1;
@@ -579,7 +794,7 @@ int main(int argc, char *argv[])
 			break;
 		case 'h':
 			printf("usage: %s [options] <file> <file>\n"
-				" -m, --method <memcmp|sha1|crc32>    compare method\n",
+				" -m, --method <memcmp|xxh3|sha1|crc32>    compare method\n",
 				program_invocation_short_name);
 			return EXIT_FAILURE;
 		}
@@ -7,13 +7,80 @@
  * Written by Karel Zak <kzak@redhat.com>
  */
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <cctype.h>
 
 #include "c.h"
+#include "bitops.h"
 #include "jsonwrt.h"
 
+/*
+ * Output is composed in a small on-stack buffer and written to the stream by
+ * fwrite() in chunks rather than by fputc() char by char.
+ */
+struct jsonwrt_buffer {
+	FILE	*out;
+	size_t	len;
+	char	data[256];
+};
+
+static void buffer_flush(struct jsonwrt_buffer *b)
+{
+	if (b->len)
+		fwrite(b->data, 1, b->len, b->out);
+	b->len = 0;
+}
+
+static void buffer_putc(struct jsonwrt_buffer *b, char c)
+{
+	if (b->len == sizeof(b->data))
+		buffer_flush(b);
+	b->data[b->len++] = c;
+}
+
+static void buffer_put(struct jsonwrt_buffer *b, const char *s, size_t n)
+{
+	if (n > sizeof(b->data) - b->len) {
+		buffer_flush(b);
+		if (n >= sizeof(b->data)) {
+			fwrite(s, 1, n, b->out);
+			return;
+		}
+	}
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+}
+
+/*
+ * Returns length of the leading part of @p (up to @n bytes) which does not
+ * require escaping, it means no '"', '\' and control chars. The string is
+ * checked by 8-byte words.
+ */
+static size_t json_safe_span(const char *p, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t w;
+
+		memcpy(&w, p + i, sizeof(w));
+		if (ul_word_has_less(w, 0x20)
+		    || ul_word_has_byte(w, '"')
+		    || ul_word_has_byte(w, '\\'))
+			break;
+	}
+
+	for (; i < n; i++) {
+		unsigned char c = (unsigned char) p[i];
+
+		if (c < 0x20 || c == '"' || c == '\\')
+			break;
+	}
+	return i;
+}
+
 /*
  * Requirements enumerated via testing (V8, Firefox, IE11):
  *
@@ -28,12 +95,32 @@
  */
 static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t size)
 {
-	const char *p;
+	struct jsonwrt_buffer b;
+	const char *p = data, *end = data;
+
+	b.out = out;
+	b.len = 0;
 
-	fputc('"', out);
-	for (p = data; p && *p && (!size || p < data + size); p++) {
+	if (data)
+		end = data + (size ? strnlen(data, size) : strlen(data));
 
-		const unsigned int c = (unsigned int) *p;
+	buffer_putc(&b, '"');
+	while (p < end) {
+		unsigned int c;
+
+		/* Copy the part which does not need escaping or case swap */
+		if (!dir) {
+			size_t n = json_safe_span(p, end - p);
+
+			if (n) {
+				buffer_put(&b, p, n);
+				p += n;
+				if (p == end)
+					break;
+			}
+		}
+
+		c = (unsigned int) *p++;
 
 		/* From http://www.json.org
 		 *
@@ -44,8 +131,8 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t
 		 * in the JSON spec, don't break double-quoted strings.
 		 */
 		if (c == '"' || c == '\\') {
-			fputc('\\', out);
-			fputc(c, out);
+			buffer_putc(&b, '\\');
+			buffer_putc(&b, c);
 			continue;
 		}
 
@@ -57,11 +144,11 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t
 			 * (aka LANG=tr_TR.UTF-8) toupper('I') returns 'I'.
 			 */
 			if (c <= 127)
-				fputc(dir ==  1 ? c_toupper(c) :
-				      dir == -1 ? c_tolower(c) : *p, out);
+				buffer_putc(&b, dir ==  1 ? c_toupper(c) :
+						dir == -1 ? c_tolower(c) : (int) c);
 			else
-				fputc(dir ==  1 ? toupper(c) :
-				      dir == -1 ? tolower(c) : *p, out);
+				buffer_putc(&b, dir ==  1 ? toupper(c) :
+						dir == -1 ? tolower(c) : (int) c);
 			continue;
 		}
 
@@ -75,27 +162,34 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t
 			 * should probably be using it.
 			 */
 			case '\b':
-				fputs("\\b", out);
+				buffer_put(&b, "\\b", 2);
 				break;
 			case '\t':
-				fputs("\\t", out);
+				buffer_put(&b, "\\t", 2);
 				break;
 			case '\n':
-				fputs("\\n", out);
+				buffer_put(&b, "\\n", 2);
 				break;
 			case '\f':
-				fputs("\\f", out);
+				buffer_put(&b, "\\f", 2);
 				break;
 			case '\r':
-				fputs("\\r", out);
+				buffer_put(&b, "\\r", 2);
 				break;
 			default:
+			{
 				/* Other assorted control characters */
-				fprintf(out, "\\u00%02x", c);
+				static const char hex[] = "0123456789abcdef";
+				char x[6] = { '\\', 'u', '0', '0',
+					      hex[(c >> 4) & 0xf], hex[c & 0xf] };
+
+				buffer_put(&b, x, sizeof(x));
 				break;
+			}
 		}
 	}
-	fputc('"', out);
+	buffer_putc(&b, '"');
+	buffer_flush(&b);
 }
 
 #define fputs_quoted_json(_d, _o)       fputs_quoted_case_json(_d, _o, 0, 0)
@@ -107,6 +201,17 @@ void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent)
 	fmt->out = out;
 	fmt->indent = indent;
 	fmt->after_close = 0;
+	fmt->compact = 0;
+}
+
+/*
+ * Compact output does not use newlines and indentation, except newline after
+ * the top-level object. It's possible to print more top-level objects to
+ * get one object per line (aka NDJSON or JSON Lines).
+ */
+void ul_jsonwrt_set_compact(struct ul_jsonwrt *fmt, int enable)
+{
+	fmt->compact = enable ? 1 : 0;
 }
 
 int ul_jsonwrt_is_ready(struct ul_jsonwrt *fmt)
@@ -118,6 +223,8 @@ void ul_jsonwrt_indent(struct ul_jsonwrt *fmt)
 {
 	int i;
 
+	if (fmt->compact)
+		return;
 	for (i = 0; i < fmt->indent; i++)
 		fputs("   ", fmt->out);
 }
@@ -126,7 +233,7 @@ static void print_name(struct ul_jsonwrt *fmt, const char *name)
 {
 	if (name) {
 		if (fmt->after_close)
-			fputs(",\n", fmt->out);
+			fputs(fmt->compact ? "," : ",\n", fmt->out);
 		ul_jsonwrt_indent(fmt);
 		fputs_quoted_json_lower(name, fmt->out);
 	} else {
@@ -143,15 +250,25 @@ void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 
 	switch (type) {
 	case UL_JSON_OBJECT:
-		fputs(name ? ": {\n" : "{\n", fmt->out);
+		if (fmt->compact)
+			fputs(name ? ":{" : "{", fmt->out);
+		else
+			fputs(name ? ": {\n" : "{\n", fmt->out);
 		fmt->indent++;
 		break;
 	case UL_JSON_ARRAY:
-		fputs(name ? ": [\n" : "[\n", fmt->out);
+		if (fmt->compact)
+			fputs(name ? ":[" : "[", fmt->out);
+		else
+			fputs(name ? ": [\n" : "[\n", fmt->out);
 		fmt->indent++;
 		break;
 	case UL_JSON_VALUE:
-		fputs(name ? ": " : " ", fmt->out);
+		if (fmt->compact) {
+			if (name)
+				fputc(':', fmt->out);
+		} else
+			fputs(name ? ": " : " ", fmt->out);
 		break;
 	}
 	fmt->after_close = 0;
@@ -163,13 +280,13 @@ void ul_jsonwrt_empty(struct ul_jsonwrt *fmt, const char *name, int type)
 
 	switch (type) {
 	case UL_JSON_OBJECT:
-		fputs(name ? ": {}" : "{}", fmt->out);
+		fputs(!name ? "{}" : fmt->compact ? ":{}" : ": {}", fmt->out);
 		break;
 	case UL_JSON_ARRAY:
-		fputs(name ? ": []" : "[]", fmt->out);
+		fputs(!name ? "[]" : fmt->compact ? ":[]" : ": []", fmt->out);
 		break;
 	case UL_JSON_VALUE:
-		fputs(name ? ": null" : "null", fmt->out);
+		fputs(!name ? "null" : fmt->compact ? ":null" : ": null", fmt->out);
 		break;
 	}
 
@@ -183,7 +300,8 @@ void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 	switch (type) {
 	case UL_JSON_OBJECT:
 		fmt->indent--;
-		fputc('\n', fmt->out);
+		if (!fmt->compact)
+			fputc('\n', fmt->out);
 		ul_jsonwrt_indent(fmt);
 		fputs("}", fmt->out);
 		if (fmt->indent == 0)
@@ -191,7 +309,8 @@ void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 		break;
 	case UL_JSON_ARRAY:
 		fmt->indent--;
-		fputc('\n', fmt->out);
+		if (!fmt->compact)
+			fputc('\n', fmt->out);
 		ul_jsonwrt_indent(fmt);
 		fputs("]", fmt->out);
 		break;
@@ -199,7 +318,8 @@ void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 		break;
 	}
 
-	fmt->after_close = 1;
+	/* compact top-level objects are independent (one per line) */
+	fmt->after_close = fmt->compact && fmt->indent == 0 ? 0 : 1;
 }
 
 
@@ -244,8 +364,16 @@ void ul_jsonwrt_value_s_sized(struct ul_jsonwrt *fmt,
 void ul_jsonwrt_value_u64(struct ul_jsonwrt *fmt,
 			const char *name, uint64_t data)
 {
+	char buf[sizeof(stringify_value(UINT64_MAX))], *p = buf + sizeof(buf);
+
+	/* convert to decimal without printf() */
+	do {
+		*--p = '0' + (data % 10);
+		data /= 10;
+	} while (data);
+
 	ul_jsonwrt_value_open(fmt, name);
-	fprintf(fmt->out, "%"PRIu64, data);
+	fwrite(p, 1, buf + sizeof(buf) - p, fmt->out);
 	ul_jsonwrt_value_close(fmt);
 }
 
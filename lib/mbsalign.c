@@ -12,6 +12,7 @@
  * Written by Pádraig Brady.
  */
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -22,6 +23,40 @@
 #include "mbsalign.h"
 #include "strutils.h"
 #include "widechar.h"
+#include "bitops.h"
+
+/*
+ * Returns length of the leading run of printable ASCII chars (0x20..0x7e) in
+ * @p, up to @n bytes. The run is terminated by '\0', control chars, DEL and
+ * any byte with the highest bit set (multibyte sequences). If @nobackslash
+ * is true, the run is also terminated by '\' (it may start \x?? sequence).
+ *
+ * The string is checked by 8-byte words, the printable ASCII chars are always
+ * one cell wide, so the caller does not have to call mbrtowc() for the run.
+ */
+static size_t ascii_span(const char *p, size_t n, bool nobackslash)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t w;
+
+		memcpy(&w, p + i, sizeof(w));
+		if (ul_word_has_high(w)
+		    || ul_word_has_less(w, 0x20)
+		    || ul_word_has_byte(w, 0x7f)
+		    || (nobackslash && ul_word_has_byte(w, '\\')))
+			break;
+	}
+
+	for (; i < n; i++) {
+		unsigned char c = (unsigned char) p[i];
+
+		if (c < 0x20 || c >= 0x7f || (nobackslash && c == '\\'))
+			break;
+	}
+	return i;
+}
 
 /*
  * Counts number of cells in multibyte string. All control and
@@ -42,6 +77,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		size_t n = ascii_span(p, last - p + 1, false);
+
+		if (n) {
+			width += n;
+			p += n;
+			continue;
+		}
 		if (iscntrl((unsigned char) *p)) {
 			p++;
 
@@ -61,12 +103,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 
 		if (len == 0)
 			break;
-		if (len > 0 && iswprint(wc)) {
+		if (len == (size_t) -1 || len == (size_t) -2)
+			len = 1;
+		else if (iswprint(wc)) {
 			int x = wcwidth(wc);
 			if (x > 0)
 				width += x;
-		} else if (len == (size_t) -1 || len == (size_t) -2)
-			len = 1;
+		}
 		p += len;
 #else
 		if (isprint((unsigned char) *p))
@@ -105,6 +148,13 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		size_t n = ascii_span(p, last - p + 1, true);
+
+		if (n) {
+			width += n, bytes += n;
+			p += n;
+			continue;
+		}
 		if ((p < last && *p == '\\' && *(p + 1) == 'x')
 		    || iscntrl((unsigned char) *p)) {
 			width += 4, bytes += 4;		/* *p encoded to \x?? */
@@ -182,6 +232,14 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf, const c
 	*width = 0;
 
 	while (p && *p) {
+		size_t n = ascii_span(p, sz - (p - s), true);
+
+		if (n) {
+			memcpy(r, p, n);
+			r += n, p += n;
+			*width += n;
+			continue;
+		}
 		if (safechars && strchr(safechars, *p)) {
 			*r++ = *p++;
 			continue;
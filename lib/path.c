@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "c.h"
 #include "fileutils.h"
@@ -97,6 +98,7 @@ void ul_unref_path(struct path_cxt *pc)
 		if (pc->dialect)
 			pc->free_dialect(pc);
 		ul_path_close_dirfd(pc);
+		free(pc->attrs_buffer);
 		free(pc->dir_path);
 		free(pc->prefix);
 		free(pc);
@@ -722,6 +724,181 @@ int ul_path_readf_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const cha
 	return rc;
 }
 
+/* sysfs attributes are never larger than a page */
+#define UL_PATH_ATTR_MAXSZ	4096
+
+/*
+ * Reads @nattrs attributes from @dir (relative to the context directory, or
+ * the context directory itself if @dir is NULL). The directory is opened only
+ * once and all values are stored in one buffer owned by the context, so the
+ * values are valid only until the next ul_path_read_attrs() call for the same
+ * context.
+ *
+ * Note that the ENOENT redirection (see ul_path_set_enoent_redirect()) is
+ * applied to @dir only, not to the attributes within @dir.
+ *
+ * Returns number of successfully read attributes or negative errno if @dir
+ * cannot be opened (@rc of all the attributes is set to the errno too).
+ */
+int ul_path_read_attrs(struct path_cxt *pc, struct ul_path_attr *attrs, size_t nattrs,
+			const char *dir)
+{
+	char *buf;
+	size_t i;
+	int dirfd, count = 0;
+
+	if (!pc || !attrs)
+		return -EINVAL;
+
+	if (pc->attrs_bufsz < nattrs * UL_PATH_ATTR_MAXSZ) {
+		size_t sz = nattrs * UL_PATH_ATTR_MAXSZ;
+		char *tmp = realloc(pc->attrs_buffer, sz);
+
+		if (!tmp)
+			return -ENOMEM;
+		pc->attrs_buffer = tmp;
+		pc->attrs_bufsz = sz;
+	}
+
+	if (dir) {
+		dirfd = ul_path_open(pc, O_RDONLY|O_DIRECTORY|O_CLOEXEC, dir);
+		if (dirfd < 0)
+			dirfd = -errno;
+	} else
+		dirfd = ul_path_get_dirfd(pc);
+
+	if (dirfd < 0) {
+		for (i = 0; i < nattrs; i++) {
+			attrs[i].rc = dirfd;
+			attrs[i].value = NULL;
+		}
+		return dirfd;
+	}
+
+	DBG(CXT, ul_debugobj(pc, "reading %zu attributes from '%s'", nattrs, dir ? : "."));
+
+	for (i = 0, buf = pc->attrs_buffer; i < nattrs; i++) {
+		struct ul_path_attr *a = &attrs[i];
+		int fd, rc;
+
+		a->value = NULL;
+
+		fd = openat(dirfd, a->name, O_RDONLY|O_CLOEXEC);
+		if (fd < 0)
+			rc = -errno;
+		else {
+			rc = read_all(fd, buf, UL_PATH_ATTR_MAXSZ - 1);
+			if (rc < 0)
+				rc = -errno;
+			else {
+				/* remove trailing newline (usual in sysfs) */
+				if (rc > 0 && buf[rc - 1] == '\n')
+					rc--;
+				buf[rc] = '\0';
+			}
+			close(fd);
+		}
+
+		a->rc = rc;
+		if (rc >= 0) {
+			a->value = buf;
+			buf += rc + 1;
+			count++;
+		}
+	}
+
+	if (dir)
+		close(dirfd);
+	return count;
+}
+
+int ul_path_readf_attrs(struct path_cxt *pc, struct ul_path_attr *attrs, size_t nattrs,
+			const char *dir, ...)
+{
+	const char *p;
+	va_list ap;
+
+	va_start(ap, dir);
+	p = ul_path_mkpath(pc, dir, ap);
+	va_end(ap);
+
+	return !p ? -errno : ul_path_read_attrs(pc, attrs, nattrs, p);
+}
+
+static int str_to_s64(const char *str, int64_t *res)
+{
+	char *end = NULL;
+	intmax_t x;
+
+	if (!str)
+		return -1;
+	errno = 0;
+	x = strtoimax(str, &end, 10);
+	if (errno || end == str || x < INT64_MIN || x > INT64_MAX)
+		return -1;
+	if (res)
+		*res = x;
+	return 0;
+}
+
+static int str_to_u64(const char *str, uint64_t *res)
+{
+	char *end = NULL;
+	uintmax_t x;
+
+	if (!str)
+		return -1;
+	errno = 0;
+	x = strtoumax(str, &end, 10);
+	if (errno || end == str || x > UINT64_MAX)
+		return -1;
+	if (res)
+		*res = x;
+	return 0;
+}
+
+static int str_to_s32(const char *str, int32_t *res)
+{
+	int64_t x;
+
+	if (str_to_s64(str, &x) != 0 || x < INT32_MIN || x > INT32_MAX)
+		return -1;
+	if (res)
+		*res = x;
+	return 0;
+}
+
+static int str_to_u32(const char *str, uint32_t *res)
+{
+	uint64_t x;
+
+	if (str_to_u64(str, &x) != 0 || x > UINT32_MAX)
+		return -1;
+	if (res)
+		*res = x;
+	return 0;
+}
+
+int ul_path_attr_s32(const struct ul_path_attr *attr, int32_t *res)
+{
+	return str_to_s32(attr->value, res);
+}
+
+int ul_path_attr_u32(const struct ul_path_attr *attr, uint32_t *res)
+{
+	return str_to_u32(attr->value, res);
+}
+
+int ul_path_attr_s64(const struct ul_path_attr *attr, int64_t *res)
+{
+	return str_to_s64(attr->value, res);
+}
+
+int ul_path_attr_u64(const struct ul_path_attr *attr, uint64_t *res)
+{
+	return str_to_u64(attr->value, res);
+}
+
 int ul_path_scanf(struct path_cxt *pc, const char *path, const char *fmt, ...)
 {
 	FILE *f;
@@ -763,15 +940,11 @@ int ul_path_scanff(struct path_cxt *pc, const char *path, va_list ap, const char
 
 int ul_path_read_s64(struct path_cxt *pc, int64_t *res, const char *path)
 {
-	int64_t x = 0;
-	int rc;
+	char buf[64];
 
-	rc = ul_path_scanf(pc, path, "%"SCNd64, &x);
-	if (rc != 1)
+	if (ul_path_read_buffer(pc, buf, sizeof(buf), path) <= 0)
 		return -1;
-	if (res)
-		*res = x;
-	return 0;
+	return str_to_s64(buf, res);
 }
 
 int ul_path_readf_s64(struct path_cxt *pc, int64_t *res, const char *path, ...)
@@ -788,15 +961,11 @@ int ul_path_readf_s64(struct path_cxt *pc, int64_t *res, const char *path, ...)
 
 int ul_path_read_u64(struct path_cxt *pc, uint64_t *res, const char *path)
 {
-	uint64_t x = 0;
-	int rc;
+	char buf[64];
 
-	rc = ul_path_scanf(pc, path, "%"SCNu64, &x);
-	if (rc != 1)
+	if (ul_path_read_buffer(pc, buf, sizeof(buf), path) <= 0)
 		return -1;
-	if (res)
-		*res = x;
-	return 0;
+	return str_to_u64(buf, res);
 }
 
 int ul_path_readf_u64(struct path_cxt *pc, uint64_t *res, const char *path, ...)
@@ -813,14 +982,11 @@ int ul_path_readf_u64(struct path_cxt *pc, uint64_t *res, const char *path, ...)
 
 int ul_path_read_s32(struct path_cxt *pc, int *res, const char *path)
 {
-	int rc, x = 0;
+	char buf[64];
 
-	rc = ul_path_scanf(pc, path, "%d", &x);
-	if (rc != 1)
+	if (ul_path_read_buffer(pc, buf, sizeof(buf), path) <= 0)
 		return -1;
-	if (res)
-		*res = x;
-	return 0;
+	return str_to_s32(buf, res);
 }
 
 int ul_path_readf_s32(struct path_cxt *pc, int *res, const char *path, ...)
@@ -837,15 +1003,11 @@ int ul_path_readf_s32(struct path_cxt *pc, int *res, const char *path, ...)
 
 int ul_path_read_u32(struct path_cxt *pc, unsigned int *res, const char *path)
 {
-	int rc;
-	unsigned int x = 0;
+	char buf[64];
 
-	rc = ul_path_scanf(pc, path, "%u", &x);
-	if (rc != 1)
+	if (ul_path_read_buffer(pc, buf, sizeof(buf), path) <= 0)
 		return -1;
-	if (res)
-		*res = x;
-	return 0;
+	return str_to_u32(buf, res);
 }
 
 int ul_path_readf_u32(struct path_cxt *pc, unsigned int *res, const char *path, ...)
@@ -1019,7 +1181,8 @@ int ul_path_next_dirent(struct path_cxt *pc, DIR **sub, const char *dirname, str
 }
 
 #ifdef HAVE_CPU_SET_T
-static int ul_path_cpuparse(struct path_cxt *pc, cpu_set_t **set, int maxcpus, int islist, const char *path, va_list ap)
+static int ul_path_cpuparse(struct path_cxt *pc, cpu_set_t **set, int maxcpus,
+			    int islist, const char *path, va_list ap)
 {
 	size_t setsize, len = maxcpus * 7;
 	char *buf;
@@ -1108,6 +1271,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" read-string <file>         read string  from file\n", stdout);
 	fputs(" read-majmin <file>         read devno from file\n", stdout);
 	fputs(" read-link <file>           read symlink\n", stdout);
+	fputs(" read-attrs <dir> <name>... read attributes from dir\n", stdout);
 	fputs(" write-string <file> <str>  write string from file\n", stdout);
 	fputs(" write-u64 <file> <str>     write uint64_t from file\n", stdout);
 
@@ -1260,6 +1424,32 @@ int main(int argc, char *argv[])
 			err(EXIT_FAILURE, "readf symlink failed");
 		printf("readf: %s: %s\n", file, res);
 
+	} else if (strcmp(command, "read-attrs") == 0) {
+		struct ul_path_attr *attrs;
+		size_t i, nattrs;
+		const char *subdir;
+
+		if (optind + 1 >= argc)
+			errx(EXIT_FAILURE, "<dir> <name> not defined");
+		subdir = argv[optind++];
+		nattrs = argc - optind;
+
+		attrs = calloc(nattrs, sizeof(*attrs));
+		if (!attrs)
+			err(EXIT_FAILURE, "cannot allocate attributes");
+		for (i = 0; i < nattrs; i++)
+			attrs[i].name = argv[optind + i];
+
+		if (ul_path_read_attrs(pc, attrs, nattrs, subdir) < 0)
+			err(EXIT_FAILURE, "read attributes failed");
+		for (i = 0; i < nattrs; i++) {
+			if (attrs[i].rc < 0)
+				printf("%s: error %d\n", attrs[i].name, attrs[i].rc);
+			else
+				printf("%s: %s\n", attrs[i].name, attrs[i].value);
+		}
+		free(attrs);
+
 	} else if (strcmp(command, "write-string") == 0) {
 		char *str;
 
@@ -0,0 +1,612 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * procfs_snapshot -- basic information about all processes read by one
+ * /proc walk. The walk is split between a pool of threads, and the
+ * information is stored in arrays (one array for each field), so the tools
+ * which need the same data for many processes (or lookups by PID or by
+ * namespace) do not walk /proc again and again.
+ *
+ * Example:
+ *
+ *	struct procfs_snapshot *snap = ul_new_procfs_snapshot(
+ *				PROCFS_SNAP_STAT | PROCFS_SNAP_COMM, 0);
+ *	size_t i;
+ *
+ *	for (i = 0; snap && i < snap->nprocs; i++)
+ *		printf("%d %d %s\n", snap->pids[i], snap->ppids[i], snap->comms[i]);
+ *	ul_free_procfs_snapshot(snap);
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
+#include "c.h"
+#include "pathnames.h"
+#include "procfs.h"
+#include "pidfd-utils.h"
+
+#define PROCFS_SNAP_MAX_WORKERS	16
+
+static const char *const ns_names[PROCFS_NS_NTYPES] = {
+	[PROCFS_NS_CGROUP] = "cgroup",
+	[PROCFS_NS_IPC]    = "ipc",
+	[PROCFS_NS_MNT]    = "mnt",
+	[PROCFS_NS_NET]    = "net",
+	[PROCFS_NS_PID]    = "pid",
+	[PROCFS_NS_TIME]   = "time",
+	[PROCFS_NS_USER]   = "user",
+	[PROCFS_NS_UTS]    = "uts"
+};
+
+const char *procfs_ns_type_to_name(int type)
+{
+	if (type < 0 || type >= PROCFS_NS_NTYPES)
+		return NULL;
+	return ns_names[type];
+}
+
+struct snap_walker {
+	struct procfs_snapshot *snap;
+	bool *valid;		/* successfully read processes */
+	procfs_snapshot_reader reader;
+	void *data;		/* for @reader */
+	size_t next;		/* the first process not taken by a worker yet */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t mutex;	/* protects @next */
+#endif
+};
+
+static int cmp_pids(const void *a, const void *b)
+{
+	pid_t x = *(const pid_t *) a, y = *(const pid_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* "pid (comm) state ppid ..."; the comm may contain spaces and ')' */
+static int parse_stat(struct procfs_snapshot *snap, size_t i, char *buf)
+{
+	char *comm = strchr(buf, '('), *end = strrchr(buf, ')');
+
+	if (!comm || !end || end < comm)
+		return -EINVAL;
+
+	if (snap->mask & PROCFS_SNAP_COMM) {
+		size_t sz = end - comm - 1;
+
+		if (sz >= PROCFS_COMM_SIZE)
+			sz = PROCFS_COMM_SIZE - 1;
+		memcpy(snap->comms[i], comm + 1, sz);
+		snap->comms[i][sz] = '\0';
+	}
+	if ((snap->mask & PROCFS_SNAP_STAT)
+	    && sscanf(end, ") %c %d", &snap->states[i], &snap->ppids[i]) != 2)
+		return -EINVAL;
+	return 0;
+}
+
+static int read_process(struct snap_walker *wk, struct path_cxt *pc, size_t i)
+{
+	struct procfs_snapshot *snap = wk->snap;
+	pid_t pid = snap->pids[i];
+	int pidfd, rc;
+
+	/* The pidfd pins the process. If the process exits while we read it,
+	 * the PID may be reused and the data would describe two processes;
+	 * such process is ignored. */
+	pidfd = pidfd_open(pid, 0);
+	if (pidfd < 0 && errno == ESRCH)
+		return -ESRCH;
+
+	rc = procfs_process_init_path(pc, pid);
+	if (rc)
+		goto done;
+
+	if (snap->mask & PROCFS_SNAP_UID) {
+		rc = procfs_process_get_uid(pc, &snap->uids[i]);
+		if (rc)
+			goto done;
+	}
+
+	if (snap->mask & (PROCFS_SNAP_STAT | PROCFS_SNAP_COMM)) {
+		char buf[BUFSIZ];
+		ssize_t sz = procfs_process_get_stat(pc, buf, sizeof(buf));
+
+		if (sz <= 0) {
+			rc = sz < 0 ? sz : -EINVAL;
+			goto done;
+		}
+		rc = parse_stat(snap, i, buf);
+		if (rc)
+			goto done;
+	}
+
+	if (snap->mask & PROCFS_SNAP_NS) {
+		int t;
+
+		for (t = 0; t < PROCFS_NS_NTYPES; t++) {
+			struct stat st;
+
+			if (ul_path_statf(pc, &st, 0, "ns/%s", ns_names[t]) == 0)
+				snap->ns_inos[t][i] = st.st_ino;
+		}
+	}
+
+	if (wk->reader)
+		snap->priv[i] = wk->reader(pc, pid, wk->data);
+
+	if (pidfd >= 0 && pidfd_send_signal(pidfd, 0, NULL, 0) != 0
+	    && errno == ESRCH)
+		rc = -ESRCH;
+done:
+	ul_path_close_dirfd(pc);
+	if (pidfd >= 0)
+		close(pidfd);
+	return rc;
+}
+
+static ssize_t walker_next(struct snap_walker *wk)
+{
+	ssize_t i = -1;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&wk->mutex);
+#endif
+	if (wk->next < wk->snap->nprocs)
+		i = wk->next++;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&wk->mutex);
+#endif
+	return i;
+}
+
+static void *walker_worker(void *data)
+{
+	struct snap_walker *wk = data;
+	struct path_cxt *pc;
+	ssize_t i;
+
+	pc = ul_new_path(NULL);
+	if (!pc)
+		return NULL;	/* the others do the work */
+
+	while ((i = walker_next(wk)) >= 0)
+		wk->valid[i] = read_process(wk, pc, i) == 0;
+
+	ul_unref_path(pc);
+	return NULL;
+}
+
+static size_t get_default_workers(size_t nprocs)
+{
+#ifdef HAVE_LIBPTHREAD
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* it does not make sense to start a thread for a few processes */
+	if (n > 1)
+		return min(nprocs / 32 + 1,
+			   min((size_t) n, (size_t) PROCFS_SNAP_MAX_WORKERS));
+#endif
+	return 1;
+}
+
+static void run_walker(struct snap_walker *wk, size_t nworkers)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_t *workers = NULL;
+	size_t i, n = 0;
+
+	if (nworkers > 1)
+		workers = calloc(nworkers - 1, sizeof(*workers));
+	for (i = 0; workers && i < nworkers - 1; i++) {
+		if (pthread_create(&workers[n], NULL, walker_worker, wk) != 0)
+			break;
+		n++;
+	}
+
+	/* The calling thread is a worker too. */
+	walker_worker(wk);
+
+	for (i = 0; i < n; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+#else
+	(void) nworkers;
+	walker_worker(wk);
+#endif
+}
+
+static int read_pids(struct procfs_snapshot *snap)
+{
+	DIR *dir;
+	struct dirent *d;
+	size_t allocated = 0;
+
+	dir = opendir(_PATH_PROC);
+	if (!dir)
+		return -errno;
+
+	while ((d = readdir(dir))) {
+		pid_t pid;
+
+		if (procfs_dirent_get_pid(d, &pid) != 0)
+			continue;
+		if (snap->nprocs == allocated) {
+			pid_t *tmp;
+
+			allocated = allocated ? allocated * 2 : 256;
+			tmp = reallocarray(snap->pids, allocated, sizeof(pid_t));
+			if (!tmp) {
+				closedir(dir);
+				return -ENOMEM;
+			}
+			snap->pids = tmp;
+		}
+		snap->pids[snap->nprocs++] = pid;
+	}
+	closedir(dir);
+
+	qsort(snap->pids, snap->nprocs, sizeof(pid_t), cmp_pids);
+	return 0;
+}
+
+static int alloc_arrays(struct procfs_snapshot *snap, bool priv)
+{
+	size_t n = max(snap->nprocs, (size_t) 1);
+	int t;
+
+	if ((snap->mask & PROCFS_SNAP_STAT)
+	    && (!(snap->ppids = calloc(n, sizeof(*snap->ppids)))
+		|| !(snap->states = calloc(n, sizeof(*snap->states)))))
+		return -ENOMEM;
+	if ((snap->mask & PROCFS_SNAP_UID)
+	    && !(snap->uids = calloc(n, sizeof(*snap->uids))))
+		return -ENOMEM;
+	if ((snap->mask & PROCFS_SNAP_COMM)
+	    && !(snap->comms = calloc(n, sizeof(*snap->comms))))
+		return -ENOMEM;
+	if (snap->mask & PROCFS_SNAP_NS) {
+		for (t = 0; t < PROCFS_NS_NTYPES; t++) {
+			if (!(snap->ns_inos[t] = calloc(n, sizeof(ino_t))))
+				return -ENOMEM;
+		}
+	}
+	if (priv && !(snap->priv = calloc(n, sizeof(void *))))
+		return -ENOMEM;
+	return 0;
+}
+
+/* remove processes we failed to read, keep the order */
+static void compact_arrays(struct procfs_snapshot *snap, const bool *valid)
+{
+	size_t i, n = 0;
+	int t;
+
+	for (i = 0; i < snap->nprocs; i++) {
+		if (!valid[i]) {
+			if (snap->priv) {
+				free(snap->priv[i]);
+				snap->priv[i] = NULL;
+			}
+			continue;
+		}
+		if (i != n) {
+			snap->pids[n] = snap->pids[i];
+			if (snap->mask & PROCFS_SNAP_STAT) {
+				snap->ppids[n] = snap->ppids[i];
+				snap->states[n] = snap->states[i];
+			}
+			if (snap->mask & PROCFS_SNAP_UID)
+				snap->uids[n] = snap->uids[i];
+			if (snap->mask & PROCFS_SNAP_COMM)
+				memcpy(snap->comms[n], snap->comms[i], PROCFS_COMM_SIZE);
+			if (snap->mask & PROCFS_SNAP_NS) {
+				for (t = 0; t < PROCFS_NS_NTYPES; t++)
+					snap->ns_inos[t][n] = snap->ns_inos[t][i];
+			}
+			if (snap->priv) {
+				snap->priv[n] = snap->priv[i];
+				snap->priv[i] = NULL;
+			}
+		}
+		n++;
+	}
+	snap->nprocs = n;
+}
+
+struct ns_entry {
+	ino_t ino;
+	size_t idx;
+};
+
+static int cmp_ns_entries(const void *a, const void *b)
+{
+	const struct ns_entry *x = a, *y = b;
+
+	if (x->ino != y->ino)
+		return x->ino < y->ino ? -1 : 1;
+	return x->idx < y->idx ? -1 : x->idx > y->idx ? 1 : 0;
+}
+
+static int build_ns_index(struct procfs_snapshot *snap)
+{
+	size_t n = max(snap->nprocs, (size_t) 1);
+	struct ns_entry *ents;
+	int t, rc = 0;
+
+	ents = calloc(n, sizeof(*ents));
+	if (!ents)
+		return -ENOMEM;
+
+	for (t = 0; t < PROCFS_NS_NTYPES; t++) {
+		size_t i;
+
+		snap->ns_index[t] = calloc(n, sizeof(size_t));
+		if (!snap->ns_index[t]) {
+			rc = -ENOMEM;
+			break;
+		}
+		for (i = 0; i < snap->nprocs; i++) {
+			ents[i].ino = snap->ns_inos[t][i];
+			ents[i].idx = i;
+		}
+		qsort(ents, snap->nprocs, sizeof(*ents), cmp_ns_entries);
+		for (i = 0; i < snap->nprocs; i++)
+			snap->ns_index[t][i] = ents[i].idx;
+	}
+
+	free(ents);
+	return rc;
+}
+
+/**
+ * ul_new_procfs_snapshot_reader:
+ * @mask: PROCFS_SNAP_* fields to read
+ * @nworkers: number of threads or 0 for default
+ * @reader: per-process callback or NULL
+ * @data: passed to @reader
+ *
+ * Reads all processes from /proc. The processes which disappear during the
+ * walk are silently ignored.
+ *
+ * The @reader allows reading data the snapshot does not know about (for
+ * example /proc/<pid>/fd) by the same walk. It is called from more threads at
+ * the same time, so it must not modify anything shared without locking.
+ *
+ * Returns: new snapshot or NULL on error (errno is set).
+ */
+struct procfs_snapshot *ul_new_procfs_snapshot_reader(int mask, size_t nworkers,
+				procfs_snapshot_reader reader, void *data)
+{
+	struct snap_walker wk = {
+		.reader = reader,
+		.data = data,
+#ifdef HAVE_LIBPTHREAD
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+#endif
+	};
+	struct procfs_snapshot *snap;
+	int rc;
+
+	snap = calloc(1, sizeof(*snap));
+	if (!snap)
+		return NULL;
+	snap->mask = mask;
+
+	rc = read_pids(snap);
+	if (!rc)
+		rc = alloc_arrays(snap, reader != NULL);
+	if (rc)
+		goto err;
+
+	wk.snap = snap;
+	wk.valid = calloc(max(snap->nprocs, (size_t) 1), sizeof(bool));
+	if (!wk.valid) {
+		rc = -ENOMEM;
+		goto err;
+	}
+
+	if (!nworkers)
+		nworkers = get_default_workers(snap->nprocs);
+	run_walker(&wk, nworkers);
+
+	compact_arrays(snap, wk.valid);
+	free(wk.valid);
+
+	if (mask & PROCFS_SNAP_NS) {
+		rc = build_ns_index(snap);
+		if (rc)
+			goto err;
+	}
+	return snap;
+err:
+	ul_free_procfs_snapshot(snap);
+	errno = -rc;
+	return NULL;
+}
+
+/**
+ * ul_new_procfs_snapshot:
+ * @mask: PROCFS_SNAP_* fields to read
+ * @nworkers: number of threads or 0 for default
+ *
+ * Returns: new snapshot or NULL on error (errno is set).
+ */
+struct procfs_snapshot *ul_new_procfs_snapshot(int mask, size_t nworkers)
+{
+	return ul_new_procfs_snapshot_reader(mask, nworkers, NULL, NULL);
+}
+
+void ul_free_procfs_snapshot(struct procfs_snapshot *snap)
+{
+	size_t i;
+	int t;
+
+	if (!snap)
+		return;
+
+	if (snap->priv) {
+		for (i = 0; i < snap->nprocs; i++)
+			free(snap->priv[i]);
+		free(snap->priv);
+	}
+
+	free(snap->pids);
+	free(snap->ppids);
+	free(snap->states);
+	free(snap->uids);
+	free(snap->comms);
+	for (t = 0; t < PROCFS_NS_NTYPES; t++) {
+		free(snap->ns_inos[t]);
+		free(snap->ns_index[t]);
+	}
+	free(snap);
+}
+
+/**
+ * procfs_snapshot_find_pid:
+ * @snap: snapshot
+ * @pid: process ID
+ *
+ * Returns: index of the process or -1 if not found.
+ */
+ssize_t procfs_snapshot_find_pid(struct procfs_snapshot *snap, pid_t pid)
+{
+	pid_t *x;
+
+	if (!snap || !snap->nprocs)
+		return -1;
+	x = bsearch(&pid, snap->pids, snap->nprocs, sizeof(pid_t), cmp_pids);
+	return x ? x - snap->pids : -1;
+}
+
+/**
+ * procfs_snapshot_get_ns_procs:
+ * @snap: snapshot read with PROCFS_SNAP_NS
+ * @type: PROCFS_NS_*
+ * @ino: namespace inode number
+ * @idxs: returns array with indexes of the processes in the namespace
+ *
+ * The indexes are sorted, so the processes are in the PID order.
+ *
+ * Returns: number of the processes in the namespace.
+ */
+size_t procfs_snapshot_get_ns_procs(struct procfs_snapshot *snap,
+				    int type, ino_t ino, const size_t **idxs)
+{
+	const size_t *idx;
+	const ino_t *inos;
+	size_t lo = 0, hi, first;
+
+	*idxs = NULL;
+	if (!snap || !(snap->mask & PROCFS_SNAP_NS)
+	    || type < 0 || type >= PROCFS_NS_NTYPES)
+		return 0;
+
+	idx = snap->ns_index[type];
+	inos = snap->ns_inos[type];
+
+	/* the first index with inode >= @ino */
+	hi = snap->nprocs;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (inos[idx[mid]] < ino)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	first = lo;
+	while (lo < snap->nprocs && inos[idx[lo]] == ino)
+		lo++;
+
+	if (lo == first)
+		return 0;
+	*idxs = &idx[first];
+	return lo - first;
+}
+
+#ifdef TEST_PROGRAM_PROCFS_SNAPSHOT
+#include <getopt.h>
+
+/* number of open file descriptors */
+static void *count_fds(struct path_cxt *pc,
+		       pid_t pid __attribute__((__unused__)),
+		       void *data __attribute__((__unused__)))
+{
+	int *n = malloc(sizeof(*n));
+
+	if (n)
+		*n = ul_path_count_dirents(pc, "fd");
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	struct procfs_snapshot *snap;
+	procfs_snapshot_reader reader = NULL;
+	size_t i, nworkers = 0;
+	ino_t ns = 0;
+	int nstype = -1, c;
+
+	while ((c = getopt(argc, argv, "fw:n:")) != -1) {
+		switch (c) {
+		case 'f':
+			reader = count_fds;
+			break;
+		case 'w':
+			nworkers = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':	/* <type>:<inode> */
+		{
+			char *p = strchr(optarg, ':');
+			int t;
+
+			if (!p)
+				errx(EXIT_FAILURE, "<type>:<inode> expected");
+			*p++ = '\0';
+			for (t = 0; t < PROCFS_NS_NTYPES; t++) {
+				if (strcmp(optarg, ns_names[t]) == 0)
+					nstype = t;
+			}
+			ns = strtoumax(p, NULL, 10);
+			break;
+		}
+		default:
+			fprintf(stderr, "usage: %s [-f] [-w <workers>] [-n <type>:<inode>]\n",
+					program_invocation_short_name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	snap = ul_new_procfs_snapshot_reader(PROCFS_SNAP_STAT | PROCFS_SNAP_UID |
+				PROCFS_SNAP_COMM | PROCFS_SNAP_NS, nworkers, reader, NULL);
+	if (!snap)
+		err(EXIT_FAILURE, "cannot read processes");
+
+	if (nstype >= 0) {
+		const size_t *idxs;
+		size_t n = procfs_snapshot_get_ns_procs(snap, nstype, ns, &idxs);
+
+		for (i = 0; i < n; i++)
+			printf("%d\n", snap->pids[idxs[i]]);
+	} else {
+		for (i = 0; i < snap->nprocs; i++) {
+			printf("%d %d %c %u %s", snap->pids[i], snap->ppids[i],
+				snap->states[i], snap->uids[i], snap->comms[i]);
+			if (reader && snap->priv[i])
+				printf(" %d", *(int *) snap->priv[i]);
+			putchar('\n');
+		}
+	}
+
+	ul_free_procfs_snapshot(snap);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_PROCFS_SNAPSHOT */
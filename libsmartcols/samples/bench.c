@@ -0,0 +1,541 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ * Generates synthetic tables and measures time, allocated memory and peak
+ * RSS for the particular phases of the table life cycle. The results are
+ * printed by libsmartcols, use --json or --raw for machine-readable output.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+#ifdef HAVE_MALLINFO2
+# include <malloc.h>
+#endif
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+#include "timeutils.h"
+
+#include "libsmartcols.h"
+
+enum {
+	BENCH_FLAT = 0,
+	BENCH_TREE,
+	BENCH_GROUPS,
+	BENCH_WRAP,
+	BENCH_MULTIBYTE
+};
+
+static const char *bench_types[] = {
+	[BENCH_FLAT]	  = "flat",
+	[BENCH_TREE]	  = "tree",
+	[BENCH_GROUPS]	  = "groups",
+	[BENCH_WRAP]	  = "wrap",
+	[BENCH_MULTIBYTE] = "multibyte"
+};
+
+/* number of pregenerated cells data */
+#define NTEXTS	1024
+
+/* columns of the benchmarked table */
+enum { COL_NAME, COL_NUM, COL_TEXT };
+
+/* columns of the results */
+enum { RES_PHASE, RES_TIME, RES_ALLOC, RES_RSS };
+
+struct bench {
+	int	type;		/* BENCH_* */
+	size_t	nlines;		/* number of lines */
+	size_t	ntexts;		/* number of text columns */
+	size_t	depth;		/* tree depth or number of group members */
+	size_t	width;		/* terminal width for human output */
+
+	const char *filter;	/* filter expression or NULL */
+	unsigned int sort : 1;	/* sort by NUM and NAME */
+
+	uint64_t rand;		/* pseudo-random generator state */
+	char	**texts;	/* pregenerated cells data */
+
+	FILE	*devnull;	/* output for the benchmarked table */
+	struct libscols_table *results;
+
+	/* current phase */
+	struct timespec	start;
+	long long	start_alloc;
+};
+
+static const char *words[] = {
+	"alpha", "bravo", "charlie", "delta", "echo", "foxtrot",
+	"golf", "hotel", "india", "juliet", "kilo", "lima"
+};
+
+static const char *mbwords[] = {
+	"žluťoučký", "kůň", "úpěl", "ďábelské", "ódy",
+	"日本語", "テキスト", "Ελληνικά", "кириллица"
+};
+
+/* xorshift64; the tables are the same for all runs */
+static uint64_t bench_random(struct bench *be)
+{
+	be->rand ^= be->rand << 13;
+	be->rand ^= be->rand >> 7;
+	be->rand ^= be->rand << 17;
+	return be->rand;
+}
+
+static long long get_allocated(void)
+{
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 mi = mallinfo2();
+
+	return (long long) (mi.uordblks + mi.hblkhd);
+#else
+	return -1;
+#endif
+}
+
+/* reset the peak RSS counter (VmHWM), supported since Linux 4.0 */
+static void reset_peak_rss(void)
+{
+	FILE *f = fopen("/proc/self/clear_refs", "w" UL_CLOEXECSTR);
+
+	if (f) {
+		fputs("5", f);
+		fclose(f);
+	}
+}
+
+/* returns peak RSS in KiB */
+static long get_peak_rss(void)
+{
+	struct rusage ru;
+	char buf[BUFSIZ];
+	long rss = -1;
+	FILE *f;
+
+	f = fopen("/proc/self/status", "r" UL_CLOEXECSTR);
+	if (f) {
+		while (fgets(buf, sizeof(buf), f)) {
+			if (sscanf(buf, "VmHWM: %ld kB", &rss) == 1)
+				break;
+		}
+		fclose(f);
+	}
+	if (rss < 0 && getrusage(RUSAGE_SELF, &ru) == 0)
+		rss = ru.ru_maxrss;
+	return rss;
+}
+
+static void phase_begin(struct bench *be)
+{
+	reset_peak_rss();
+	be->start_alloc = get_allocated();
+	clock_gettime(CLOCK_MONOTONIC, &be->start);
+}
+
+static void phase_end(struct bench *be, const char *name)
+{
+	struct timespec end;
+	struct libscols_line *ln;
+	long long alloc;
+	double sec;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	alloc = get_allocated();
+
+	sec = (end.tv_sec - be->start.tv_sec)
+		+ (end.tv_nsec - be->start.tv_nsec) / (double) NSEC_PER_SEC;
+
+	ln = scols_table_new_line(be->results, NULL);
+	if (!ln)
+		err(EXIT_FAILURE, "failed to allocate output line");
+
+	if (scols_line_set_data(ln, RES_PHASE, name)
+	    || scols_line_sprintf(ln, RES_TIME, "%.6f", sec)
+	    || scols_line_sprintf(ln, RES_RSS, "%ld", get_peak_rss()))
+		goto fail;
+
+	if (alloc >= 0 && be->start_alloc >= 0
+	    && scols_line_sprintf(ln, RES_ALLOC, "%lld", alloc - be->start_alloc))
+		goto fail;
+	return;
+fail:
+	err(EXIT_FAILURE, "failed to add output data");
+}
+
+static void setup_columns(struct bench *be, struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	size_t i;
+	int fl = 0;
+
+	if (be->type == BENCH_TREE || be->type == BENCH_GROUPS)
+		fl = SCOLS_FL_TREE;
+
+	cl = scols_table_new_column(tb, "NAME", 0, fl);
+	if (!cl)
+		goto fail;
+	scols_column_set_data_type(cl, SCOLS_DATA_STRING);
+
+	cl = scols_table_new_column(tb, "NUM", 0, SCOLS_FL_RIGHT);
+	if (!cl)
+		goto fail;
+	scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
+	scols_column_set_data_type(cl, SCOLS_DATA_U64);
+
+	for (i = 0; i < be->ntexts; i++) {
+		char name[sizeof("TEXT") + sizeof(stringify_value(SIZE_MAX))];
+
+		snprintf(name, sizeof(name), "TEXT%zu", i);
+
+		cl = scols_table_new_column(tb, name, 0,
+				be->type == BENCH_WRAP ? SCOLS_FL_WRAP : 0);
+		if (!cl)
+			goto fail;
+	}
+	return;
+fail:
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static char *generate_text(struct bench *be, size_t nwords)
+{
+	const char **dict = words;
+	size_t ndict = ARRAY_SIZE(words), i;
+	char *res = NULL;
+
+	if (be->type == BENCH_MULTIBYTE) {
+		dict = mbwords;
+		ndict = ARRAY_SIZE(mbwords);
+	}
+
+	for (i = 0; i < nwords; i++) {
+		const char *w = dict[bench_random(be) % ndict];
+
+		if (ul_strappend(&res, w) != 0 ||
+		    (i + 1 < nwords && ul_strappend(&res, " ") != 0))
+			err(EXIT_FAILURE, "failed to allocate text");
+	}
+	return res;
+}
+
+/* the data are generated in advance to not measure the generator */
+static void generate_texts(struct bench *be)
+{
+	size_t i, nwords = be->type == BENCH_WRAP ? 40 : 3;
+
+	be->texts = xcalloc(NTEXTS, sizeof(char *));
+	for (i = 0; i < NTEXTS; i++)
+		be->texts[i] = generate_text(be, nwords);
+}
+
+static void free_texts(struct bench *be)
+{
+	size_t i;
+
+	for (i = 0; i < NTEXTS; i++)
+		free(be->texts[i]);
+	free(be->texts);
+}
+
+static void add_lines(struct bench *be, struct libscols_table *tb)
+{
+	struct libscols_line *prev = NULL, *leader = NULL;
+	size_t i, k;
+
+	for (i = 0; i < be->nlines; i++) {
+		struct libscols_line *ln, *parent = NULL;
+
+		/* chains of children up to @depth levels */
+		if (be->type == BENCH_TREE && i % be->depth)
+			parent = prev;
+
+		ln = scols_table_new_line(tb, parent);
+		if (!ln)
+			goto fail;
+
+		if (scols_line_sprintf(ln, COL_NAME, "line%zu", i))
+			goto fail;
+		if (scols_line_sprintf(ln, COL_NUM, "%" PRIu64,
+					bench_random(be) % 1000000))
+			goto fail;
+
+		for (k = 0; k < be->ntexts; k++) {
+			const char *text = be->texts[bench_random(be) % NTEXTS];
+
+			if (scols_line_set_data(ln, COL_TEXT + k, text))
+				goto fail;
+		}
+
+		/* groups of @depth members */
+		if (be->type == BENCH_GROUPS) {
+			if (i % be->depth == 0)
+				leader = ln;
+			else if (scols_table_group_lines(tb, ln, leader, 0))
+				goto fail;
+		}
+		prev = ln;
+	}
+	return;
+fail:
+	err(EXIT_FAILURE, "failed to create output line");
+}
+
+static void apply_filter(struct bench *be, struct libscols_table *tb)
+{
+	struct libscols_filter *fltr;
+	struct libscols_iter *itr;
+	struct libscols_line *ln;
+	const char *name = NULL;
+
+	fltr = scols_new_filter(NULL);
+	if (!fltr)
+		err(EXIT_FAILURE, "failed to allocate filter");
+	if (scols_filter_parse_string(fltr, be->filter) != 0)
+		errx(EXIT_FAILURE, "failed to parse filter: %s",
+				scols_filter_get_errmsg(fltr));
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, "failed to allocate iterator");
+
+	while (scols_filter_next_holder(fltr, itr, &name, 0) == 0) {
+		struct libscols_column *col;
+
+		col = scols_table_get_column_by_name(tb, name);
+		if (!col)
+			errx(EXIT_FAILURE, "unknown column '%s' in filter", name);
+		scols_filter_assign_column(fltr, itr, name, col);
+	}
+
+	scols_reset_iter(itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_line(tb, itr, &ln) == 0) {
+		int status = 0;
+
+		if (scols_line_apply_filter(ln, fltr, &status))
+			errx(EXIT_FAILURE, "failed to apply filter");
+	}
+
+	scols_free_iter(itr);
+	scols_unref_filter(fltr);
+}
+
+static void print_table(struct bench *be, struct libscols_table *tb,
+			const char *phase)
+{
+	phase_begin(be);
+	if (scols_print_table(tb) != 0)
+		errx(EXIT_FAILURE, "failed to print table");
+	fflush(be->devnull);
+	phase_end(be, phase);
+}
+
+static void run_bench(struct bench *be)
+{
+	struct libscols_table *tb;
+
+	generate_texts(be);
+
+	phase_begin(be);
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to allocate table");
+	setup_columns(be, tb);
+	add_lines(be, tb);
+	phase_end(be, "add");
+
+	scols_table_set_stream(tb, be->devnull);
+	scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+	scols_table_set_termwidth(tb, be->width);
+
+	if (be->filter) {
+		phase_begin(be);
+		apply_filter(be, tb);
+		phase_end(be, "filter");
+	}
+
+	if (be->sort) {
+		struct libscols_column *cls[2];
+		int orders[2] = { SCOLS_SORT_ASCENDING, SCOLS_SORT_ASCENDING };
+
+		cls[0] = scols_table_get_column(tb, COL_NUM);
+		cls[1] = scols_table_get_column(tb, COL_NAME);
+
+		phase_begin(be);
+		if (scols_sort_table_by_columns(tb, cls, orders, 2) != 0)
+			errx(EXIT_FAILURE, "failed to sort table");
+		phase_end(be, "sort");
+	}
+
+	/* The human output contains the columns width calculation; the
+	 * difference to the raw output is the layout cost. */
+	print_table(be, tb, "print");
+
+	scols_table_enable_json(tb, 1);
+	print_table(be, tb, "json");
+
+	scols_table_enable_raw(tb, 1);
+	print_table(be, tb, "raw");
+
+	phase_begin(be);
+	scols_unref_table(tb);
+	phase_end(be, "free");
+
+	free_texts(be);
+}
+
+static void setup_results(struct bench *be)
+{
+	struct libscols_table *tb;
+	struct libscols_column *cl;
+
+	tb = be->results = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to allocate results table");
+
+	scols_table_set_name(tb, "bench");
+
+	if (!scols_table_new_column(tb, "PHASE", 0, 0))
+		goto fail;
+
+	cl = scols_table_new_column(tb, "TIME", 0, SCOLS_FL_RIGHT);
+	if (!cl)
+		goto fail;
+	scols_column_set_json_type(cl, SCOLS_JSON_FLOAT);
+
+	cl = scols_table_new_column(tb, "ALLOC", 0, SCOLS_FL_RIGHT);
+	if (!cl)
+		goto fail;
+	scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
+
+	cl = scols_table_new_column(tb, "RSS", 0, SCOLS_FL_RIGHT);
+	if (!cl)
+		goto fail;
+	scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
+	return;
+fail:
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static int parse_type(const char *str)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_types); i++) {
+		if (strcmp(str, bench_types[i]) == 0)
+			return i;
+	}
+	errx(EXIT_FAILURE, "unsupported table type: %s", str);
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+
+	fprintf(out, "\n %s [options]\n\n", program_invocation_short_name);
+
+	fputs(" -t, --type <type>     flat, tree, groups, wrap or multibyte (default flat)\n", out);
+	fputs(" -n, --nlines <num>    number of lines (default 100000)\n", out);
+	fputs(" -c, --ntexts <num>    number of text columns (default 4)\n", out);
+	fputs(" -d, --depth <num>     tree depth or group size (default 16)\n", out);
+	fputs(" -w, --width <num>     terminal width for human output (default 160)\n", out);
+	fputs(" -Q, --filter <expr>   measure filter\n", out);
+	fputs(" -s, --sort            measure sort\n", out);
+	fputs(" -J, --json            print results in JSON\n", out);
+	fputs(" -r, --raw             print results in raw format\n", out);
+	fputs(" -h, --help            this help\n", out);
+	fputs("\n", out);
+	fputs("The ALLOC is change of allocated memory in bytes, the RSS is peak RSS in KiB.\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench be = {
+		.type	= BENCH_FLAT,
+		.nlines	= 100000,
+		.ntexts	= 4,
+		.depth	= 16,
+		.width	= 160,
+		.rand	= 88172645463325252ULL
+	};
+	int c;
+
+	static const struct option longopts[] = {
+		{ "type",   1, NULL, 't' },
+		{ "nlines", 1, NULL, 'n' },
+		{ "ntexts", 1, NULL, 'c' },
+		{ "depth",  1, NULL, 'd' },
+		{ "width",  1, NULL, 'w' },
+		{ "filter", 1, NULL, 'Q' },
+		{ "sort",   0, NULL, 's' },
+		{ "json",   0, NULL, 'J' },
+		{ "raw",    0, NULL, 'r' },
+		{ "help",   0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	setlocale(LC_ALL, "");	/* just to have enable UTF8 chars */
+	scols_init_debug(0);
+
+	setup_results(&be);
+
+	while((c = getopt_long(argc, argv, "c:d:hJn:Q:rst:w:", longopts, NULL)) != -1) {
+		switch(c) {
+		case 't':
+			be.type = parse_type(optarg);
+			break;
+		case 'n':
+			be.nlines = strtou32_or_err(optarg, "failed to parse number of lines");
+			break;
+		case 'c':
+			be.ntexts = strtou32_or_err(optarg, "failed to parse number of columns");
+			break;
+		case 'd':
+			be.depth = strtou32_or_err(optarg, "failed to parse depth");
+			if (!be.depth)
+				errx(EXIT_FAILURE, "depth has to be greater than zero");
+			break;
+		case 'w':
+			be.width = strtou32_or_err(optarg, "failed to parse terminal width");
+			break;
+		case 'Q':
+			be.filter = optarg;
+			break;
+		case 's':
+			be.sort = 1;
+			break;
+		case 'J':
+			scols_table_enable_json(be.results, 1);
+			break;
+		case 'r':
+			scols_table_enable_raw(be.results, 1);
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	be.devnull = fopen("/dev/null", "w" UL_CLOEXECSTR);
+	if (!be.devnull)
+		err(EXIT_FAILURE, "cannot open /dev/null");
+
+	run_bench(&be);
+
+	fclose(be.devnull);
+
+	scols_print_table(be.results);
+	scols_unref_table(be.results);
+	return EXIT_SUCCESS;
+}
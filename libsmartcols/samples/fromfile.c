@@ -209,6 +209,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" -c, --column <file>            column definition\n", out);
 	fputs(" -n, --nlines <num>             number of lines\n", out);
 	fputs(" -J, --json                     JSON output format\n", out);
+	fputs(" -N, --ndjson                   newline delimited JSON output format\n", out);
 	fputs(" -r, --raw                      RAW output format\n", out);
 	fputs(" -E, --export                   use key=\"value\" output format\n", out);
 	fputs(" -C, --colsep <str>             set columns separator\n", out);
@@ -240,6 +241,7 @@ int main(int argc, char *argv[])
 		{ "tree-parent-column", 1, NULL, 'p' },
 		{ "tree-id-column",	1, NULL, 'i' },
 		{ "json",   0, NULL, 'J' },
+		{ "ndjson", 0, NULL, 'N' },
 		{ "raw",    0, NULL, 'r' },
 		{ "export", 0, NULL, 'E' },
 		{ "colsep",  1, NULL, 'C' },
@@ -250,7 +252,7 @@ int main(int argc, char *argv[])
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
-		{ 'E', 'J', 'r' },
+		{ 'E', 'J', 'N', 'r' },
 		{ 'M', 'm' },
 		{ 0 }
 	};
@@ -263,7 +265,7 @@ int main(int argc, char *argv[])
 	if (!tb)
 		err(EXIT_FAILURE, "failed to create output table");
 
-	while((c = getopt_long(argc, argv, "hCc:dEi:JMmn:p:Q:rw:", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "hCc:dEi:JMmNn:p:Q:rw:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -290,6 +292,9 @@ int main(int argc, char *argv[])
 			scols_table_enable_json(tb, 1);
 			scols_table_set_name(tb, "testtable");
 			break;
+		case 'N':
+			scols_table_enable_ndjson(tb, 1);
+			break;
 		case 'm':
 			scols_table_enable_maxout(tb, TRUE);
 			break;
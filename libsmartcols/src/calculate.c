@@ -48,6 +48,19 @@ static int count_cell_width(struct libscols_table *tb,
 	char *data;
 
 	ce = scols_line_get_cell(ln, cl->seqnum);
+
+	/* Plain cell data -- use the width cached in the cell rather than
+	 * compose the buffer and count it again for each layout */
+	if (ce && !scols_column_is_tree(cl)
+	       && !scols_column_is_wrap(cl)
+	       && !scols_column_is_customwrap(cl)) {
+		len = ce->data && *ce->data ?
+			scols_cell_get_datawidth(ce, scols_table_is_noencoding(tb)) : 0;
+		ce->width = len;
+		cl->wstat.width_max = max(len, cl->wstat.width_max);
+		return 0;
+	}
+
 	scols_table_set_cursor(tb, ln, cl, ce);
 
 	rc = __cursor_to_buffer(tb, buf, 1);
@@ -151,7 +164,6 @@ static int count_column_width(struct libscols_table *tb,
 			      struct ul_buffer *buf)
 {
 	int rc = 0, no_header = 0;
-	const char *data;
 	struct libscols_wstat *st;
 	struct libscols_iter itr;
 	struct libscols_line *ln;
@@ -173,10 +185,10 @@ static int count_column_width(struct libscols_table *tb,
 
 	/* set minimal width according to header width */
 	if (!scols_table_is_noheadings(tb) &&
-	    (data = scols_cell_get_data(&cl->header))) {
+	    scols_cell_get_data(&cl->header)) {
 
-		size_t len = scols_table_is_noencoding(tb) ?
-				mbs_width(data) : mbs_safe_width(data);
+		size_t len = scols_cell_get_datawidth(&cl->header,
+					scols_table_is_noencoding(tb));
 
 		st->width_min = max(st->width_min, len);
 	} else
@@ -25,6 +25,7 @@
 #include <ctype.h>
 
 #include "smartcolsP.h"
+#include "mbsalign.h"
 
 /*
  * The cell has no ref-counting, free() and new() functions. All is
@@ -71,6 +72,7 @@ int scols_cell_set_data(struct libscols_cell *ce, const char *data)
 	ce->is_filled = 1;
 	rc = strdup_to_struct_member(ce, data, data);
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
+	ce->has_datawidth = 0;
 	return rc;
 }
 
@@ -93,6 +95,7 @@ int scols_cell_refer_data(struct libscols_cell *ce, char *data)
 	free(ce->data);
 	ce->data = data;
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
+	ce->has_datawidth = 0;
 	ce->is_filled = 1;
 	return 0;
 }
@@ -121,9 +124,33 @@ int scols_cell_refer_memory(struct libscols_cell *ce, char *data, size_t datasiz
 	free(ce->data);
 	ce->data = data;
 	ce->datasiz = datasiz;
+	ce->has_datawidth = 0;
 	return 0;
 }
 
+/*
+ * Returns number of terminal cells used by the cell data. The width is
+ * counted on the first call and cached in the cell until the data are
+ * modified by scols_cell_set_data() or scols_cell_refer_*(). The data
+ * have to be a zero terminated string.
+ */
+size_t scols_cell_get_datawidth(struct libscols_cell *ce, int noencoding)
+{
+	size_t len;
+
+	if (ce->has_datawidth && ce->datawidth_raw == !!noencoding)
+		return ce->datawidth;
+
+	len = noencoding ? mbs_width(ce->data) : mbs_safe_width(ce->data);
+	if (len == (size_t) -1)		/* ignore broken multibyte strings */
+		len = 0;
+
+	ce->datawidth = len;
+	ce->datawidth_raw = !!noencoding;
+	ce->has_datawidth = 1;
+	return len;
+}
+
 /**
  * scols_cell_get_datasiz:
  * @ce: a pointer to a struct libscols_cell instance
@@ -359,20 +359,67 @@ done:
 	return rc;
 }
 
+static int count_value(int func, unsigned long long num,
+			unsigned long long *result, int has_result)
+{
+	switch (func) {
+	case SCOLS_COUNTER_COUNT:
+		(*result)++;
+		break;
+	case SCOLS_COUNTER_MAX:
+		if (!has_result || num > *result)
+			*result = num;
+		break;
+	case SCOLS_COUNTER_MIN:
+		if (!has_result || num < *result)
+			*result = num;
+		break;
+	case SCOLS_COUNTER_SUM:
+		*result += num;
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int fetch_counter_group(struct libscols_filter *fltr,
+		struct libscols_line *ln,
+		struct libscols_counter *ct,
+		struct counter_group **gr)
+{
+	size_t i;
+
+	for (i = 0; i < ct->nkeys; i++) {
+		struct filter_param *n = ct->keys[i];
+		int rc;
+
+		n->type = SCOLS_DATA_STRING;
+		rc = fetch_holder_data(fltr, n, ln);
+		if (rc)
+			return rc;
+		ct->keydata[i] = n->empty ? NULL : n->val.str;
+	}
+
+	*gr = filter_counter_get_group(ct, ct->keydata);
+	return *gr ? 0 : -ENOMEM;
+}
+
 int filter_count_param(struct libscols_filter *fltr,
 		struct libscols_line *ln,
 		struct libscols_counter *ct)
 {
 	unsigned long long num = 0;
+	struct counter_group *gr = NULL;
+	int rc;
 
-	if (ct->func == SCOLS_COUNTER_COUNT) {
-		ct->result++;
-		return 0;
+	if (ct->nkeys) {
+		rc = fetch_counter_group(fltr, ln, ct, &gr);
+		if (rc)
+			return rc;
 	}
 
-	if (ct->param) {
-		int rc;
-
+	if (ct->func != SCOLS_COUNTER_COUNT && ct->param) {
 		ct->param->type = SCOLS_DATA_U64;
 		rc = fetch_holder_data(fltr, ct->param, ln);
 		if (rc)
@@ -384,27 +431,18 @@ int filter_count_param(struct libscols_filter *fltr,
 		num = ct->param->val.num;
 	}
 
-	switch (ct->func) {
-	case SCOLS_COUNTER_MAX:
-		if (!ct->has_result)
-			ct->result = num;
-		else if (num > ct->result)
-			ct->result = num;
-		break;
-	case SCOLS_COUNTER_MIN:
-		if (!ct->has_result)
-			ct->result = num;
-		else if (num < ct->result)
-			ct->result = num;
-		break;
-	case SCOLS_COUNTER_SUM:
-		ct->result += num;
-		break;
-	default:
-		return -EINVAL;
+	rc = count_value(ct->func, num, &ct->result, ct->has_result);
+	if (rc)
+		return rc;
+	ct->has_result = 1;
+
+	if (gr) {
+		rc = count_value(ct->func, num, &gr->result, gr->has_result);
+		if (rc)
+			return rc;
+		gr->has_result = 1;
 	}
 
-	ct->has_result = 1;
 	DBG(FLTR, ul_debugobj(fltr, "counted '%s' [result: %llu]", ct->name, ct->result));
 	return 0;
 }
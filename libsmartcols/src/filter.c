@@ -84,6 +84,29 @@ static void reset_filter(struct libscols_filter *fltr)
 	fltr->errmsg = NULL;
 }
 
+static void remove_counter_groups(struct libscols_counter *ct)
+{
+	size_t i;
+
+	while (!list_empty(&ct->groups)) {
+		struct counter_group *gr = list_entry(ct->groups.next,
+				struct counter_group, groups);
+
+		list_del_init(&gr->groups);
+		for (i = 0; i < ct->nkeys; i++)
+			free(gr->keys[i]);
+		free(gr->keys);
+		free(gr);
+	}
+
+	for (i = 0; i < ct->nkeys; i++)
+		filter_unref_node((struct filter_node *) ct->keys[i]);
+
+	free(ct->keys);
+	free(ct->keydata);
+	free(ct->buckets);
+}
+
 static void remove_counters(struct libscols_filter *fltr)
 {
 	if (!fltr)
@@ -95,6 +118,7 @@ static void remove_counters(struct libscols_filter *fltr)
 				struct libscols_counter, counters);
 
 		filter_unref_node((struct filter_node *) ct->param);
+		remove_counter_groups(ct);
 		list_del_init(&ct->counters);
 		free(ct->name);
 		free(ct);
@@ -386,9 +410,9 @@ struct libscols_counter *scols_filter_new_counter(struct libscols_filter *fltr)
 
 	ct->filter = fltr;		/* don't use ref.counting here */
 	INIT_LIST_HEAD(&ct->counters);
+	INIT_LIST_HEAD(&ct->groups);
 	list_add_tail(&ct->counters, &fltr->counters);
 
-
 	return ct;
 }
 
@@ -519,3 +543,234 @@ int scols_filter_next_counter(struct libscols_filter *fltr,
 
 	return rc;
 }
+
+/**
+ * scols_counter_add_groupby:
+ * @ct: counter instance
+ * @name: holder (column) name
+ *
+ * Adds a group-by key to the counter. If the counter has group-by keys, then
+ * the result is calculated for every unique combination of the keys data
+ * (e.g. number of files per process). The global result returned by
+ * scols_counter_get_result() is maintained too.
+ *
+ * The name is used in the same way as names in the filter expression, so the
+ * application has to assign a column to the holder by
+ * scols_filter_assign_column() before the filter is applied.
+ *
+ * Returns: 0, a negative number in case of an error.
+ *
+ * Since: 2.42
+ */
+int scols_counter_add_groupby(struct libscols_counter *ct, const char *name)
+{
+	struct filter_param **keys;
+	const char **data;
+	struct filter_node *n;
+
+	if (!ct || !name || ct->ngroups)
+		return -EINVAL;
+
+	keys = reallocarray(ct->keys, ct->nkeys + 1, sizeof(*keys));
+	if (!keys)
+		return -ENOMEM;
+	ct->keys = keys;
+
+	data = reallocarray(ct->keydata, ct->nkeys + 1, sizeof(*data));
+	if (!data)
+		return -ENOMEM;
+	ct->keydata = data;
+
+	n = filter_new_param(ct->filter, SCOLS_DATA_NONE, F_HOLDER_COLUMN, (void *) name);
+	if (!n)
+		return -ENOMEM;
+
+	ct->keys[ct->nkeys++] = (struct filter_param *) n;
+
+	DBG(FLTR, ul_debugobj(ct->filter, "counter '%s': group by %s", ct->name, name));
+	return 0;
+}
+
+/**
+ * scols_counter_get_ngroupby:
+ * @ct: counter instance
+ *
+ * Returns: number of group-by keys.
+ *
+ * Since: 2.42
+ */
+size_t scols_counter_get_ngroupby(struct libscols_counter *ct)
+{
+	return ct ? ct->nkeys : 0;
+}
+
+/**
+ * scols_counter_get_ngroups:
+ * @ct: counter instance
+ *
+ * Returns: number of groups (unique group-by keys) found in the lines.
+ *
+ * Since: 2.42
+ */
+size_t scols_counter_get_ngroups(struct libscols_counter *ct)
+{
+	return ct ? ct->ngroups : 0;
+}
+
+/**
+ * scols_counter_next_group:
+ * @ct: counter instance
+ * @itr: a pointer to a struct libscols_iter instance
+ * @keys: returns array with scols_counter_get_ngroupby() group-by keys data
+ * @result: returns result for the group
+ *
+ * Iterates over groups in the order in which they have been created. The
+ * key data are strings, an item in @keys is NULL if the column cell is empty.
+ *
+ * Returns: 0, a negative value in case of an error, and 1 at the end.
+ *
+ * Since: 2.42
+ */
+int scols_counter_next_group(struct libscols_counter *ct,
+			     struct libscols_iter *itr,
+			     const char ***keys,
+			     unsigned long long *result)
+{
+	struct counter_group *gr;
+	int rc = 1;
+
+	if (!ct || !itr)
+		return -EINVAL;
+
+	if (!itr->head)
+		SCOLS_ITER_INIT(itr, &ct->groups);
+	if (itr->p != itr->head) {
+		SCOLS_ITER_ITERATE(itr, gr, struct counter_group, groups);
+		if (keys)
+			*keys = (const char **) gr->keys;
+		if (result)
+			*result = gr->result;
+		rc = 0;
+	}
+
+	return rc;
+}
+
+/* FNV-1a, keys are separated by the terminating zero, the NULL key is hashed
+ * as an extra byte to make difference between "" and NULL */
+static unsigned int hash_group_keys(const char **keys, size_t nkeys)
+{
+	unsigned int h = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < nkeys; i++) {
+		const unsigned char *p = (const unsigned char *) keys[i];
+
+		if (p) {
+			for (; *p; p++) {
+				h ^= *p;
+				h *= 16777619U;
+			}
+		} else {
+			h ^= 0xff;
+			h *= 16777619U;
+		}
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static int is_group_keys(struct counter_group *gr, const char **keys, size_t nkeys)
+{
+	size_t i;
+
+	for (i = 0; i < nkeys; i++) {
+		if (!gr->keys[i] || !keys[i]) {
+			if (gr->keys[i] != keys[i])
+				return 0;
+		} else if (strcmp(gr->keys[i], keys[i]) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+static int resize_groups_hash(struct libscols_counter *ct)
+{
+	size_t i, sz = ct->nbuckets ? ct->nbuckets * 2 : 64;
+	struct counter_group **buckets = calloc(sz, sizeof(*buckets));
+
+	if (!buckets)
+		return -ENOMEM;
+
+	for (i = 0; i < ct->nbuckets; i++) {
+		struct counter_group *gr = ct->buckets[i];
+
+		while (gr) {
+			struct counter_group *next = gr->next;
+			size_t x = gr->hash & (sz - 1);
+
+			gr->next = buckets[x];
+			buckets[x] = gr;
+			gr = next;
+		}
+	}
+
+	DBG(FLTR, ul_debugobj(ct->filter, "counter '%s': groups hash %zu -> %zu",
+				ct->name, ct->nbuckets, sz));
+	free(ct->buckets);
+	ct->buckets = buckets;
+	ct->nbuckets = sz;
+	return 0;
+}
+
+/* Returns group for the @keys, the new group is allocated if not found. */
+struct counter_group *filter_counter_get_group(struct libscols_counter *ct,
+					       const char **keys)
+{
+	struct counter_group *gr;
+	unsigned int h = hash_group_keys(keys, ct->nkeys);
+	size_t i, x;
+
+	if (ct->nbuckets) {
+		for (gr = ct->buckets[h & (ct->nbuckets - 1)]; gr; gr = gr->next) {
+			if (gr->hash == h && is_group_keys(gr, keys, ct->nkeys))
+				return gr;
+		}
+	}
+
+	if (ct->ngroups >= ct->nbuckets && resize_groups_hash(ct) != 0)
+		return NULL;
+
+	gr = calloc(1, sizeof(*gr));
+	if (!gr)
+		return NULL;
+	gr->keys = calloc(ct->nkeys, sizeof(char *));
+	if (!gr->keys)
+		goto fail;
+	for (i = 0; i < ct->nkeys; i++) {
+		if (!keys[i])
+			continue;
+		gr->keys[i] = strdup(keys[i]);
+		if (!gr->keys[i])
+			goto fail;
+	}
+
+	gr->hash = h;
+	x = h & (ct->nbuckets - 1);
+	gr->next = ct->buckets[x];
+	ct->buckets[x] = gr;
+
+	INIT_LIST_HEAD(&gr->groups);
+	list_add_tail(&gr->groups, &ct->groups);
+	ct->ngroups++;
+
+	return gr;
+fail:
+	if (gr->keys) {
+		for (i = 0; i < ct->nkeys; i++)
+			free(gr->keys[i]);
+		free(gr->keys);
+	}
+	free(gr);
+	return NULL;
+}
@@ -116,7 +116,7 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	}
 	if (list_empty(&tb->tb_lines)) {
 		DBG(TAB, ul_debugobj(tb, "ignore -- no lines"));
-		if (scols_table_is_json(tb)) {
+		if (scols_table_is_json(tb) && !scols_table_is_ndjson(tb)) {
 			ul_jsonwrt_init(&tb->json, tb->out, 0);
 			ul_jsonwrt_root_open(&tb->json);
 			ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
@@ -132,7 +132,7 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	if (rc)
 		return rc;
 
-	if (scols_table_is_json(tb)) {
+	if (scols_table_is_json(tb) && !scols_table_is_ndjson(tb)) {
 		ul_jsonwrt_root_open(&tb->json);
 		ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
 	}
@@ -149,7 +149,7 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	else
 		rc = __scols_print_table(tb, &buf);
 
-	if (scols_table_is_json(tb)) {
+	if (scols_table_is_json(tb) && !scols_table_is_ndjson(tb)) {
 		ul_jsonwrt_array_close(&tb->json);
 		ul_jsonwrt_root_close(&tb->json);
 	}
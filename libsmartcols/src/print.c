@@ -1280,6 +1280,7 @@ int __scols_initialize_printing(struct libscols_table *tb, struct ul_buffer *buf
 		break;
 	case SCOLS_FMT_JSON:
 		ul_jsonwrt_init(&tb->json, tb->out, 0);
+		ul_jsonwrt_set_compact(&tb->json, tb->ndjson);
 		extra_bufsz += tb->nlines * 3;		/* indentation */
 		FALLTHROUGH;
 	case SCOLS_FMT_EXPORT:
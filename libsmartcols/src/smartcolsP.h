@@ -90,12 +90,16 @@ struct libscols_cell {
 	void    *userdata;
 	int	flags;
 	size_t	width;
+	size_t	datawidth;	/* cached width of data, see scols_cell_get_datawidth() */
 
 	unsigned int is_filled : 1,
-		     no_uri : 1;
+		     no_uri : 1,
+		     has_datawidth : 1,	/* datawidth is valid */
+		     datawidth_raw : 1;	/* datawidth counted without encoding */
 };
 
 extern int scols_line_move_cells(struct libscols_line *ln, size_t newn, size_t oldn);
+extern size_t scols_cell_get_datawidth(struct libscols_cell *ce, int noencoding);
 
 struct libscols_wstat {
 	size_t	width_min;
@@ -215,6 +219,14 @@ struct libscols_line {
 	struct libscols_group	*group;		/* for group members */
 };
 
+/*
+ * Sort key (see sort.c)
+ */
+struct libscols_sortkey {
+	struct libscols_column	*column;
+	int			order;		/* SCOLS_SORT_* */
+};
+
 enum {
 	SCOLS_FMT_HUMAN = 0,		/* default, human readable */
 	SCOLS_FMT_RAW,			/* space separated */
@@ -250,7 +262,8 @@ struct libscols_table {
 	size_t			ngrpchlds_pending;	/* groups with not yet printed children */
 	struct libscols_line	*walk_last_tree_root;	/* last root, used by scols_walk_() */
 
-	struct libscols_column	*dflt_sort_column;	/* default sort column, set by scols_sort_table() */
+	struct libscols_sortkey	*sortkeys;	/* default sort columns, set by scols_sort_table() */
+	size_t			nsortkeys;
 
 	struct libscols_symbols	*symbols;
 	struct libscols_cell	title;		/* optional table title (for humans) */
@@ -276,6 +289,7 @@ struct libscols_table {
 			is_dummy_print,	/* printing used for width calculation only */
 			is_shellvar   ,	/* shell compatible column names */
 			maxout	      ,	/* maximize output */
+			ndjson	      ,	/* JSON, one object per line */
 			minout	      ,	/* minimize output (mutually exclusive to maxout) */
 			header_repeat , /* print header after libscols_table->termheight */
 			header_printed,	/* header already printed */
@@ -371,6 +385,11 @@ extern int scols_walk_tree(struct libscols_table *tb,
                     void *data);
 extern int scols_walk_is_last(struct libscols_table *tb, struct libscols_line *ln);
 
+/*
+ * sort.c
+ */
+void scols_table_remove_sortkey(struct libscols_table *tb, struct libscols_column *cl);
+
 /*
  * calculate.c
  */
@@ -533,6 +552,18 @@ struct filter_node {
 struct filter_param;
 struct filter_expr;
 
+/* result for lines with the same group-by key(s), see scols_counter_add_groupby() */
+struct counter_group {
+	struct list_head groups;	/* all groups in order of creation */
+	struct counter_group *next;	/* next in the hash bucket */
+	unsigned int hash;
+
+	char **keys;			/* libscols_counter->nkeys strings */
+	unsigned long long result;
+
+	unsigned int has_result : 1;
+};
+
 struct libscols_counter {
 	char *name;
 	struct list_head counters;
@@ -542,6 +573,15 @@ struct libscols_counter {
 	int func;
 	unsigned long long result;
 
+	struct filter_param **keys;	/* group-by holders */
+	const char **keydata;		/* keys data for the current line */
+	size_t nkeys;
+
+	struct counter_group **buckets;	/* groups hash table */
+	size_t nbuckets;
+	size_t ngroups;
+	struct list_head groups;
+
 	unsigned int neg : 1,
 		     has_result : 1;
 };
@@ -595,6 +635,10 @@ int filter_count_param(struct libscols_filter *fltr,
                 struct libscols_line *ln,
                 struct libscols_counter *ct);
 
+/* counters */
+struct counter_group *filter_counter_get_group(struct libscols_counter *ct,
+                const char **keys);
+
 /* expr */
 void filter_free_expr(struct filter_expr *n);
 void filter_dump_expr(struct ul_jsonwrt *json, struct filter_expr *n);
@@ -0,0 +1,505 @@
+/*
+ * sort.c - functions to order lines in the table
+ *
+ * Copyright (C) 2010-2025 Karel Zak <kzak@redhat.com>
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "cctype.h"
+#include "smartcolsP.h"
+
+/*
+ * The lines are not sorted directly in the linked lists. The list is
+ * converted to array, sort keys are precomputed for each line (so data are
+ * not converted on every comparison), the array is sorted by qsort() and the
+ * list is composed again. The original position is used as the last key to
+ * keep the sort stable.
+ */
+
+/* sort key type, SCOLS_DATA_* or: */
+#define SORT_BY_CMPFUNC		(-1)
+
+struct sort_value {
+	union {
+		const char *str;
+		struct libscols_cell *cell;
+		unsigned long long num;
+		long double fnum;
+		bool boolean;
+	} v;
+	bool empty;
+};
+
+struct sort_ctx {
+	struct libscols_sortkey *keys;
+	size_t nkeys;
+	int *types;
+};
+
+struct sort_item {
+	struct list_head *entry;	/* line list entry */
+	size_t idx;			/* original position */
+	struct sort_value *vals;	/* ctx->nkeys values */
+	const struct sort_ctx *ctx;
+};
+
+static int sortkey_get_type(const struct libscols_sortkey *key)
+{
+	const struct libscols_column *cl = key->column;
+
+	if (cl->cmpfunc)
+		return SORT_BY_CMPFUNC;
+	if (cl->data_type)
+		return cl->data_type;
+
+	/* the same fallback as for filters */
+	switch (cl->json_type) {
+	case SCOLS_JSON_NUMBER:
+		return SCOLS_DATA_U64;
+	case SCOLS_JSON_BOOLEAN:
+		return SCOLS_DATA_BOOLEAN;
+	case SCOLS_JSON_FLOAT:
+		return SCOLS_DATA_FLOAT;
+	default:
+		break;
+	}
+	return SCOLS_DATA_STRING;
+}
+
+static void set_sort_value(struct libscols_column *cl, int type,
+			   struct libscols_line *ln, struct sort_value *val)
+{
+	struct libscols_cell *ce = scols_line_get_cell(ln, cl->seqnum);
+	const char *str;
+	void *data = NULL;
+
+	val->empty = 0;
+
+	if (type == SORT_BY_CMPFUNC) {
+		val->v.cell = ce;
+		return;
+	}
+
+	if (type != SCOLS_DATA_STRING && ce && cl->datafunc) {
+		data = cl->datafunc(cl, ce, cl->datafunc_data);
+		if (!data) {
+			val->empty = 1;
+			return;
+		}
+		switch (type) {
+		case SCOLS_DATA_U64:
+			val->v.num = *((unsigned long long *) data);
+			break;
+		case SCOLS_DATA_FLOAT:
+			val->v.fnum = *((long double *) data);
+			break;
+		case SCOLS_DATA_BOOLEAN:
+			val->v.boolean = *((bool *) data) == 0 ? 0 : 1;
+			break;
+		}
+		return;
+	}
+
+	str = ce ? scols_cell_get_data(ce) : NULL;
+	if (!str || !*str) {
+		val->empty = 1;
+		return;
+	}
+
+	switch (type) {
+	case SCOLS_DATA_U64:
+	{
+		uint64_t num;
+
+		if (ul_strtou64(str, &num, 10) == 0)
+			val->v.num = num;
+		else
+			val->empty = 1;
+		break;
+	}
+	case SCOLS_DATA_FLOAT:
+		if (ul_strtold(str, &val->v.fnum) != 0)
+			val->empty = 1;
+		break;
+	case SCOLS_DATA_BOOLEAN:
+		val->v.boolean = strcmp(str, "1") == 0
+				 || c_strcasecmp(str, "true") == 0;
+		break;
+	case SCOLS_DATA_STRING:
+	default:
+		val->v.str = str;
+		break;
+	}
+}
+
+static int cmp_sort_values(const struct libscols_sortkey *key, int type,
+			   const struct sort_value *a, const struct sort_value *b)
+{
+	int rc;
+
+	if (type == SORT_BY_CMPFUNC)
+		return key->column->cmpfunc(a->v.cell, b->v.cell,
+					    key->column->cmpfunc_data);
+	if (a->empty || b->empty)
+		return a->empty && b->empty ? 0 : a->empty ? -1 : 1;
+
+	switch (type) {
+	case SCOLS_DATA_U64:
+		rc = cmp_numbers(a->v.num, b->v.num);
+		break;
+	case SCOLS_DATA_FLOAT:
+		rc = a->v.fnum < b->v.fnum ? -1 : a->v.fnum > b->v.fnum ? 1 : 0;
+		break;
+	case SCOLS_DATA_BOOLEAN:
+		rc = cmp_numbers(a->v.boolean, b->v.boolean);
+		break;
+	case SCOLS_DATA_STRING:
+	default:
+		rc = strcoll(a->v.str, b->v.str);
+		break;
+	}
+	return rc;
+}
+
+static int cmp_sort_items(const void *x, const void *y)
+{
+	const struct sort_item *a = (const struct sort_item *) x,
+			       *b = (const struct sort_item *) y;
+	const struct sort_ctx *ctx = a->ctx;
+	size_t i;
+
+	for (i = 0; i < ctx->nkeys; i++) {
+		int rc = cmp_sort_values(&ctx->keys[i], ctx->types[i],
+					 &a->vals[i], &b->vals[i]);
+		if (rc)
+			return ctx->keys[i].order == SCOLS_SORT_DESCENDING ? -rc : rc;
+	}
+
+	return cmp_numbers(a->idx, b->idx);
+}
+
+/* @member is offset of the list_head in the struct libscols_line */
+static int sort_list(const struct sort_ctx *ctx, struct list_head *head, size_t member)
+{
+	struct sort_item *items;
+	struct sort_value *vals;
+	struct list_head *p;
+	size_t i, n = list_count_entries(head);
+
+	if (n < 2)
+		return 0;
+
+	items = malloc(n * sizeof(*items));
+	vals = malloc(n * ctx->nkeys * sizeof(*vals));
+	if (!items || !vals) {
+		free(items);
+		free(vals);
+		return -ENOMEM;
+	}
+
+	i = 0;
+	list_for_each(p, head) {
+		struct libscols_line *ln = (struct libscols_line *) ((char *) p - member);
+		struct sort_item *it = &items[i];
+		size_t k;
+
+		it->entry = p;
+		it->idx = i;
+		it->ctx = ctx;
+		it->vals = &vals[i * ctx->nkeys];
+
+		for (k = 0; k < ctx->nkeys; k++)
+			set_sort_value(ctx->keys[k].column, ctx->types[k], ln, &it->vals[k]);
+		i++;
+	}
+
+	qsort(items, n, sizeof(*items), cmp_sort_items);
+
+	INIT_LIST_HEAD(head);
+	for (i = 0; i < n; i++)
+		list_add_tail(items[i].entry, head);
+
+	free(vals);
+	free(items);
+	return 0;
+}
+
+static int sort_line_children(const struct sort_ctx *ctx, struct libscols_line *ln)
+{
+	struct list_head *p;
+	int rc = 0;
+
+	if (!list_empty(&ln->ln_branch)) {
+		list_for_each(p, &ln->ln_branch) {
+			struct libscols_line *chld =
+					list_entry(p, struct libscols_line, ln_children);
+			rc = sort_line_children(ctx, chld);
+			if (rc)
+				return rc;
+		}
+
+		rc = sort_list(ctx, &ln->ln_branch,
+				offsetof(struct libscols_line, ln_children));
+		if (rc)
+			return rc;
+	}
+
+	if (is_first_group_member(ln)) {
+		list_for_each(p, &ln->group->gr_children) {
+			struct libscols_line *chld =
+					list_entry(p, struct libscols_line, ln_children);
+			rc = sort_line_children(ctx, chld);
+			if (rc)
+				return rc;
+		}
+
+		rc = sort_list(ctx, &ln->group->gr_children,
+				offsetof(struct libscols_line, ln_children));
+	}
+
+	return rc;
+}
+
+static int init_sort_ctx(struct libscols_table *tb, struct sort_ctx *ctx)
+{
+	size_t i;
+
+	ctx->keys = tb->sortkeys;
+	ctx->nkeys = tb->nsortkeys;
+	ctx->types = malloc(ctx->nkeys * sizeof(int));
+	if (!ctx->types)
+		return -ENOMEM;
+
+	for (i = 0; i < ctx->nkeys; i++)
+		ctx->types[i] = sortkey_get_type(&ctx->keys[i]);
+	return 0;
+}
+
+static int __scols_sort_tree(struct libscols_table *tb)
+{
+	struct libscols_line *ln;
+	struct libscols_iter itr;
+	struct sort_ctx ctx;
+	int rc;
+
+	if (!tb->nsortkeys)
+		return -EINVAL;
+
+	rc = init_sort_ctx(tb, &ctx);
+	if (rc)
+		return rc;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (rc == 0 && scols_table_next_line(tb, &itr, &ln) == 0)
+		rc = sort_line_children(&ctx, ln);
+
+	free(ctx.types);
+	return rc;
+}
+
+static int __scols_sort_table(struct libscols_table *tb)
+{
+	struct sort_ctx ctx;
+	int rc;
+
+	rc = init_sort_ctx(tb, &ctx);
+	if (rc)
+		return rc;
+
+	DBG(TAB, ul_debugobj(tb, "sorting table by %zu column(s)", ctx.nkeys));
+	rc = sort_list(&ctx, &tb->tb_lines, offsetof(struct libscols_line, ln_lines));
+
+	if (rc == 0 && scols_table_is_tree(tb)) {
+		struct libscols_line *ln;
+		struct libscols_iter itr;
+
+		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+		while (rc == 0 && scols_table_next_line(tb, &itr, &ln) == 0)
+			rc = sort_line_children(&ctx, ln);
+	}
+
+	free(ctx.types);
+	return rc;
+}
+
+static int set_sortkeys(struct libscols_table *tb,
+			struct libscols_column **cls, const int *orders,
+			size_t ncls)
+{
+	struct libscols_sortkey *keys;
+	size_t i;
+
+	keys = calloc(ncls, sizeof(*keys));
+	if (!keys)
+		return -ENOMEM;
+
+	for (i = 0; i < ncls; i++) {
+		if (!cls[i] || (orders && orders[i] != SCOLS_SORT_ASCENDING
+					 && orders[i] != SCOLS_SORT_DESCENDING)) {
+			free(keys);
+			return -EINVAL;
+		}
+		keys[i].column = cls[i];
+		keys[i].order = orders ? orders[i] : SCOLS_SORT_ASCENDING;
+	}
+
+	free(tb->sortkeys);
+	tb->sortkeys = keys;
+	tb->nsortkeys = ncls;
+	return 0;
+}
+
+/* removes @cl from the table sort keys */
+void scols_table_remove_sortkey(struct libscols_table *tb, struct libscols_column *cl)
+{
+	size_t i;
+
+	for (i = 0; i < tb->nsortkeys; ) {
+		if (tb->sortkeys[i].column == cl) {
+			memmove(&tb->sortkeys[i], &tb->sortkeys[i + 1],
+				(tb->nsortkeys - i - 1) * sizeof(*tb->sortkeys));
+			tb->nsortkeys--;
+		} else
+			i++;
+	}
+}
+
+/**
+ * scols_sort_table:
+ * @tb: table
+ * @cl: order by this column or NULL
+ *
+ * Orders the table by the column. See also scols_column_set_cmpfunc(). If the
+ * tree output is enabled then children in the tree are recursively sorted too.
+ *
+ * The column @cl is saved as the default sort column to the @tb and the next time
+ * is possible to call scols_sort_table(tb, NULL). The saved column is also used by
+ * scols_sort_table_by_tree().
+ *
+ * Returns: 0, a negative value in case of an error.
+ */
+int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
+{
+	int rc;
+
+	if (!tb)
+		return -EINVAL;
+	if (cl) {
+		if (!cl->cmpfunc)
+			return -EINVAL;
+		rc = set_sortkeys(tb, &cl, NULL, 1);
+		if (rc)
+			return rc;
+	} else if (!tb->nsortkeys)
+		return -EINVAL;
+
+	return __scols_sort_table(tb);
+}
+
+/**
+ * scols_sort_table_by_columns:
+ * @tb: table
+ * @cls: array with columns
+ * @orders: array with SCOLS_SORT_{ASCENDING,DESCENDING} or NULL
+ * @ncls: number of items in @cls (and @orders)
+ *
+ * Orders the table by more columns; the next column is used if the previous
+ * columns are equal. The lines with the same data in all the columns keep their
+ * original order. If @orders is NULL then all columns are sorted in ascending order.
+ *
+ * The column compare function (see scols_column_set_cmpfunc()) is used if
+ * defined, otherwise the data are compared according to the column data type
+ * (see scols_column_set_data_type() and scols_column_set_data_func()) or
+ * according to the column JSON type. Empty cells are sorted before the others.
+ *
+ * If the tree output is enabled then children in the tree are recursively
+ * sorted too. The columns are saved as the default sort columns in the same
+ * way as by scols_sort_table().
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.42
+ */
+int scols_sort_table_by_columns(struct libscols_table *tb,
+				struct libscols_column **cls,
+				const int *orders,
+				size_t ncls)
+{
+	size_t i;
+	int rc;
+
+	if (!tb || !cls || !ncls)
+		return -EINVAL;
+	for (i = 0; i < ncls; i++) {
+		if (cls[i] && cls[i]->table != tb)
+			return -EINVAL;
+	}
+
+	rc = set_sortkeys(tb, cls, orders, ncls);
+	if (rc)
+		return rc;
+
+	return __scols_sort_table(tb);
+}
+
+/*
+ * Move all @ln's children after @ln in the table.
+ */
+static struct libscols_line *move_line_and_children(struct libscols_line *ln, struct libscols_line *pre)
+{
+	if (pre) {
+		list_del_init(&ln->ln_lines);			/* remove from old position */
+	        list_add(&ln->ln_lines, &pre->ln_lines);        /* add to the new place (after @pre) */
+	}
+	pre = ln;
+
+	if (!list_empty(&ln->ln_branch)) {
+		struct list_head *p;
+
+		list_for_each(p, &ln->ln_branch) {
+			struct libscols_line *chld =
+					list_entry(p, struct libscols_line, ln_children);
+			pre = move_line_and_children(chld, pre);
+		}
+	}
+
+	return pre;
+}
+
+/**
+ * scols_sort_table_by_tree:
+ * @tb: table
+ *
+ * Reorders lines in the table by parent->child relation. Note that order of
+ * the lines in the table is independent on the tree hierarchy by default.
+ *
+ * The children of the lines are sorted according to the default sort columns
+ * if scols_sort_table() or scols_sort_table_by_columns() has been previously called.
+ *
+ * Since: 2.30
+ *
+ * Returns: 0, a negative value in case of an error.
+ */
+int scols_sort_table_by_tree(struct libscols_table *tb)
+{
+	struct libscols_line *ln;
+	struct libscols_iter itr;
+
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "sorting table by tree"));
+
+	if (tb->nsortkeys)
+		__scols_sort_tree(tb);
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_line(tb, &itr, &ln) == 0)
+		move_line_and_children(ln, NULL);
+
+	return 0;
+}
@@ -131,6 +131,7 @@ void scols_unref_table(struct libscols_table *tb)
 		scols_unref_symbols(tb->symbols);
 		scols_reset_cell(&tb->title);
 		free(tb->grpset);
+		free(tb->sortkeys);
 		free(tb->linesep);
 		free(tb->colsep);
 		free(tb->name);
@@ -270,8 +271,7 @@ int scols_table_remove_column(struct libscols_table *tb,
 
 	if (cl->flags & SCOLS_FL_TREE)
 		tb->ntreecols--;
-	if (tb->dflt_sort_column == cl)
-		tb->dflt_sort_column = NULL;
+	scols_table_remove_sortkey(tb, cl);
 
 	DBG(TAB, ul_debugobj(tb, "remove column"));
 	list_del_init(&cl->cl_columns);
@@ -1158,6 +1158,38 @@ int scols_table_enable_json(struct libscols_table *tb, int enable)
 		tb->format = SCOLS_FMT_JSON;
 	else if (tb->format == SCOLS_FMT_JSON)
 		tb->format = 0;
+	tb->ndjson = 0;
+	return 0;
+}
+
+/**
+ * scols_table_enable_ndjson:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable newline delimited JSON output format (aka NDJSON or JSON
+ * Lines). Every table line is printed as a compact JSON object terminated by
+ * \n, the output is not enclosed in a top-level object and array. The tree
+ * children are embedded in the object of the tree root, like for JSON.
+ *
+ * The format is suitable for streaming; every output line may be parsed
+ * independently. The parsable output formats are mutually exclusive.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.42
+ */
+int scols_table_enable_ndjson(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "ndjson: %s", enable ? "ENABLE" : "DISABLE"));
+	if (enable)
+		tb->format = SCOLS_FMT_JSON;
+	else if (scols_table_is_ndjson(tb))
+		tb->format = 0;
+	tb->ndjson = enable ? 1 : 0;
 	return 0;
 }
 
@@ -1497,6 +1529,21 @@ int scols_table_is_json(const struct libscols_table *tb)
 	return tb->format == SCOLS_FMT_JSON;
 }
 
+/**
+ * scols_table_is_ndjson:
+ * @tb: table
+ *
+ * Note that scols_table_is_json() returns 1 for NDJSON too.
+ *
+ * Returns: 1 if newline delimited JSON output format is enabled.
+ *
+ * Since: 2.42
+ */
+int scols_table_is_ndjson(const struct libscols_table *tb)
+{
+	return tb->format == SCOLS_FMT_JSON && tb->ndjson;
+}
+
 /**
  * scols_table_is_maxout
  * @tb: table
@@ -1581,180 +1628,6 @@ const char *scols_table_get_line_separator(const struct libscols_table *tb)
 {
 	return tb->linesep;
 }
-/* for lines in the struct libscols_line->ln_lines list */
-static int cells_cmp_wrapper_lines(struct list_head *a, struct list_head *b, void *data)
-{
-	struct libscols_column *cl = (struct libscols_column *) data;
-	struct libscols_line *ra, *rb;
-	struct libscols_cell *ca, *cb;
-
-	assert(a);
-	assert(b);
-	assert(cl);
-
-	ra = list_entry(a, struct libscols_line, ln_lines);
-	rb = list_entry(b, struct libscols_line, ln_lines);
-	ca = scols_line_get_cell(ra, cl->seqnum);
-	cb = scols_line_get_cell(rb, cl->seqnum);
-
-	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
-}
-
-/* for lines in the struct libscols_line->ln_children list */
-static int cells_cmp_wrapper_children(struct list_head *a, struct list_head *b, void *data)
-{
-	struct libscols_column *cl = (struct libscols_column *) data;
-	struct libscols_line *ra, *rb;
-	struct libscols_cell *ca, *cb;
-
-	assert(a);
-	assert(b);
-	assert(cl);
-
-	ra = list_entry(a, struct libscols_line, ln_children);
-	rb = list_entry(b, struct libscols_line, ln_children);
-	ca = scols_line_get_cell(ra, cl->seqnum);
-	cb = scols_line_get_cell(rb, cl->seqnum);
-
-	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
-}
-
-
-static int sort_line_children(struct libscols_line *ln, struct libscols_column *cl)
-{
-	struct list_head *p;
-
-	if (!list_empty(&ln->ln_branch)) {
-		list_for_each(p, &ln->ln_branch) {
-			struct libscols_line *chld =
-					list_entry(p, struct libscols_line, ln_children);
-			sort_line_children(chld, cl);
-		}
-
-		list_sort(&ln->ln_branch, cells_cmp_wrapper_children, cl);
-	}
-
-	if (is_first_group_member(ln)) {
-		list_for_each(p, &ln->group->gr_children) {
-			struct libscols_line *chld =
-					list_entry(p, struct libscols_line, ln_children);
-			sort_line_children(chld, cl);
-		}
-
-		list_sort(&ln->group->gr_children, cells_cmp_wrapper_children, cl);
-	}
-
-	return 0;
-}
-
-static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column *cl)
-{
-	struct libscols_line *ln;
-	struct libscols_iter itr;
-
-	if (!tb || !cl || !cl->cmpfunc)
-		return -EINVAL;
-
-	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0)
-		sort_line_children(ln, cl);
-	return 0;
-}
-
-/**
- * scols_sort_table:
- * @tb: table
- * @cl: order by this column or NULL
- *
- * Orders the table by the column. See also scols_column_set_cmpfunc(). If the
- * tree output is enabled then children in the tree are recursively sorted too.
- *
- * The column @cl is saved as the default sort column to the @tb and the next time
- * is possible to call scols_sort_table(tb, NULL). The saved column is also used by
- * scols_sort_table_by_tree().
- *
- * Returns: 0, a negative value in case of an error.
- */
-int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
-{
-	if (!tb)
-		return -EINVAL;
-	if (!cl)
-		cl = tb->dflt_sort_column;
-	if (!cl || !cl->cmpfunc)
-		return -EINVAL;
-
-	DBG(TAB, ul_debugobj(tb, "sorting table by %zu column", cl->seqnum));
-	list_sort(&tb->tb_lines, cells_cmp_wrapper_lines, cl);
-
-	if (scols_table_is_tree(tb))
-		__scols_sort_tree(tb, cl);
-
-	if (cl && cl != tb->dflt_sort_column)
-		tb->dflt_sort_column = cl;
-
-	return 0;
-}
-
-/*
- * Move all @ln's children after @ln in the table.
- */
-static struct libscols_line *move_line_and_children(struct libscols_line *ln, struct libscols_line *pre)
-{
-	if (pre) {
-		list_del_init(&ln->ln_lines);			/* remove from old position */
-	        list_add(&ln->ln_lines, &pre->ln_lines);        /* add to the new place (after @pre) */
-	}
-	pre = ln;
-
-	if (!list_empty(&ln->ln_branch)) {
-		struct list_head *p;
-
-		list_for_each(p, &ln->ln_branch) {
-			struct libscols_line *chld =
-					list_entry(p, struct libscols_line, ln_children);
-			pre = move_line_and_children(chld, pre);
-		}
-	}
-
-	return pre;
-}
-
-/**
- * scols_sort_table_by_tree:
- * @tb: table
- *
- * Reorders lines in the table by parent->child relation. Note that order of
- * the lines in the table is independent on the tree hierarchy by default.
- *
- * The children of the lines are sorted according to the default sort column
- * if scols_sort_table() has been previously called.
- *
- * Since: 2.30
- *
- * Returns: 0, a negative value in case of an error.
- */
-int scols_sort_table_by_tree(struct libscols_table *tb)
-{
-	struct libscols_line *ln;
-	struct libscols_iter itr;
-
-	if (!tb)
-		return -EINVAL;
-
-	DBG(TAB, ul_debugobj(tb, "sorting table by tree"));
-
-	if (tb->dflt_sort_column)
-		__scols_sort_tree(tb, tb->dflt_sort_column);
-
-	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0)
-		move_line_and_children(ln, NULL);
-
-	return 0;
-}
-
-
 /**
  * scols_table_set_termforce:
  * @tb: table
@@ -56,6 +56,9 @@
 #ifdef HAVE_SYS_FILE_H
 #include <sys/file.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_SYS_IOCTL_H
 #include <sys/ioctl.h>
 #endif
@@ -124,10 +127,15 @@ static int getuid (void)
 #ifdef TEST_PROGRAM
 #define gettimeofday gettimeofday_fixed
 
+/* the clock does not move unless the test moves it */
+static struct timeval test_clock = {
+	.tv_sec = 1645557742,
+	.tv_usec = 123456
+};
+
 static int gettimeofday_fixed(struct timeval *tv, void *tz __attribute__((unused)))
 {
-	tv->tv_sec = 1645557742;
-	tv->tv_usec = 123456;
+	*tv = test_clock;
 	return 0;
 }
 #endif
@@ -246,6 +254,160 @@ static int state_fd_init(const char *clock_file, FILE **fp)
 /* Reserve a clock_seq value for the 'continuous clock' implementation */
 #define CLOCK_SEQ_CONT 0
 
+/*
+ * Get current time in 100ns ticks.
+ */
+static uint64_t get_clock_counter(void)
+{
+	struct timeval tv;
+	uint64_t clock_reg;
+
+	gettimeofday(&tv, NULL);
+	clock_reg = tv.tv_usec*10;
+	clock_reg += ((uint64_t) tv.tv_sec) * 10000000ULL;
+
+	return clock_reg;
+}
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_POSIX_FALLOCATE) && \
+    defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+# define USE_CLOCK_STATE_MMAP
+/*
+ * Clock state shared by all processes by mmap()ed LIBUUID_CLOCK_STATE_FILE.
+ *
+ * The last used time (in 100ns ticks since 1970) and the number of clock
+ * sequence changes are kept in one 64-bit word updated by compare-and-swap.
+ * The file is locked by flock() only when it's initialized, generating of
+ * UUIDs does not need any syscall (except gettimeofday() which is usually
+ * vDSO). The kernel writes the mapped state back to the file.
+ *
+ * The clock sequence is the random value from the file incremented by the
+ * number of changes, it's changed when the clock goes back more than
+ * CLOCK_STATE_MAX_BACKWARD, otherwise UUIDs continue from the last used time.
+ */
+struct uuid_clock_state {
+	char		magic[8];
+	uint32_t	clock_seq;	/* random base of the clock sequence */
+	uint32_t	reserved;
+	uint64_t	state;		/* changes << 56 | last used ticks */
+};
+
+#define CLOCK_STATE_MAGIC		"uuidclk1"
+#define CLOCK_STATE_TICKS_BITS		56	/* good enough to year 2198 */
+#define CLOCK_STATE_TICKS_MASK		((1ULL << CLOCK_STATE_TICKS_BITS) - 1)
+#define CLOCK_STATE_MAX_BACKWARD	(10 * 10000000ULL)	/* 10s */
+
+static struct uuid_clock_state *clock_state;
+
+#ifdef TEST_PROGRAM
+static const char *clock_state_file = LIBUUID_CLOCK_STATE_FILE;
+#else
+# define clock_state_file LIBUUID_CLOCK_STATE_FILE
+#endif
+
+static void clock_state_init(void)
+{
+	struct uuid_clock_state *cs;
+	mode_t save_umask;
+	int fd;
+
+	save_umask = umask(0);
+	fd = open(clock_state_file, O_RDWR|O_CREAT|O_CLOEXEC, 0660);
+	(void) umask(save_umask);
+	if (fd < 0)
+		return;
+
+	while (flock(fd, LOCK_EX) < 0) {
+		if (errno != EAGAIN && errno != EINTR)
+			goto done;
+	}
+	/* Allocate the blocks now, a sparse file would be allocated on the
+	 * first write to the mapping and ENOSPC would kill us by SIGBUS. */
+	if (posix_fallocate(fd, 0, sizeof(*cs)) != 0)
+		goto done;
+
+	cs = mmap(NULL, sizeof(*cs), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (cs == MAP_FAILED)
+		goto done;
+
+	if (memcmp(cs->magic, CLOCK_STATE_MAGIC, sizeof(cs->magic)) != 0) {
+		uint32_t seq;
+
+		ul_random_get_bytes(&seq, sizeof(seq));
+		cs->clock_seq = seq;
+		cs->reserved = 0;
+		__atomic_store_n(&cs->state, 0, __ATOMIC_RELAXED);
+		memcpy(cs->magic, CLOCK_STATE_MAGIC, sizeof(cs->magic));
+		msync(cs, sizeof(*cs), MS_SYNC);
+	}
+	clock_state = cs;
+done:
+	close(fd);		/* unlocks the file */
+}
+
+static struct uuid_clock_state *get_clock_state(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	pthread_once(&once, clock_state_init);
+#else
+	static int has_init;
+
+	if (!has_init) {
+		clock_state_init();
+		has_init = 1;
+	}
+#endif
+	return clock_state;
+}
+
+/*
+ * Get clock from the shared clock state.
+ *
+ * Return -1 if the state file is not usable, otherwise return 0.
+ */
+static int get_clock_shared(uint32_t *clock_high, uint32_t *clock_low,
+			    uint16_t *ret_clock_seq, int *num)
+{
+	struct uuid_clock_state *cs = get_clock_state();
+	uint64_t old, new, now, first, n = 1;
+	unsigned int changes;
+
+	if (!cs)
+		return -1;
+	if (num && *num > 1)
+		n = *num;
+
+	now = get_clock_counter();
+	old = __atomic_load_n(&cs->state, __ATOMIC_RELAXED);
+	do {
+		uint64_t last = old & CLOCK_STATE_TICKS_MASK;
+
+		changes = old >> CLOCK_STATE_TICKS_BITS;
+		if (now >= last)
+			first = now;
+		else if (last - now <= CLOCK_STATE_MAX_BACKWARD)
+			first = last;
+		else {
+			first = now;
+			changes = (changes + 1) & 0xFF;
+		}
+		new = ((uint64_t) changes << CLOCK_STATE_TICKS_BITS)
+			| ((first + n) & CLOCK_STATE_TICKS_MASK);
+	} while (!__atomic_compare_exchange_n(&cs->state, &old, new, 1,
+					      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	first += (((uint64_t) TIME_OFFSET_HIGH) << 32) + TIME_OFFSET_LOW;
+
+	*clock_high = first >> 32;
+	*clock_low = first;
+	/* never CLOCK_SEQ_CONT */
+	*ret_clock_seq = 1 + (cs->clock_seq + changes) % 0x3FFF;
+	return 0;
+}
+#endif /* USE_CLOCK_STATE_MMAP */
+
 /*
  * Get clock from global sequence clock counter.
  *
@@ -264,6 +426,10 @@ static int get_clock(uint32_t *clock_high, uint32_t *clock_low,
 	uint64_t			clock_reg;
 	int				ret = 0;
 
+#ifdef USE_CLOCK_STATE_MMAP
+	if (get_clock_shared(clock_high, clock_low, ret_clock_seq, num) == 0)
+		return 0;
+#endif
 	if (state_fd == STATE_FD_INIT)
 		state_fd = state_fd_init(LIBUUID_CLOCK_FILE, &state_f);
 
@@ -357,21 +523,6 @@ try_again:
 	return ret;
 }
 
-/*
- * Get current time in 100ns ticks.
- */
-static uint64_t get_clock_counter(void)
-{
-	struct timeval tv;
-	uint64_t clock_reg;
-
-	gettimeofday(&tv, NULL);
-	clock_reg = tv.tv_usec*10;
-	clock_reg += ((uint64_t) tv.tv_sec) * 10000000ULL;
-
-	return clock_reg;
-}
-
 /*
  * Get continuous clock value.
  *
@@ -722,15 +873,65 @@ void uuid_generate_time_v6(uuid_t out)
 	__uuid_set_variant_and_version(out, UUID_TYPE_DCE_TIME_V6);
 }
 
-// FIXME variable additional information
-void uuid_generate_time_v7(uuid_t out)
+/*
+ * UUIDv7 monotonic counter (RFC 9562, 6.2. Method 1)
+ *
+ * The 16-bit counter is stored in rand_a and in the leftmost 4 bits of
+ * rand_b. It is initialized by random number with the top bit cleared for
+ * each new millisecond and incremented for each UUID within the same
+ * millisecond. The counter overflow increments the timestamp.
+ *
+ * The last used timestamp and counter (ms << 16 | counter) is shared by all
+ * threads and updated by compare-and-swap, so UUIDs from all threads of the
+ * process are ordered. The random parts are served from a per-thread buffer
+ * so the fast path does not need any lock or syscall.
+ */
+#define UUID_V7_CTR_BITS	16
+#define UUID_V7_CTR_MASK	((1 << UUID_V7_CTR_BITS) - 1)
+#define UUID_V7_CTR_INIT_MASK	(UUID_V7_CTR_MASK >> 1)
+
+/* Larger clock step back (in ms) resets the sequence to the current time */
+#define UUID_V7_MAX_BACKWARD	10000
+
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_8
+static uint64_t uuid_v7_last;
+# define uuid_v7_last_load() \
+	__atomic_load_n(&uuid_v7_last, __ATOMIC_RELAXED)
+# define uuid_v7_last_cas(_old, _new) \
+	__atomic_compare_exchange_n(&uuid_v7_last, _old, _new, 1, \
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#else
+/* no 64-bit atomics, UUIDs are ordered per thread only */
+THREAD_LOCAL uint64_t uuid_v7_last;
+# define uuid_v7_last_load()		(uuid_v7_last)
+# define uuid_v7_last_cas(_old, _new)	(uuid_v7_last = (_new), 1)
+#endif
+
+/*
+ * Reserve @n consecutive timestamp+counter values, returns the first one.
+ * The @rnd is the random initial counter for a new millisecond.
+ */
+static uint64_t uuid_v7_reserve(uint64_t ms, uint16_t rnd, size_t n)
 {
-	struct timeval tv;
-	uint64_t ms;
+	uint64_t last, first;
 
-	gettimeofday(&tv, NULL);
+	last = uuid_v7_last_load();
+	do {
+		uint64_t last_ms = last >> UUID_V7_CTR_BITS;
+
+		if (last_ms < ms || last_ms - ms > UUID_V7_MAX_BACKWARD)
+			first = (ms << UUID_V7_CTR_BITS) | (rnd & UUID_V7_CTR_INIT_MASK);
+		else
+			first = last + 1;	/* same ms or small clock step back */
+	} while (!uuid_v7_last_cas(&last, first + n - 1));
+
+	return first;
+}
 
-	ms = tv.tv_sec * MSEC_PER_SEC + tv.tv_usec / USEC_PER_MSEC;
+static void uuid_set_time_v7(uuid_t out, uint64_t val)
+{
+	uint64_t ms = val >> UUID_V7_CTR_BITS;
+	unsigned int ctr = val & UUID_V7_CTR_MASK;
 
 	out[0] = ms >> 40;
 	out[1] = ms >> 32;
@@ -738,35 +939,134 @@ void uuid_generate_time_v7(uuid_t out)
 	out[3] = ms >> 16;
 	out[4] = ms >>  8;
 	out[5] = ms >>  0;
-	ul_random_get_bytes(out + 6, 10);
+	out[6] = ctr >> 12;
+	out[7] = ctr >>  4;
+	out[8] = ((ctr & 0xF) << 2) | (out[8] & 0x03);
 	__uuid_set_variant_and_version(out, UUID_TYPE_DCE_TIME_V7);
 }
 
+static uint64_t get_clock_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * MSEC_PER_SEC + tv.tv_usec / USEC_PER_MSEC;
+}
+
+#ifdef HAVE_LIBPTHREAD
+/* 64 UUIDs per getrandom() */
+THREAD_LOCAL struct {
+	size_t		pos;
+	unsigned char	buf[64 * 10];
+} uuid_v7_random = {
+	.pos = sizeof(uuid_v7_random.buf)
+};
+
+static void reset_uuid_v7_random(void)
+{
+	/* don't share the random data with the parent */
+	memset(&uuid_v7_random, 0, sizeof(uuid_v7_random));
+	uuid_v7_random.pos = sizeof(uuid_v7_random.buf);
+}
+
+static void register_uuid_v7_atfork(void)
+{
+	pthread_atfork(NULL, NULL, reset_uuid_v7_random);
+}
+
+static void get_uuid_v7_random(unsigned char *buf, size_t sz)
+{
+	if (sizeof(uuid_v7_random.buf) - uuid_v7_random.pos < sz) {
+		static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+		pthread_once(&atfork_once, register_uuid_v7_atfork);
+		ul_random_get_bytes(uuid_v7_random.buf, sizeof(uuid_v7_random.buf));
+		uuid_v7_random.pos = 0;
+	}
+	memcpy(buf, uuid_v7_random.buf + uuid_v7_random.pos, sz);
+	uuid_v7_random.pos += sz;
+}
+#else
+# define get_uuid_v7_random(_buf, _sz)	ul_random_get_bytes(_buf, _sz)
+#endif /* HAVE_LIBPTHREAD */
+
+void uuid_generate_time_v7(uuid_t out)
+{
+	uint64_t ms = get_clock_ms();
+
+	get_uuid_v7_random(out + 6, 10);
+	uuid_set_time_v7(out,
+		uuid_v7_reserve(ms, (out[6] << 8) | out[7], 1));
+}
+
+/*
+ * Fill @n UUIDs with random bytes by one request to the entropy source.
+ *
+ * Returns 0 for good quality of random bytes, -1 for weak quality.
+ */
+static int uuid_fill_random(uuid_t *out, size_t n)
+{
+	return ul_random_get_bytes(out, n * sizeof(uuid_t)) ? -1 : 0;
+}
+
+/*
+ * Generate @n time-based v7 UUIDs and store them to @out.
+ *
+ * The UUIDs are ordered (see uuid_v7_reserve()) and the random parts are read
+ * from the entropy source at once, that's a lot cheaper than @n calls of
+ * uuid_generate_time_v7().
+ *
+ * Returns 0 if high-quality randomness has been used, -1 otherwise.
+ */
+int uuid_generate_time_v7_bulk(uuid_t *out, size_t n)
+{
+	size_t i;
+	uint64_t val;
+	int rc;
+
+	if (!n)
+		return 0;
+	if (n > SIZE_MAX / sizeof(uuid_t))
+		return -1;
+
+	rc = uuid_fill_random(out, n);
+	val = uuid_v7_reserve(get_clock_ms(), (out[0][6] << 8) | out[0][7], n);
+	for (i = 0; i < n; i++)
+		uuid_set_time_v7(out[i], val + i);
+	return rc;
+}
+
+/*
+ * Generate @n random-based UUIDs and store them to @out.
+ *
+ * Returns 0 if high-quality randomness has been used, -1 otherwise.
+ */
+int uuid_generate_random_bulk(uuid_t *out, size_t n)
+{
+	size_t i;
+	int rc;
+
+	if (n > SIZE_MAX / sizeof(uuid_t))
+		return -1;
+
+	rc = uuid_fill_random(out, n);
+	for (i = 0; i < n; i++)
+		__uuid_set_variant_and_version(out[i], UUID_TYPE_DCE_RANDOM);
+	return rc;
+}
 
 int __uuid_generate_random(uuid_t out, int *num)
 {
-	uuid_t	buf;
-	struct uuid uu;
-	int i, n, r = 0;
+	int n;
 
 	if (!num || !*num)
 		n = 1;
 	else
 		n = *num;
+	if (n < 0)
+		return 0;
 
-	for (i = 0; i < n; i++) {
-		if (ul_random_get_bytes(buf, sizeof(buf)))
-			r = -1;
-		uuid_unpack(buf, &uu);
-
-		uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-		uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
-			| 0x4000;
-		uuid_pack(&uu, out);
-		out += sizeof(uuid_t);
-	}
-
-	return r;
+	return uuid_generate_random_bulk((uuid_t *) out, n);
 }
 
 void uuid_generate_random(uuid_t out)
@@ -843,11 +1143,162 @@ void uuid_generate_sha1(uuid_t out, const uuid_t ns, const char *name, size_t le
 }
 
 #ifdef TEST_PROGRAM
+# define TEST_V7_NTHREADS	4
+# define TEST_V7_NUUIDS		50000
+
+# ifdef USE_CLOCK_STATE_MMAP
+static uint64_t test_clock_shared(uint16_t *seq, int num)
+{
+	uint32_t high, low;
+
+	if (get_clock_shared(&high, &low, seq, &num) != 0)
+		errx(EXIT_FAILURE, "clock state is not usable");
+	return ((uint64_t) high << 32) | low;
+}
+
+static uint64_t test_clock_now(void)
+{
+	return get_clock_counter() + (((uint64_t) TIME_OFFSET_HIGH) << 32)
+				   + TIME_OFFSET_LOW;
+}
+
+/*
+ * Use a temporary clock state file and go through the get_clock_shared()
+ * branches. This has to be called before any other UUID is generated.
+ */
+static void test_clock_state(void)
+{
+	char path[] = "/tmp/test_uuid_time-XXXXXX";
+	struct timeval saved = test_clock;
+	uint64_t t0, t;
+	uint16_t seq0, seq;
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		err(EXIT_FAILURE, "cannot create clock state file");
+	close(fd);
+	clock_state_file = path;
+	if (!get_clock_state())
+		errx(EXIT_FAILURE, "cannot map clock state file");
+	unlink(path);		/* the mapping is still usable */
+
+	/* new state file */
+	t0 = test_clock_shared(&seq0, 1);
+	if (t0 != test_clock_now())
+		errx(EXIT_FAILURE, "clock state: unexpected first time");
+
+	/* the same tick, continue from the last used time */
+	t = test_clock_shared(&seq, 1);
+	if (t != t0 + 1 || seq != seq0)
+		errx(EXIT_FAILURE, "clock state: same tick not continued");
+	t = test_clock_shared(&seq, 3);
+	if (t != t0 + 2 || seq != seq0)
+		errx(EXIT_FAILURE, "clock state: range not reserved");
+	t = test_clock_shared(&seq, 1);
+	if (t != t0 + 5 || seq != seq0)
+		errx(EXIT_FAILURE, "clock state: range not skipped");
+
+	/* small step back, continue from the last used time */
+	test_clock.tv_sec -= 1;
+	t = test_clock_shared(&seq, 1);
+	if (t != t0 + 6 || seq != seq0)
+		errx(EXIT_FAILURE, "clock state: small step back not continued");
+
+	/* large step back, use the current time and change the sequence */
+	test_clock.tv_sec -= 20;
+	t = test_clock_shared(&seq, 1);
+	if (t != test_clock_now() || seq == seq0)
+		errx(EXIT_FAILURE, "clock state: large step back not detected");
+	seq0 = seq;
+
+	/* clock moves forward */
+	test_clock = saved;
+	t = test_clock_shared(&seq, 1);
+	if (t != test_clock_now() || seq != seq0)
+		errx(EXIT_FAILURE, "clock state: forward step not used");
+}
+# endif /* USE_CLOCK_STATE_MMAP */
+
+# ifdef HAVE_LIBPTHREAD
+/* timestamp and counter of v7 UUID, see uuid_set_time_v7() */
+static uint64_t test_v7_value(const uuid_t uu)
+{
+	uint64_t ms = 0;
+	unsigned int ctr;
+	size_t i;
+
+	for (i = 0; i < 6; i++)
+		ms = (ms << 8) | uu[i];
+	ctr = ((uu[6] & 0x0F) << 12) | (uu[7] << 4) | ((uu[8] >> 2) & 0x0F);
+
+	return (ms << UUID_V7_CTR_BITS) | ctr;
+}
+
+static int cmp_values(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void *test_v7_thread(void *data)
+{
+	uuid_t *uuids = data;
+	size_t i;
+
+	for (i = 0; i < TEST_V7_NUUIDS; i++) {
+		uuid_generate_time_v7(uuids[i]);
+		if (i && uuid_compare(uuids[i - 1], uuids[i]) >= 0)
+			errx(EXIT_FAILURE, "v7 UUIDs not ordered in thread");
+	}
+	return NULL;
+}
+
+/*
+ * UUIDs from each thread are ordered, and the timestamp+counter values are
+ * unique for all the threads (the random parts would hide duplicates).
+ */
+static void test_v7_threads(void)
+{
+	pthread_t threads[TEST_V7_NTHREADS];
+	uint64_t *values;
+	uuid_t *uuids;
+	size_t i, n = TEST_V7_NTHREADS * TEST_V7_NUUIDS;
+
+	uuids = calloc(n, sizeof(uuid_t));
+	values = calloc(n, sizeof(uint64_t));
+	if (!uuids || !values)
+		err(EXIT_FAILURE, "cannot allocate UUIDs");
+
+	for (i = 0; i < TEST_V7_NTHREADS; i++) {
+		if (pthread_create(&threads[i], NULL, test_v7_thread,
+				   uuids + i * TEST_V7_NUUIDS) != 0)
+			errx(EXIT_FAILURE, "cannot create thread");
+	}
+	for (i = 0; i < TEST_V7_NTHREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < n; i++)
+		values[i] = test_v7_value(uuids[i]);
+	qsort(values, n, sizeof(uint64_t), cmp_values);
+	for (i = 1; i < n; i++) {
+		if (values[i - 1] == values[i])
+			errx(EXIT_FAILURE, "duplicate v7 UUIDs from threads");
+	}
+	free(values);
+	free(uuids);
+}
+# endif /* HAVE_LIBPTHREAD */
+
 int main(void)
 {
 	char buf[UUID_STR_LEN];
 	uuid_t uuid;
 
+# ifdef USE_CLOCK_STATE_MMAP
+	test_clock_state();
+# endif
 	uuid_generate_time(uuid);
 	uuid_unparse(uuid, buf);
 	printf("%s\n", buf);
@@ -860,6 +1311,31 @@ int main(void)
 	uuid_unparse(uuid, buf);
 	printf("%s\n", buf);
 
+	/* v7 UUIDs have to be ordered although the clock does not move or
+	 * goes back a little */
+	{
+		uuid_t last, bulk[16];
+		size_t i;
+
+		uuid_copy(last, uuid);
+		for (i = 0; i < 100000; i++) {
+			if (i == 50000)
+				test_clock.tv_sec--;
+			uuid_generate_time_v7(uuid);
+			if (uuid_compare(last, uuid) >= 0)
+				errx(EXIT_FAILURE, "v7 UUIDs not ordered");
+			uuid_copy(last, uuid);
+		}
+		uuid_generate_time_v7_bulk(bulk, ARRAY_SIZE(bulk));
+		for (i = 0; i < ARRAY_SIZE(bulk); i++) {
+			if (uuid_compare(last, bulk[i]) >= 0)
+				errx(EXIT_FAILURE, "bulk v7 UUIDs not ordered");
+			uuid_copy(last, bulk[i]);
+		}
+	}
+# ifdef HAVE_LIBPTHREAD
+	test_v7_threads();
+# endif
 	return 0;
 }
 #endif
@@ -34,12 +34,64 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 
 #include "c.h"
 #include "uuidP.h"
 
+/*
+ * Hex digit value + 1 for every input byte, zero for anything that is not
+ * a hex digit. The table is independent of locale, unlike isxdigit().
+ */
+#define HEXVAL_DIGITS(c, v) [c] = (v) + 1
+static const unsigned char hexval[256] = {
+	HEXVAL_DIGITS('0', 0x0), HEXVAL_DIGITS('1', 0x1),
+	HEXVAL_DIGITS('2', 0x2), HEXVAL_DIGITS('3', 0x3),
+	HEXVAL_DIGITS('4', 0x4), HEXVAL_DIGITS('5', 0x5),
+	HEXVAL_DIGITS('6', 0x6), HEXVAL_DIGITS('7', 0x7),
+	HEXVAL_DIGITS('8', 0x8), HEXVAL_DIGITS('9', 0x9),
+	HEXVAL_DIGITS('a', 0xa), HEXVAL_DIGITS('A', 0xa),
+	HEXVAL_DIGITS('b', 0xb), HEXVAL_DIGITS('B', 0xb),
+	HEXVAL_DIGITS('c', 0xc), HEXVAL_DIGITS('C', 0xc),
+	HEXVAL_DIGITS('d', 0xd), HEXVAL_DIGITS('D', 0xd),
+	HEXVAL_DIGITS('e', 0xe), HEXVAL_DIGITS('E', 0xe),
+	HEXVAL_DIGITS('f', 0xf), HEXVAL_DIGITS('F', 0xf)
+};
+
+/* offsets of the 16 hex digit pairs in the string */
+static const unsigned char hexpos[16] = {
+	0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34
+};
+
+/*
+ * Converts 36 characters at @in to @uu. The string order of the hex digits
+ * is the same as the byte order of uuid_t, so no uuid_pack() is necessary.
+ * @uu is not modified if the string is invalid.
+ */
+static int parse_one(const char *in, uuid_t uu)
+{
+	const unsigned char *cp = (const unsigned char *) in;
+	unsigned char tmp[16], bad = 0;
+	size_t i;
+
+	if (cp[8] != '-' || cp[13] != '-' || cp[18] != '-' || cp[23] != '-')
+		return -1;
+
+	for (i = 0; i < 16; i++) {
+		unsigned char hi = hexval[cp[hexpos[i]]],
+			      lo = hexval[cp[hexpos[i] + 1]];
+
+		/* check all digits at once, the common case is valid input */
+		bad |= !hi | !lo;
+		tmp[i] = ((hi - 1u) << 4) | ((lo - 1u) & 0x0f);
+	}
+	if (bad)
+		return -1;
+
+	memcpy(uu, tmp, sizeof(tmp));
+	return 0;
+}
+
 int uuid_parse(const char *in, uuid_t uu)
 {
 	size_t len = strlen(in);
@@ -51,48 +103,24 @@ int uuid_parse(const char *in, uuid_t uu)
 
 int uuid_parse_range(const char *in_start, const char *in_end, uuid_t uu)
 {
-	struct uuid	uuid;
-	int		i;
-	const char	*cp;
-	char		buf[3];
-
 	if ((in_end - in_start) != 36)
 		return -1;
-	for (i=0, cp = in_start; i < 36; i++,cp++) {
-		if ((i == 8) || (i == 13) || (i == 18) ||
-		    (i == 23)) {
-			if (*cp == '-')
-				continue;
-			return -1;
-		}
 
-		if (!isxdigit(*cp))
-			return -1;
-	}
-	errno = 0;
-	uuid.time_low = strtoul(in_start, NULL, 16);
-
-	if (!errno)
-		uuid.time_mid = strtoul(in_start+9, NULL, 16);
-	if (!errno)
-		uuid.time_hi_and_version = strtoul(in_start+14, NULL, 16);
-	if (!errno)
-		uuid.clock_seq = strtoul(in_start+19, NULL, 16);
-	if (errno)
-		return -1;
+	return parse_one(in_start, uu);
+}
 
-	cp = in_start+24;
-	buf[2] = 0;
-	for (i=0; i < 6; i++) {
-		buf[0] = *cp++;
-		buf[1] = *cp++;
+/*
+ * Parses @n strings stored UUID_STR_LEN bytes apart (the byte after each
+ * UUID is not checked, so '\0', '\n' and the like are all fine). Returns the
+ * number of UUIDs parsed before the first invalid one.
+ */
+size_t uuid_parse_bulk(const char *in, size_t n, uuid_t *out)
+{
+	size_t i;
 
-		errno = 0;
-		uuid.node[i] = strtoul(buf, NULL, 16);
-		if (errno)
-			return -1;
+	for (i = 0; i < n; i++, in += UUID_STR_LEN) {
+		if (parse_one(in, out[i]))
+			break;
 	}
-
-	uuid_pack(&uuid, uu);
-	return 0;
+	return i;
 }
@@ -42,6 +42,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #include "c.h"
@@ -64,6 +65,47 @@ static int test_uuid(const char * uuid, int isValid)
 	return 0;
 }
 
+static int test_uuid_bulk(void)
+{
+	static const char *const strs[] = {
+		"84949cc5-4701-4a84-895b-354c584a981b",
+		"00000000-0000-0000-0000-000000000000",
+		"01234567-89ab-cdef-0134-567890abcedf",
+		"ffffffff-ffff-ffff-ffff-ffffffffffff",
+		"84949cc5-4701-4a84-895b-354c584a981g",
+		"84949cc5-4701-4a84-895b-354c584a981b"
+	};
+	char buf[ARRAY_SIZE(strs) * UUID_STR_LEN], str[UUID_STR_LEN];
+	uuid_t uus[ARRAY_SIZE(strs)];
+	size_t i, n;
+
+	for (i = 0; i < ARRAY_SIZE(strs); i++)
+		memcpy(buf + i * UUID_STR_LEN, strs[i], UUID_STR_LEN);
+
+	printf("bulk parse of %zu strings", ARRAY_SIZE(strs));
+	n = uuid_parse_bulk(buf, ARRAY_SIZE(strs), uus);
+	if (n != 4) {
+		printf(" stopped at %zu, expected 4\n", n);
+		return 1;
+	}
+	/* the separator after each string does not matter */
+	uuid_unparse_bulk(uus, n, buf, '\n');
+	for (i = 0; i < n; i++) {
+		uuid_unparse(uus[i], str);
+		if (memcmp(buf + i * UUID_STR_LEN, str, UUID_STR_LEN - 1) != 0
+		    || buf[i * UUID_STR_LEN + UUID_STR_LEN - 1] != '\n') {
+			printf(" unparsed %zu differs\n", i);
+			return 1;
+		}
+	}
+	if (uuid_parse_bulk(buf, n, uus) != n) {
+		printf(" failed to parse the unparsed\n");
+		return 1;
+	}
+	printf(", OK\n");
+	return 0;
+}
+
 static int check_uuids_in_file(const char *file)
 {
 	int ret = 0;
@@ -113,6 +155,7 @@ main(int argc, char **argv)
 		failed += test_uuid("00000000-0000-0000-0000-000000000000", 1);
 		failed += test_uuid("01234567-89ab-cdef-0134-567890abcedf", 1);
 		failed += test_uuid("ffffffff-ffff-ffff-ffff-ffffffffffff", 1);
+		failed += test_uuid_bulk();
 	} else {
 		int i;
 
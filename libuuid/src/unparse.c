@@ -40,20 +40,43 @@
 static char const hexdigits_lower[] = "0123456789abcdef";
 static char const hexdigits_upper[] = "0123456789ABCDEF";
 
-static void uuid_fmt(const uuid_t uuid, char *buf, char const *restrict fmt)
+#ifdef UUID_UNPARSE_DEFAULT_UPPER
+# define hexdigits_default	hexdigits_upper
+#else
+# define hexdigits_default	hexdigits_lower
+#endif
+
+/*
+ * Writes the 36 characters of the string form without a terminator. The
+ * layout is fixed, so the dashes do not need a test in the digit loop.
+ */
+static inline void uuid_fmt_digits(const uuid_t uuid, char *p,
+				   char const *restrict fmt)
 {
-	char *p = buf;
 	int i;
 
-	for (i = 0; i < 16; i++) {
-		if (i == 4 || i == 6 || i == 8 || i == 10) {
-			*p++ = '-';
-		}
-		size_t tmp = uuid[i];
-		*p++ = fmt[tmp >> 4];
-		*p++ = fmt[tmp & 15];
+	for (i = 0; i < 4; i++, p += 2) {
+		p[0] = fmt[uuid[i] >> 4];
+		p[1] = fmt[uuid[i] & 15];
 	}
-	*p = '\0';
+	*p++ = '-';
+	for (; i < 10; i += 2, p += 5) {
+		p[0] = fmt[uuid[i] >> 4];
+		p[1] = fmt[uuid[i] & 15];
+		p[2] = fmt[uuid[i + 1] >> 4];
+		p[3] = fmt[uuid[i + 1] & 15];
+		p[4] = '-';
+	}
+	for (; i < 16; i++, p += 2) {
+		p[0] = fmt[uuid[i] >> 4];
+		p[1] = fmt[uuid[i] & 15];
+	}
+}
+
+static void uuid_fmt(const uuid_t uuid, char *buf, char const *restrict fmt)
+{
+	uuid_fmt_digits(uuid, buf, fmt);
+	buf[UUID_STR_LEN - 1] = '\0';
 }
 
 void uuid_unparse_lower(const uuid_t uu, char *out)
@@ -68,9 +91,20 @@ void uuid_unparse_upper(const uuid_t uu, char *out)
 
 void uuid_unparse(const uuid_t uu, char *out)
 {
-#ifdef UUID_UNPARSE_DEFAULT_UPPER
-	uuid_fmt(uu, out, hexdigits_upper);
-#else
-	uuid_fmt(uu, out, hexdigits_lower);
-#endif
+	uuid_fmt(uu, out, hexdigits_default);
+}
+
+/*
+ * Converts @n UUIDs to strings stored UUID_STR_LEN bytes apart in @out, each
+ * followed by @sep. Use '\0' to get an array of strings, or '\n' to get
+ * a buffer ready for write(2).
+ */
+void uuid_unparse_bulk(const uuid_t *uu, size_t n, char *out, char sep)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++, out += UUID_STR_LEN) {
+		uuid_fmt_digits(uu[i], out, hexdigits_default);
+		out[UUID_STR_LEN - 1] = sep;
+	}
 }
@@ -97,6 +97,8 @@ extern void uuid_generate_time(uuid_t out);
 extern int uuid_generate_time_safe(uuid_t out);
 extern void uuid_generate_time_v6(uuid_t out);
 extern void uuid_generate_time_v7(uuid_t out);
+extern int uuid_generate_random_bulk(uuid_t *out, size_t n);
+extern int uuid_generate_time_v7_bulk(uuid_t *out, size_t n);
 
 extern void uuid_generate_md5(uuid_t out, const uuid_t ns, const char *name, size_t len);
 extern void uuid_generate_sha1(uuid_t out, const uuid_t ns, const char *name, size_t len);
@@ -107,11 +109,13 @@ extern int uuid_is_null(const uuid_t uu);
 /* parse.c */
 extern int uuid_parse(const char *in, uuid_t uu);
 extern int uuid_parse_range(const char *in_start, const char *in_end, uuid_t uu);
+extern size_t uuid_parse_bulk(const char *in, size_t n, uuid_t *out);
 
 /* unparse.c */
 extern void uuid_unparse(const uuid_t uu, char *out);
 extern void uuid_unparse_lower(const uuid_t uu, char *out);
 extern void uuid_unparse_upper(const uuid_t uu, char *out);
+extern void uuid_unparse_bulk(const uuid_t *uu, size_t n, char *out, char sep);
 
 /* uuid_time.c */
 #if defined(__USE_TIME_BITS64) && defined(__GLIBC__)
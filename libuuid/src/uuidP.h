@@ -39,8 +39,9 @@
 
 #include "uuid.h"
 
-#define LIBUUID_CLOCK_FILE	_PATH_LOCALSTATEDIR "/lib/libuuid/clock.txt"
-#define LIBUUID_CLOCK_CONT_FILE	_PATH_LOCALSTATEDIR "/lib/libuuid/clock-cont.txt"
+#define LIBUUID_CLOCK_FILE		_PATH_LOCALSTATEDIR "/lib/libuuid/clock.txt"
+#define LIBUUID_CLOCK_CONT_FILE		_PATH_LOCALSTATEDIR "/lib/libuuid/clock-cont.txt"
+#define LIBUUID_CLOCK_STATE_FILE	_PATH_LOCALSTATEDIR "/lib/libuuid/clock-state"
 
 /*
  * Offset between 15-Oct-1582 and 1-Jan-70
@@ -282,6 +282,10 @@ struct lslogins_control {
 	char **ulist;
 	size_t ulsiz;
 
+#ifdef __linux__
+	struct procfs_snapshot *procs;	/* for COL_NPROCS */
+#endif
+
 	unsigned int time_mode;
 
 	const char *journal_path;
@@ -657,22 +661,22 @@ static int get_sgroups(gid_t **list, size_t *len, struct passwd *pwd)
 }
 
 #ifdef __linux__
-static int get_nprocs(const uid_t uid)
+static int get_nprocs(struct lslogins_control *ctl, const uid_t uid)
 {
-	DIR *dir;
-	struct dirent *d;
+	size_t i;
 	int nprocs = 0;
 
-	dir = opendir(_PATH_PROC);
-	if (!dir)
-		return 0;
+	/* read /proc only once for all users */
+	if (!ctl->procs) {
+		ctl->procs = ul_new_procfs_snapshot(PROCFS_SNAP_UID, 0);
+		if (!ctl->procs)
+			return 0;
+	}
 
-	while ((d = xreaddir(dir))) {
-		if (procfs_dirent_match_uid(dir, d, uid))
+	for (i = 0; i < ctl->procs->nprocs; i++) {
+		if (ctl->procs->uids[i] == uid)
 			++nprocs;
 	}
-
-	closedir(dir);
 	return nprocs;
 }
 #endif
@@ -1018,7 +1022,7 @@ static struct lslogins_user *get_user_info(struct lslogins_control *ctl, const c
 		case COL_NPROCS:
 #ifdef __linux__
 			if (!user->nprocs)
-				xasprintf(&user->nprocs, "%d", get_nprocs(pwd->pw_uid));
+				xasprintf(&user->nprocs, "%d", get_nprocs(ctl, pwd->pw_uid));
 #endif
 			break;
 		default:
@@ -1125,6 +1129,9 @@ static void free_ctl(struct lslogins_control *ctl)
 		free(ctl->ulist[n++]);
 
 	free(ctl->ulist);
+#ifdef __linux__
+	ul_free_procfs_snapshot(ctl->procs);
+#endif
 	free(ctl);
 }
 
@@ -460,7 +460,7 @@ static bool cdev_tty_probe(struct cdev *cdev) {
 	if (!ttydrv)
 		return false;
 
-	data = xmalloc(sizeof(struct ttydata));
+	data = xcalloc(1, sizeof(struct ttydata));
 	data->cdev = cdev;
 	data->drv = ttydrv;
 	data->tty_index = NO_TTY_INDEX;
@@ -471,8 +471,12 @@ static bool cdev_tty_probe(struct cdev *cdev) {
 
 static void cdev_tty_free(const struct cdev *cdev)
 {
-	if (cdev->cdev_data)
-		free(cdev->cdev_data);
+	struct ttydata *data = cdev->cdev_data;
+
+	if (data) {
+		del_endpoint(&data->endpoint);
+		free(data);
+	}
 }
 
 static char * cdev_tty_get_name(struct cdev *cdev)
@@ -132,11 +132,18 @@ static void fifo_initialize_content(struct file *file)
 	add_endpoint(&fifo->endpoint, ipc);
 }
 
+static void fifo_free_content(struct file *file)
+{
+	struct fifo *fifo = (struct fifo *)file;
+
+	del_endpoint(&fifo->endpoint);
+}
+
 const struct file_class fifo_class = {
 	.super = &file_class,
 	.size = sizeof(struct fifo),
 	.fill_column = fifo_fill_column,
 	.initialize_content = fifo_initialize_content,
-	.free_content = NULL,
+	.free_content = fifo_free_content,
 	.get_ipc_class = fifo_get_ipc_class,
 };
@@ -171,6 +171,11 @@ static bool abst_fill_column(struct proc *proc,
 	case COL_KTHREAD:
 		xasprintf(&str, "%u", proc->kthread);
 		break;
+	case COL_EVENT:
+		if (file->event == FILE_EVENT_NONE)
+			return true;
+		str = xstrdup(file->event == FILE_EVENT_OPEN ? "open" : "close");
+		break;
 	case COL_MODE:
 		xasprintf(&str, "???");
 		break;
@@ -968,10 +973,18 @@ static void init_mqueue_file_content(struct file *file)
 	add_endpoint(&mqueue_file->endpoint, ipc);
 }
 
+static void free_mqueue_file_content(struct file *file)
+{
+	struct mqueue_file *mqueue_file = (struct mqueue_file *)file;
+
+	del_endpoint(&mqueue_file->endpoint);
+}
+
 const struct file_class mqueue_file_class = {
 	.super = &file_class,
 	.size = sizeof(struct mqueue_file),
 	.initialize_content = init_mqueue_file_content,
+	.free_content = free_mqueue_file_content,
 	.fill_column = mqueue_file_fill_column,
 	.get_ipc_class = mqueue_file_get_ipc_class,
 };
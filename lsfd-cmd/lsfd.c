@@ -32,15 +32,25 @@
 #include <search.h>
 #include <poll.h>
 #include <sys/select.h>
+#include <sys/ioctl.h>
 
 #include <sys/uio.h>
 #include <linux/sched.h>
 #include <sys/syscall.h>
+#include <time.h>
+
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #ifdef HAVE_LINUX_KCMP_H
 #  include <linux/kcmp.h>
 #endif
 
+#ifdef HAVE_LINUX_FS_H
+#  include <linux/fs.h>	/* PROCMAP_QUERY */
+#endif
+
 /* See proc(5).
  * Defined in linux/include/linux/sched.h private header file. */
 #define PF_KTHREAD		0x00200000	/* I am a kernel thread */
@@ -89,6 +99,38 @@ static int kcmp(pid_t pid1 __attribute__((__unused__)),
 }
 #endif
 
+/* Available since Linux 6.11. lsfd uses PROCMAP_QUERY only for
+ * optimization; the kernel returns ENOTTY if it doesn't know it. */
+#ifndef PROCMAP_QUERY
+enum procmap_query_flags {
+	PROCMAP_QUERY_VMA_READABLE		= 0x01,
+	PROCMAP_QUERY_VMA_WRITABLE		= 0x02,
+	PROCMAP_QUERY_VMA_EXECUTABLE		= 0x04,
+	PROCMAP_QUERY_VMA_SHARED		= 0x08,
+	PROCMAP_QUERY_COVERING_OR_NEXT_VMA	= 0x10,
+	PROCMAP_QUERY_FILE_BACKED_VMA		= 0x20,
+};
+
+struct procmap_query {
+	uint64_t size;
+	uint64_t query_flags;
+	uint64_t query_addr;
+	uint64_t vma_start;
+	uint64_t vma_end;
+	uint64_t vma_flags;
+	uint64_t vma_page_size;
+	uint64_t vma_offset;
+	uint64_t inode;
+	uint32_t dev_major;
+	uint32_t dev_minor;
+	uint32_t vma_name_size;
+	uint32_t build_id_size;
+	uint64_t vma_name_addr;
+	uint64_t build_id_addr;
+};
+#  define PROCMAP_QUERY	_IOWR('f', 17, struct procmap_query)
+#endif
+
 UL_DEBUG_DEFINE_MASK(lsfd);
 UL_DEBUG_DEFINE_MASKNAMES(lsfd) = UL_DEBUG_EMPTY_MASKNAMES;
 
@@ -226,6 +268,9 @@ static const struct colinfo infos[] = {
 	[COL_ENDPOINTS]        = { "ENDPOINTS",
 				   0,   SCOLS_FL_WRAP,  SCOLS_JSON_ARRAY_STRING,
 				   N_("IPC endpoints information communicated with the fd") },
+	[COL_EVENT]            = { "EVENT",
+				   0,   SCOLS_FL_RIGHT, SCOLS_JSON_STRING,
+				   N_("open or close event reported by --watch") },
 	[COL_EVENTFD_ID]       = {"EVENTFD.ID",
 				   0,   SCOLS_FL_RIGHT, SCOLS_JSON_NUMBER,
 				   N_("eventfd ID") },
@@ -590,10 +635,49 @@ struct lsfd_control {
 
 	struct libscols_filter *filter;		/* filter */
 	struct libscols_filter **ct_filters;	/* counters (NULL terminated array) */
+
+	const char **summary_by;		/* group-by columns for counters */
+	size_t nsummary_by;
+
+	struct libscols_column **sort_cols;	/* --sort columns */
+	int *sort_orders;			/* SCOLS_SORT_* for the columns */
+	size_t nsort_cols;
+
+	size_t workers;				/* number of collecting threads */
+
+	bool watch;				/* --watch */
+	struct timespec watch_interval;
 };
 
 static void *proc_tree;			/* for tsearch/tfind */
 
+/*
+ * The collector lock serializes access to the global tables (proc_tree,
+ * mnt_namespaces, nodev_table, ipc_table, sock xinfo trees, name
+ * managers, ...) while the worker threads read /proc. It's no-op if
+ * the processes are collected by the main thread only.
+ */
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t collector_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+static bool collector_threaded;
+
+void lock_collector(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	if (collector_threaded)
+		pthread_mutex_lock(&collector_mutex);
+#endif
+}
+
+void unlock_collector(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	if (collector_threaded)
+		pthread_mutex_unlock(&collector_mutex);
+#endif
+}
+
 static int proc_tree_compare(const void *a, const void *b)
 {
 	return ((struct proc *)a)->pid - ((struct proc *)b)->pid;
@@ -803,8 +887,11 @@ static struct file *copy_file(struct file *old, int new_association)
 
 static void file_init_content(struct file *file)
 {
-	if (file->class && file->class->initialize_content)
+	if (file->class && file->class->initialize_content) {
+		lock_collector();
 		file->class->initialize_content(file);
+		unlock_collector();
+	}
 }
 
 static void free_file(struct file *file)
@@ -859,6 +946,7 @@ static void read_fdinfo(struct file *file, FILE *fdinfo)
 		val = (char *) skip_space(val);
 		rtrim_whitespace((unsigned char *) val);
 
+		lock_collector();
 		class = file->class;
 		while (class) {
 			if (class->handle_fdinfo
@@ -866,6 +954,7 @@ static void read_fdinfo(struct file *file, FILE *fdinfo)
 				break;
 			class = class->super;
 		}
+		unlock_collector();
 	}
 }
 
@@ -912,25 +1001,23 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 		return f;
 
 	if (is_association(f, NS_MNT)) {
+		lock_collector();
 		proc->mnt_ns = find_mnt_ns(f->stat.st_ino);
 		if (proc->mnt_ns == NULL)
 			proc->mnt_ns = add_mnt_ns(f->stat.st_ino);
-	} else if (is_association(f, NS_NET))
-		load_sock_xinfo(pc, name, f->stat.st_ino);
-
-	else if (assoc >= 0) {
+		unlock_collector();
+	} else if (is_association(f, NS_NET)) {
+		proc->netns_inode = f->stat.st_ino;
+		add_sock_netns(pc, name, f->stat.st_ino);
+	} else if (assoc >= 0) {
 		/* file-descriptor based association */
-		bool is_socket = (sb.st_mode & S_IFMT) == S_IFSOCK;
 		FILE *fdinfo;
 
 		if (ul_path_stat(pc, &sb, AT_SYMLINK_NOFOLLOW, name) == 0)
 			f->mode = sb.st_mode;
 
 		if (is_nsfs_dev(f->stat.st_dev))
-			load_sock_xinfo(pc, name, f->stat.st_ino);
-
-		if (is_socket)
-			load_fdsk_xinfo(proc, assoc);
+			add_sock_netns(pc, name, f->stat.st_ino);
 
 		fdinfo = ul_path_fopenf(pc, "r", "fdinfo/%d", assoc);
 		if (fdinfo) {
@@ -962,47 +1049,44 @@ static void collect_fd_files(struct path_cxt *pc, struct proc *proc,
 	}
 }
 
-static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
-{
-	uint64_t start, end, offset, ino;
-	unsigned long major, minor;
-	enum association assoc = ASSOC_MEM;
-	struct stat sb = { .st_mode = 0 };
-	struct file *f, *prev;
-	char *path, modestr[5];
-	dev_t devno;
-
-	/* read rest of the map */
-	if (sscanf(buf, "%"SCNx64		/* start */
-			"-%"SCNx64		/* end */
-			" %4[^ ]"		/* mode */
-			" %"SCNx64		/* offset */
-			" %lx:%lx"		/* maj:min */
-			" %"SCNu64,		/* inode */
-
-			&start, &end, modestr, &offset,
-			&major, &minor, &ino) != 7)
-		return;
+/* Mappings of the same file are usually listed one after another but not
+ * always (e.g. shared libraries mapped with gaps, or heaps of JVMs placed
+ * between them). Remember recently added files by their dev/inode so
+ * that a mapping of a known file is made by copying instead of calling
+ * stat() again.
+ */
+#define MAPS_FILE_CACHE_SIZE 64
 
-	/* Skip private anonymous mappings. */
-	if (major == 0 && minor == 0 && ino == 0)
-		return;
+struct maps_file_cache {
+	struct file *files[MAPS_FILE_CACHE_SIZE];
+};
 
-	devno = makedev(major, minor);
+static inline size_t maps_file_cache_slot(dev_t devno, uint64_t ino)
+{
+	return (size_t)((ino ^ devno) % MAPS_FILE_CACHE_SIZE);
+}
 
-	if (modestr[3] == 's')
-		assoc = ASSOC_SHM;
+static void add_mem_file(struct path_cxt *pc, struct proc *proc,
+			 struct maps_file_cache *cache,
+			 uint64_t start, uint64_t end, uint64_t offset,
+			 dev_t devno, uint64_t ino,
+			 bool readable, bool writable, bool executable, bool shared,
+			 char *path)
+{
+	enum association assoc = shared? ASSOC_SHM: ASSOC_MEM;
+	struct stat sb = { .st_mode = 0 };
+	struct file *f, *prev;
+	size_t slot = maps_file_cache_slot(devno, ino);
 
-	/* The map usually contains the same file more than once, try to reuse
-	 * the previous file (if devno and ino are the same) to save stat() call.
-	 */
-	prev = list_last_entry(&proc->files, struct file, files);
+	/* Reuse a file for the same devno and ino to save stat() call. */
+	prev = cache->files[slot];
+	if (!prev || prev->stat.st_dev != devno || prev->stat.st_ino != ino)
+		prev = list_last_entry(&proc->files, struct file, files);
 
 	if (prev && (!prev->is_error)
 	    && prev->stat.st_dev == devno && prev->stat.st_ino == ino)
 		f = copy_file(prev, -assoc);
-	else if ((path = strchr(buf, '/'))) {
-		rtrim_whitespace((unsigned char *) path);
+	else if (path && *path == '/') {
 		if (stat(path, &sb) < 0)
 			/* If a file is mapped but deleted from the file system,
 			 * "stat by the file name" may not work. In that case,
@@ -1024,11 +1108,14 @@ static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
 			f = new_file(proc, stat2class(&sb), &sb, sym, -assoc);
 	}
 
-	if (modestr[0] == 'r')
+	if (!f->is_error)
+		cache->files[slot] = f;
+
+	if (readable)
 		f->mode |= S_IRUSR;
-	if (modestr[1] == 'w')
+	if (writable)
 		f->mode |= S_IWUSR;
-	if (modestr[2] == 'x')
+	if (executable)
 		f->mode |= S_IXUSR;
 
 	f->map_start = start;
@@ -1038,19 +1125,178 @@ static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
 	file_init_content(f);
 }
 
+static inline char *parse_maps_hex(char *p, uint64_t *num)
+{
+	uint64_t n = 0;
+	char *s = p;
+
+	for (;; p++) {
+		unsigned int d;
+
+		if (*p >= '0' && *p <= '9')
+			d = *p - '0';
+		else if (*p >= 'a' && *p <= 'f')
+			d = *p - 'a' + 10;
+		else
+			break;
+		n = (n << 4) | d;
+	}
+	*num = n;
+	return p == s? NULL: p;
+}
+
+static inline char *parse_maps_dec(char *p, uint64_t *num)
+{
+	uint64_t n = 0;
+	char *s = p;
+
+	for (; *p >= '0' && *p <= '9'; p++)
+		n = n * 10 + (*p - '0');
+	*num = n;
+	return p == s? NULL: p;
+}
+
+/* Parse a line of /proc/#/maps terminated by '\0':
+ *
+ *   start-end mode offset major:minor inode [path]
+ *
+ * Mappings ending at or below @from are skipped.
+ */
+static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc,
+			    struct maps_file_cache *cache, uint64_t from)
+{
+	uint64_t start, end, offset, major, minor, ino;
+	char *p = buf, *mode, *path;
+
+	if (!(p = parse_maps_hex(p, &start)) || *p++ != '-'
+	    || !(p = parse_maps_hex(p, &end)) || *p++ != ' ')
+		return;
+	if (end <= from)
+		return;
+
+	mode = p;
+	for (size_t i = 0; i < 4; i++)
+		if (*p++ == '\0')
+			return;
+	if (*p++ != ' ')
+		return;
+
+	if (!(p = parse_maps_hex(p, &offset)) || *p++ != ' '
+	    || !(p = parse_maps_hex(p, &major)) || *p++ != ':'
+	    || !(p = parse_maps_hex(p, &minor)) || *p++ != ' '
+	    || !(p = parse_maps_dec(p, &ino)))
+		return;
+
+	/* Skip private anonymous mappings. */
+	if (major == 0 && minor == 0 && ino == 0)
+		return;
+
+	path = strchr(p, '/');
+	if (path)
+		rtrim_whitespace((unsigned char *) path);
+
+	add_mem_file(pc, proc, cache, start, end, offset,
+		     makedev(major, minor), ino,
+		     mode[0] == 'r', mode[1] == 'w', mode[2] == 'x', mode[3] == 's',
+		     path);
+}
+
+static void read_maps(struct path_cxt *pc, int fd, struct proc *proc,
+		      struct maps_file_cache *cache, uint64_t from)
+{
+	/* A line is at most PATH_MAX plus the fixed fields. */
+	size_t bufsz = 64 * 1024, len = 0;
+	char *buf = xmalloc(bufsz + 1);
+	ssize_t n;
+
+	while ((n = read(fd, buf + len, bufsz - len)) != 0) {
+		char *line = buf, *nl;
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		len += n;
+		buf[len] = '\0';
+
+		while ((nl = memchr(line, '\n', len - (line - buf)))) {
+			*nl = '\0';
+			parse_maps_line(pc, line, proc, cache, from);
+			line = nl + 1;
+		}
+
+		len -= line - buf;
+		if (len == bufsz)
+			/* too long line; drop it */
+			len = 0;
+		else if (len)
+			memmove(buf, line, len);
+	}
+	if (len) {
+		buf[len] = '\0';
+		parse_maps_line(pc, buf, proc, cache, from);
+	}
+
+	free(buf);
+}
+
+/* Walk the file-backed mappings with PROCMAP_QUERY ioctl.
+ * Anonymous mappings are skipped by the kernel, and no text needs to be
+ * formatted and parsed. Return false if the ioctl is not available or
+ * fails in the middle of the walk; @addr is set to the address where
+ * the walk has to be continued by read_maps().
+ */
+static bool query_maps(struct path_cxt *pc, int fd, struct proc *proc,
+		       struct maps_file_cache *cache, uint64_t *addr)
+{
+	char name[PATH_MAX];
+	struct procmap_query q;
+
+	for (;;) {
+		memset(&q, 0, sizeof(q));
+		q.size = sizeof(q);
+		q.query_flags = PROCMAP_QUERY_COVERING_OR_NEXT_VMA
+			| PROCMAP_QUERY_FILE_BACKED_VMA;
+		q.query_addr = *addr;
+		q.vma_name_addr = (uintptr_t) name;
+		q.vma_name_size = sizeof(name);
+
+		if (ioctl(fd, PROCMAP_QUERY, &q) < 0) {
+			if (errno == EINTR)
+				continue;
+			/* ENOENT: no more mappings */
+			return errno == ENOENT;
+		}
+
+		*addr = q.vma_end;
+		if (q.dev_major == 0 && q.dev_minor == 0 && q.inode == 0)
+			continue;
+
+		add_mem_file(pc, proc, cache, q.vma_start, q.vma_end, q.vma_offset,
+			     makedev(q.dev_major, q.dev_minor), q.inode,
+			     q.vma_flags & PROCMAP_QUERY_VMA_READABLE,
+			     q.vma_flags & PROCMAP_QUERY_VMA_WRITABLE,
+			     q.vma_flags & PROCMAP_QUERY_VMA_EXECUTABLE,
+			     q.vma_flags & PROCMAP_QUERY_VMA_SHARED,
+			     q.vma_name_size ? name : NULL);
+	}
+}
+
 static void collect_mem_files(struct path_cxt *pc, struct proc *proc)
 {
-	FILE *fp;
-	char buf[BUFSIZ];
+	struct maps_file_cache cache = { .files = { NULL } };
+	uint64_t addr = 0;
+	int fd;
 
-	fp = ul_path_fopen(pc, "r", "maps");
-	if (!fp)
+	fd = ul_path_open(pc, O_RDONLY|O_CLOEXEC, "maps");
+	if (fd < 0)
 		return;
 
-	while (fgets(buf, sizeof(buf), fp))
-		parse_maps_line(pc, buf, proc);
+	if (!query_maps(pc, fd, proc, &cache, &addr))
+		read_maps(pc, fd, proc, &cache, addr);
 
-	fclose(fp);
+	close(fd);
 }
 
 static void collect_outofbox_files(struct path_cxt *pc,
@@ -1406,6 +1652,36 @@ static void read_mountinfo_in_mntns(FILE *mountinfo, struct mnt_namespace *mnt_n
 		setns(self_mntns_fd, CLONE_NEWNS);
 }
 
+/* Read /proc/$pid/mountinfo addressed by @pc. The caller must hold the
+ * collector lock.
+ */
+static void read_proc_mountinfo(struct path_cxt *pc, struct mnt_namespace *mnt_ns)
+{
+	struct mnt_namespace *target = mnt_ns;
+	FILE *mountinfo;
+	int mntns_fd = -1;
+
+	mountinfo = ul_path_fopen(pc, "r", "mountinfo");
+	if (!mountinfo)
+		return;
+
+	if (mnt_ns && (self_mntns_id != mnt_ns->id)) {
+		if (collector_threaded)
+			/* setns(CLONE_NEWNS) is not allowed in a multi-threaded
+			 * process, the mount points cannot be resolved. See
+			 * prepare_mnt_namespaces(). */
+			target = NULL;
+		else
+			mntns_fd = ul_path_open(pc, O_RDONLY, "ns/mnt");
+	}
+	read_mountinfo_in_mntns(mountinfo, target, mntns_fd);
+	if (mntns_fd >= 0)
+		close(mntns_fd);
+	if (mnt_ns)
+		mnt_ns->read_mountinfo = true;
+	fclose(mountinfo);
+}
+
 static void initialize_ipc_table(void)
 {
 	for (int i = 0; i < IPC_TABLE_SIZE; i++)
@@ -1475,6 +1751,16 @@ void add_endpoint(struct ipc_endpoint *endpoint, struct ipc *ipc)
 	list_add(&endpoint->endpoints, &ipc->endpoints);
 }
 
+/* Unlink the endpoint of a file being freed; the IPC tables outlive the
+ * files in --watch mode. */
+void del_endpoint(struct ipc_endpoint *endpoint)
+{
+	if (!endpoint->ipc)
+		return;
+	list_del(&endpoint->endpoints);
+	endpoint->ipc = NULL;
+}
+
 
 static void fill_column(struct proc *proc,
 			struct file *file,
@@ -1522,6 +1808,41 @@ static void convert_file(struct proc *proc,
 	}
 }
 
+static void convert_proc_file(struct proc *proc, struct file *file,
+			      struct lsfd_control *ctl)
+{
+	struct libscols_line *ln = scols_table_new_line(ctl->tb, NULL);
+	struct libscols_filter **ct_fltr = NULL;
+
+	if (!ln)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+	if (ctl->filter) {
+		int status = 0;
+		struct filler_data fid = {
+			.proc = proc,
+			.file = file,
+			.uri = ctl->uri,
+		};
+
+		scols_filter_set_filler_cb(ctl->filter,
+				filter_filler_cb, (void *) &fid);
+		if (scols_line_apply_filter(ln, ctl->filter, &status))
+			err(EXIT_FAILURE, _("failed to apply filter"));
+		if (status == 0) {
+			scols_table_remove_line(ctl->tb, ln);
+			return;
+		}
+	}
+
+	convert_file(proc, file, ln, ctl->uri);
+
+	if (!ctl->ct_filters)
+		return;
+
+	for (ct_fltr = ctl->ct_filters; *ct_fltr; ct_fltr++)
+		scols_line_apply_filter(ln, *ct_fltr, NULL);
+}
+
 static void convert(struct list_head *procs, struct lsfd_control *ctl)
 {
 	struct list_head *p;
@@ -1532,36 +1853,8 @@ static void convert(struct list_head *procs, struct lsfd_control *ctl)
 
 		list_for_each (f, &proc->files) {
 			struct file *file = list_entry(f, struct file, files);
-			struct libscols_line *ln = scols_table_new_line(ctl->tb, NULL);
-			struct libscols_filter **ct_fltr = NULL;
-
-			if (!ln)
-				err(EXIT_FAILURE, _("failed to allocate output line"));
-			if (ctl->filter) {
-				int status = 0;
-				struct filler_data fid = {
-					.proc = proc,
-					.file = file,
-					.uri = ctl->uri,
-				};
-
-				scols_filter_set_filler_cb(ctl->filter,
-						filter_filler_cb, (void *) &fid);
-				if (scols_line_apply_filter(ln, ctl->filter, &status))
-					err(EXIT_FAILURE, _("failed to apply filter"));
-				if (status == 0) {
-					scols_table_remove_line(ctl->tb, ln);
-					continue;
-				}
-			}
-
-			convert_file(proc, file, ln, ctl->uri);
 
-			if (!ctl->ct_filters)
-				continue;
-
-			for (ct_fltr = ctl->ct_filters; *ct_fltr; ct_fltr++)
-				scols_line_apply_filter(ln, *ct_fltr, NULL);
+			convert_proc_file(proc, file, ctl);
 		}
 	}
 }
@@ -1585,6 +1878,9 @@ static void delete(struct list_head *procs, struct lsfd_control *ctl)
 			scols_unref_filter(*ct_fltr);
 		free(ctl->ct_filters);
 	}
+	free(ctl->summary_by);
+	free(ctl->sort_cols);
+	free(ctl->sort_orders);
 }
 
 static void emit(struct lsfd_control *ctl)
@@ -1785,9 +2081,9 @@ unsigned long add_name(struct name_manager *nm, const char *name)
 }
 
 static void walk_threads(struct lsfd_control *ctl, struct path_cxt *pc,
-			 pid_t pid, struct proc *proc,
+			 struct list_head *procs, pid_t pid, struct proc *proc,
 			 void (*cb)(struct lsfd_control *, struct path_cxt *,
-				    pid_t, struct proc *))
+				    struct list_head *, pid_t, struct proc *))
 {
 	DIR *sub = NULL;
 	pid_t tid = 0;
@@ -1795,7 +2091,7 @@ static void walk_threads(struct lsfd_control *ctl, struct path_cxt *pc,
 	while (procfs_process_next_tid(pc, &sub, &tid) == 0) {
 		if (tid == pid)
 			continue;
-		(*cb)(ctl, pc, tid, proc);
+		(*cb)(ctl, pc, procs, tid, proc);
 	}
 }
 
@@ -1896,7 +2192,9 @@ static void mark_select_fds_as_multiplexed(char *buf,
 }
 
 static void parse_proc_syscall(struct lsfd_control *ctl __attribute__((__unused__)),
-			       struct path_cxt *pc, pid_t pid, struct proc *proc)
+			       struct path_cxt *pc,
+			       struct list_head *procs __attribute__((__unused__)),
+			       pid_t pid, struct proc *proc)
 {
 	char buf[BUFSIZ];
 	char *ptr = NULL;
@@ -1947,8 +2245,10 @@ static void parse_proc_syscall(struct lsfd_control *ctl __attribute__((__unused_
 	}
 }
 
+/* Read /proc/$pid and its tasks; the new processes are added to @procs.
+ */
 static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
-			 pid_t pid, struct proc *leader)
+			 struct list_head *procs, pid_t pid, struct proc *leader)
 {
 	char buf[BUFSIZ];
 	struct proc *proc;
@@ -2014,20 +2314,10 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 	/* 2/3. read /proc/$pid/mountinfo unless we have read it already.
 	 * The backing device for "nsfs" is solved here.
 	 */
-	if (proc->mnt_ns == NULL || !proc->mnt_ns->read_mountinfo) {
-		FILE *mountinfo = ul_path_fopen(pc, "r", "mountinfo");
-		if (mountinfo) {
-			int mntns_fd = -1;
-			if (proc->mnt_ns && (self_mntns_id != proc->mnt_ns->id))
-				mntns_fd = ul_path_open(pc, O_RDONLY, "ns/mnt");
-			read_mountinfo_in_mntns(mountinfo, proc->mnt_ns, mntns_fd);
-			if (mntns_fd >= 0)
-				close(mntns_fd);
-			if (proc->mnt_ns)
-				proc->mnt_ns->read_mountinfo = true;
-			fclose(mountinfo);
-		}
-	}
+	lock_collector();
+	if (proc->mnt_ns == NULL || !proc->mnt_ns->read_mountinfo)
+		read_proc_mountinfo(pc, proc->mnt_ns);
+	unlock_collector();
 
 	/* 3/3. read /proc/$pid/ns/{the other namespaces including net}
 	 * When reading the information about the net namespace,
@@ -2049,20 +2339,22 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 	    || kcmp(proc->leader->pid, proc->pid, KCMP_FILES, 0, 0) != 0)
 		collect_fd_files(pc, proc, ctl->sockets_only);
 
-	list_add_tail(&proc->procs, &ctl->procs);
+	list_add_tail(&proc->procs, procs);
+	lock_collector();
 	if (tsearch(proc, &proc_tree, proc_tree_compare) == NULL)
 		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	unlock_collector();
 
 	if (ctl->show_xmode)
-		parse_proc_syscall(ctl, pc, pid, proc);
+		parse_proc_syscall(ctl, pc, procs, pid, proc);
 
 	/* The tasks collecting overwrites @pc by /proc/<task-pid>/. Keep it as
 	 * the last path based operation in read_process()
 	 */
 	if (ctl->threads && leader == NULL)
-		walk_threads(ctl, pc, pid, proc, read_process);
+		walk_threads(ctl, pc, procs, pid, proc, read_process);
 	else if (ctl->show_xmode)
-		walk_threads(ctl, pc, pid, proc, parse_proc_syscall);
+		walk_threads(ctl, pc, procs, pid, proc, parse_proc_syscall);
 
  out:
 	/* Let's be careful with number of open files */
@@ -2120,16 +2412,143 @@ static bool member_pids(const pid_t pid, const pid_t pids[], const int count)
 	return bsearch(&pid, pids, count, sizeof(pid_t), pidcmp)? true: false;
 }
 
-static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
+/*
+ * A process to be collected. The process (and its threads) is collected to
+ * the private list of the slot, and the lists are concatenated in the order
+ * of /proc entries when all the workers have finished. The output does not
+ * depend on the number of workers.
+ */
+struct proc_slot {
+	pid_t pid;
+	bool keep;			/* --watch: the processes are not re-read */
+	struct list_head procs;
+	struct list_head old_procs;	/* --watch: replaced by @procs */
+};
+
+#define LSFD_MAX_WORKERS	16
+
+struct collector {
+	struct lsfd_control *ctl;
+	struct proc_slot *slots;
+	size_t nslots;
+	size_t next;		/* the first slot not taken by a worker yet */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t mutex;	/* protects @next */
+#endif
+};
+
+static struct proc_slot *collector_next_slot(struct collector *co)
 {
-	DIR *dir;
-	struct dirent *d;
-	struct path_cxt *pc = NULL;
+	struct proc_slot *slot = NULL;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&co->mutex);
+#endif
+	if (co->next < co->nslots)
+		slot = &co->slots[co->next++];
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&co->mutex);
+#endif
+	return slot;
+}
+
+static void *collector_worker(void *data)
+{
+	struct collector *co = data;
+	struct proc_slot *slot;
+	struct path_cxt *pc;
 
 	pc = ul_new_path(NULL);
 	if (!pc)
 		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
 
+	while ((slot = collector_next_slot(co))) {
+		if (!slot->keep)
+			read_process(co->ctl, pc, &slot->procs, slot->pid, NULL);
+	}
+
+	ul_unref_path(pc);
+	return NULL;
+}
+
+#ifdef HAVE_LIBPTHREAD
+/* setns(CLONE_NEWNS) used to read mountinfo of the other mount namespaces
+ * is not allowed in a multi-threaded process. Read the mountinfo files of
+ * all the namespaces before starting the workers.
+ */
+static void prepare_mnt_namespaces(struct collector *co)
+{
+	struct path_cxt *pc;
+
+	pc = ul_new_path(NULL);
+	if (!pc)
+		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
+
+	for (size_t i = 0; i < co->nslots; i++) {
+		struct mnt_namespace *mnt_ns;
+		struct stat sb;
+
+		if (co->slots[i].keep
+		    || procfs_process_init_path(pc, co->slots[i].pid) != 0)
+			continue;
+		if (ul_path_stat(pc, &sb, 0, "ns/mnt") == 0) {
+			mnt_ns = find_mnt_ns(sb.st_ino);
+			if (mnt_ns == NULL)
+				mnt_ns = add_mnt_ns(sb.st_ino);
+			if (!mnt_ns->read_mountinfo)
+				read_proc_mountinfo(pc, mnt_ns);
+		}
+		ul_path_close_dirfd(pc);
+	}
+
+	ul_unref_path(pc);
+}
+
+static void run_collector_workers(struct collector *co, size_t nworkers)
+{
+	pthread_t *workers = xcalloc(nworkers - 1, sizeof(*workers));
+	size_t i, n = 0;
+
+	prepare_mnt_namespaces(co);
+
+	collector_threaded = true;
+	for (i = 0; i < nworkers - 1; i++) {
+		if (pthread_create(&workers[n], NULL, collector_worker, co) != 0)
+			break;
+		n++;
+	}
+
+	/* The main thread is a worker too. */
+	collector_worker(co);
+
+	for (i = 0; i < n; i++)
+		pthread_join(workers[i], NULL);
+	collector_threaded = false;
+
+	free(workers);
+}
+#endif /* HAVE_LIBPTHREAD */
+
+static size_t get_default_workers(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n > 1)
+		return min((size_t) n, (size_t) LSFD_MAX_WORKERS);
+#endif
+	return 1;
+}
+
+/* Read the PIDs from /proc. The process @self is ignored. */
+static size_t read_proc_slots(struct proc_slot **slots,
+			      const pid_t pids[], int n_pids, pid_t self)
+{
+	struct proc_slot *res = NULL;
+	size_t n = 0;
+	DIR *dir;
+	struct dirent *d;
+
 	dir = opendir(_PATH_PROC);
 	if (!dir)
 		err(EXIT_FAILURE, _("failed to open /proc"));
@@ -2137,14 +2556,66 @@ static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int
 	while ((d = readdir(dir))) {
 		pid_t pid;
 
-		if (procfs_dirent_get_pid(d, &pid) != 0)
+		if (procfs_dirent_get_pid(d, &pid) != 0 || pid == self)
+			continue;
+		if (n_pids != 0 && !member_pids(pid, pids, n_pids))
 			continue;
-		if (n_pids == 0 || member_pids(pid, pids, n_pids))
-			read_process(ctl, pc, pid, 0);
+		res = xreallocarray(res, n + 1, sizeof(*res));
+		res[n++].pid = pid;
 	}
-
 	closedir(dir);
-	ul_unref_path(pc);
+
+	for (size_t i = 0; i < n; i++) {
+		res[i].keep = false;
+		INIT_LIST_HEAD(&res[i].procs);
+		INIT_LIST_HEAD(&res[i].old_procs);
+	}
+
+	*slots = res;
+	return n;
+}
+
+/* Read the processes of the slots not marked by @keep. */
+static void collect_slots(struct lsfd_control *ctl, struct proc_slot *slots, size_t nslots)
+{
+	struct collector co = {
+		.ctl = ctl,
+		.slots = slots,
+		.nslots = nslots
+	};
+	size_t nworkers = 0;
+
+	for (size_t i = 0; i < nslots && nworkers < ctl->workers; i++) {
+		if (!slots[i].keep)
+			nworkers++;
+	}
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&co.mutex, NULL);
+	if (nworkers > 1)
+		run_collector_workers(&co, nworkers);
+	else
+#endif
+		collector_worker(&co);
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_destroy(&co.mutex);
+#endif
+}
+
+static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
+{
+	struct proc_slot *slots;
+	size_t nslots;
+
+	/* lsfd itself opens and closes files all the time in --watch mode */
+	nslots = read_proc_slots(&slots, pids, n_pids, ctl->watch ? getpid() : 0);
+	collect_slots(ctl, slots, nslots);
+
+	for (size_t i = 0; i < nslots; i++)
+		list_splice(&slots[i].procs, ctl->procs.prev);
+
+	free(slots);
 }
 
 static void __attribute__((__noreturn__)) list_colunms(const char *table_name,
@@ -2193,11 +2664,16 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --pid <list>             collect information only for specified processes\n"), out);
 	fputs(_(" -i[4|6], --inet[=4|=6]       list only IPv4 and/or IPv6 sockets\n"), out);
 	fputs(_(" -Q, --filter <expr>          apply display filter\n"), out);
+	fputs(_(" -x, --sort <column>[:desc][,...]\n"
+		"                              sort output by the columns\n"), out);
 	fputs(_("     --debug-filter           dump the internal data structure of filter and exit\n"), out);
 	fputs(_(" -C, --counter <name>:<expr>  define custom counter for --summary output\n"), out);
 	fputs(_("     --dump-counters          dump counter definitions\n"), out);
 	fputs(_("     --hyperlink[=<when>]     print paths as hyperlinks (always|never|auto)\n"), out);
 	fputs(_("     --summary[=<mode>]       print summary information (append|only|never)\n"), out);
+	fputs(_("     --summary=by:<column>    print summary for each unique value of <column>\n"), out);
+	fputs(_("     --workers <num>          number of threads reading /proc (default: CPUs)\n"), out);
+	fputs(_("     --watch[=<seconds>]      report opened and closed files periodically\n"), out);
 	fputs(_("     --_drop-privilege        (testing purpose) do setuid(1) just after starting\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -2236,20 +2712,12 @@ static void append_filter_expr(char **a, const char *b, bool and)
 	free(tmp);
 }
 
-static struct libscols_filter *new_filter(const char *expr, bool debug, struct lsfd_control *ctl)
+static int assign_filter_columns(struct libscols_filter *f, struct lsfd_control *ctl)
 {
-	struct libscols_filter *f;
 	struct libscols_iter *itr;
 	int nerrs = 0;
 	const char *name = NULL;
 
-	f = scols_new_filter(NULL);
-	if (!f)
-		err(EXIT_FAILURE, _("failed to allocate filter"));
-	if (expr && scols_filter_parse_string(f, expr) != 0)
-		errx(EXIT_FAILURE, _("failed to parse \"%s\": %s"), expr,
-				scols_filter_get_errmsg(f));
-
 	itr = scols_new_iter(SCOLS_ITER_FORWARD);
 	if (!itr)
 		err(EXIT_FAILURE, _("failed to allocate iterator"));
@@ -2270,6 +2738,22 @@ static struct libscols_filter *new_filter(const char *expr, bool debug, struct l
 	}
 
 	scols_free_iter(itr);
+	return nerrs;
+}
+
+static struct libscols_filter *new_filter(const char *expr, bool debug, struct lsfd_control *ctl)
+{
+	struct libscols_filter *f;
+	int nerrs;
+
+	f = scols_new_filter(NULL);
+	if (!f)
+		err(EXIT_FAILURE, _("failed to allocate filter"));
+	if (expr && scols_filter_parse_string(f, expr) != 0)
+		errx(EXIT_FAILURE, _("failed to parse \"%s\": %s"), expr,
+				scols_filter_get_errmsg(f));
+
+	nerrs = assign_filter_columns(f, ctl);
 
 	if (debug)
 		scols_dump_filter(f, stdout);
@@ -2330,6 +2814,7 @@ static struct libscols_filter *new_counter(const struct counter_spec *spec, stru
 {
 	struct libscols_filter *f;
 	struct libscols_counter *ct;
+	size_t i;
 
 	f = new_filter(spec->expr, false, ctl);
 
@@ -2340,6 +2825,16 @@ static struct libscols_filter *new_counter(const struct counter_spec *spec, stru
 	scols_counter_set_name(ct, spec->name);
 	scols_counter_set_func(ct, SCOLS_COUNTER_COUNT);
 
+	if (!ctl->nsummary_by)
+		return f;
+
+	for (i = 0; i < ctl->nsummary_by; i++) {
+		if (scols_counter_add_groupby(ct, ctl->summary_by[i]))
+			err(EXIT_FAILURE, _("failed to add counter group-by column"));
+	}
+	if (assign_filter_columns(f, ctl))
+		exit(EXIT_FAILURE);
+
 	return f;
 }
 
@@ -2399,11 +2894,71 @@ static void dump_counter_specs(struct list_head *specs)
 	}
 }
 
+static void parse_sort_argument(struct lsfd_control *ctl, char *arg)
+{
+	char *str, *tok, *save = NULL;
+
+	for (str = arg; (tok = strtok_r(str, ",", &save)); str = NULL) {
+		struct libscols_column *cl;
+		int order = SCOLS_SORT_ASCENDING;
+		char *sep = strrchr(tok, ':');
+		int id;
+
+		if (sep) {
+			if (strcmp(sep + 1, "desc") == 0)
+				order = SCOLS_SORT_DESCENDING;
+			else if (strcmp(sep + 1, "asc") != 0)
+				errx(EXIT_FAILURE, _("unsupported sort order: %s"), sep + 1);
+			*sep = '\0';
+		}
+
+		id = column_name_to_id(tok, strlen(tok));
+		if (id < 0)
+			errtryhelp(EXIT_FAILURE);
+
+		cl = scols_table_get_column_by_name(ctl->tb, infos[id].name);
+		if (!cl)
+			cl = add_hidden_column(ctl, id);
+
+		ctl->sort_cols = xreallocarray(ctl->sort_cols,
+				ctl->nsort_cols + 1, sizeof(*ctl->sort_cols));
+		ctl->sort_orders = xreallocarray(ctl->sort_orders,
+				ctl->nsort_cols + 1, sizeof(*ctl->sort_orders));
+		ctl->sort_cols[ctl->nsort_cols] = cl;
+		ctl->sort_orders[ctl->nsort_cols] = order;
+		ctl->nsort_cols++;
+	}
+}
+
+static void parse_summary_argument(struct lsfd_control *ctl, char *arg)
+{
+	char *str, *tok, *save = NULL;
+	const char *by;
+
+	for (str = arg; (tok = strtok_r(str, ",", &save)); str = NULL) {
+		if (strcmp(tok, "never") == 0)
+			ctl->show_summary = 0, ctl->show_main = 1;
+		else if (strcmp(tok, "only") == 0)
+			ctl->show_summary = 1, ctl->show_main = 0;
+		else if (strcmp(tok, "append") == 0)
+			ctl->show_summary = 1, ctl->show_main = 1;
+		else if ((by = ul_startswith(tok, "by:")) && *by) {
+			if (column_name_to_id(by, strlen(by)) < 0)
+				errtryhelp(EXIT_FAILURE);
+			ctl->summary_by = xreallocarray(ctl->summary_by,
+						ctl->nsummary_by + 1, sizeof(char *));
+			ctl->summary_by[ctl->nsummary_by++] = by;
+		} else
+			errx(EXIT_FAILURE, _("unsupported --summary argument"));
+	}
+}
+
 static struct libscols_table *new_summary_table(struct lsfd_control *ctl)
 {
 	struct libscols_table *tb = scols_new_table();
 
 	struct libscols_column *name_cl, *value_cl;
+	size_t i;
 
 	if (!tb)
 		err(EXIT_FAILURE, _("failed to allocate summary table"));
@@ -2422,6 +2977,18 @@ static struct libscols_table *new_summary_table(struct lsfd_control *ctl)
 	if (ctl->json)
 		scols_column_set_json_type(value_cl, SCOLS_JSON_NUMBER);
 
+	for (i = 0; i < ctl->nsummary_by; i++) {
+		const char *by = ctl->summary_by[i];
+		int id = column_name_to_id(by, strlen(by));
+		struct libscols_column *by_cl;
+
+		by_cl = scols_table_new_column(tb, id >= 0 ? infos[id].name : by, 0, 0);
+		if (!by_cl)
+			err(EXIT_FAILURE, _("failed to allocate summary column"));
+		if (ctl->json)
+			scols_column_set_json_type(by_cl, SCOLS_JSON_STRING);
+	}
+
 	name_cl = scols_table_new_column(tb, _("COUNTER"), 0, 0);
 	if (!name_cl)
 		err(EXIT_FAILURE, _("failed to allocate summary column"));
@@ -2431,32 +2998,62 @@ static struct libscols_table *new_summary_table(struct lsfd_control *ctl)
 	return tb;
 }
 
+static void add_summary_line(struct libscols_table *tb,
+			     unsigned long long result,
+			     const char **keys, size_t nkeys,
+			     const char *name)
+{
+	struct libscols_line *ln;
+	size_t i;
+
+	ln = scols_table_new_line(tb, NULL);
+	if (!ln)
+		err(EXIT_FAILURE, _("failed to allocate summary line"));
+
+	if (scols_line_sprintf(ln, 0, "%llu", result))
+		err(EXIT_FAILURE, _("failed to add summary data"));
+	for (i = 0; i < nkeys; i++) {
+		if (keys[i] && scols_line_set_data(ln, i + 1, keys[i]))
+			err(EXIT_FAILURE, _("failed to add summary data"));
+	}
+	if (scols_line_set_data(ln, nkeys + 1, name))
+		err(EXIT_FAILURE, _("failed to add summary data"));
+}
+
 static void emit_summary(struct lsfd_control *ctl)
 {
-	struct libscols_iter *itr;
+	struct libscols_iter *itr, *gr_itr;
 	struct libscols_filter **ct_fltr;
 	struct libscols_table *tb = new_summary_table(ctl);
 
 	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	gr_itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr || !gr_itr)
+		err(EXIT_FAILURE, _("failed to allocate iterator"));
 
 	for (ct_fltr = ctl->ct_filters; *ct_fltr; ct_fltr++) {
 		struct libscols_counter *ct = NULL;
 
 		scols_reset_iter(itr, SCOLS_ITER_FORWARD);
 		while (scols_filter_next_counter(*ct_fltr, itr, &ct) == 0) {
-			struct libscols_line *ln;
+			const char **keys = NULL;
+			unsigned long long result;
 
-			ln = scols_table_new_line(tb, NULL);
-			if (!ln)
-				err(EXIT_FAILURE, _("failed to allocate summary line"));
+			if (!ctl->nsummary_by) {
+				add_summary_line(tb, scols_counter_get_result(ct),
+						 NULL, 0, scols_counter_get_name(ct));
+				continue;
+			}
 
-			if (scols_line_sprintf(ln, 0, "%llu", scols_counter_get_result(ct)))
-				err(EXIT_FAILURE, _("failed to add summary data"));
-			if (scols_line_set_data(ln, 1, scols_counter_get_name(ct)))
-				err(EXIT_FAILURE, _("failed to add summary data"));
+			/* one line for each unique combination of the --summary=by:<column> data */
+			scols_reset_iter(gr_itr, SCOLS_ITER_FORWARD);
+			while (scols_counter_next_group(ct, gr_itr, &keys, &result) == 0)
+				add_summary_line(tb, result, keys, ctl->nsummary_by,
+						 scols_counter_get_name(ct));
 		}
 	}
 
+	scols_free_iter(gr_itr);
 	scols_free_iter(itr);
 	scols_print_table(tb);
 
@@ -2496,6 +3093,337 @@ static void set_multiplexed_flags(struct list_head *procs)
 	}
 }
 
+/*
+ * --watch
+ *
+ * The device, namespace, mount and socket tables are kept across the
+ * iterations. A process is read again only if its fd table (or the list of
+ * its tasks with --threads) differs from the previous iteration, and the
+ * differences are reported as "open" and "close" events.
+ */
+struct watch_events {
+	struct file **files;
+	size_t nfiles;
+};
+
+static void add_event(struct watch_events *ev, struct file *file,
+		      enum file_event event)
+{
+	file->event = event;
+	ev->files = xreallocarray(ev->files, ev->nfiles + 1, sizeof(*ev->files));
+	ev->files[ev->nfiles++] = file;
+}
+
+static int cmp_file_fd(const void *a, const void *b)
+{
+	const struct file *fa = *(struct file * const *) a;
+	const struct file *fb = *(struct file * const *) b;
+
+	return (fa->association > fb->association)
+		- (fa->association < fb->association);
+}
+
+/* Returns the opened files of @proc sorted by fd. */
+static struct file **get_opened_files(struct proc *proc, size_t *nfiles)
+{
+	struct file **files;
+	struct list_head *f;
+	size_t n = 0;
+
+	list_for_each(f, &proc->files) {
+		if (is_opened_file(list_entry(f, struct file, files)))
+			n++;
+	}
+
+	files = xcalloc(n + 1, sizeof(*files));
+	n = 0;
+	list_for_each(f, &proc->files) {
+		struct file *file = list_entry(f, struct file, files);
+		if (is_opened_file(file))
+			files[n++] = file;
+	}
+	qsort(files, n, sizeof(*files), cmp_file_fd);
+
+	*nfiles = n;
+	return files;
+}
+
+static struct file *find_opened_file(struct file **files, size_t nfiles, int fd)
+{
+	struct file key = { .association = fd }, *pkey = &key, **res;
+
+	res = bsearch(&pkey, files, nfiles, sizeof(*files), cmp_file_fd);
+	return res ? *res : NULL;
+}
+
+static bool is_same_file(struct file *a, struct file *b)
+{
+	if (a->is_error || b->is_error)
+		return a->is_error && b->is_error
+			&& a->error.number == b->error.number;
+
+	return a->stat.st_dev == b->stat.st_dev
+		&& a->stat.st_ino == b->stat.st_ino;
+}
+
+/* Reports the differences between the opened files of @old and @new; one of
+ * them may be NULL.
+ */
+static void diff_opened_files(struct proc *old, struct proc *new,
+			      struct watch_events *ev)
+{
+	size_t nold = 0, nnew = 0, i = 0, j = 0;
+	struct file **ofiles = old ? get_opened_files(old, &nold) : NULL;
+	struct file **nfiles = new ? get_opened_files(new, &nnew) : NULL;
+
+	while (i < nold || j < nnew) {
+		int cmp = i == nold ? 1 :
+			  j == nnew ? -1 : cmp_file_fd(&ofiles[i], &nfiles[j]);
+
+		if (cmp < 0)
+			add_event(ev, ofiles[i++], FILE_EVENT_CLOSE);
+		else if (cmp > 0)
+			add_event(ev, nfiles[j++], FILE_EVENT_OPEN);
+		else {
+			if (!is_same_file(ofiles[i], nfiles[j])) {
+				add_event(ev, ofiles[i], FILE_EVENT_CLOSE);
+				add_event(ev, nfiles[j], FILE_EVENT_OPEN);
+			}
+			i++, j++;
+		}
+	}
+
+	free(ofiles);
+	free(nfiles);
+}
+
+/* Compares the symlinks in /proc/$pid/fd with the files read in the previous
+ * iteration.
+ */
+static bool is_fdset_changed(struct path_cxt *pc, struct proc *proc,
+			     bool sockets_only)
+{
+	char path[sizeof("fd/") + sizeof(stringify_value(INT_MAX))];
+	char sym[PATH_MAX];
+	struct file **files;
+	size_t nfiles, nfound = 0;
+	bool changed = false;
+	DIR *sub = NULL;
+	int fd;
+
+	files = get_opened_files(proc, &nfiles);
+
+	while (procfs_process_next_fd(pc, &sub, &fd) == 0) {
+		struct file *file = find_opened_file(files, nfiles, fd);
+
+		snprintf(path, sizeof(path), "fd/%d", fd);
+		if (ul_path_readlink(pc, sym, sizeof(sym), path) < 0) {
+			if (!file || !file->is_error)
+				changed = true;
+		} else if (!file) {
+			/* Only sockets are collected with --inet. */
+			if (sockets_only && strncmp(sym, "socket:", 7) != 0)
+				continue;
+			changed = true;
+		} else if (file->is_error || strcmp(sym, file->name) != 0)
+			changed = true;
+
+		if (changed) {
+			closedir(sub);
+			break;
+		}
+		nfound++;
+	}
+
+	free(files);
+	return changed || nfound != nfiles;
+}
+
+static bool is_proc_changed(struct lsfd_control *ctl, struct path_cxt *pc,
+			    struct list_head *procs, struct proc *leader)
+{
+	struct list_head *p;
+	size_t ntasks = 0, n = 0;
+	bool changed = false;
+	DIR *sub = NULL;
+	pid_t tid = 0;
+
+	if (procfs_process_init_path(pc, leader->pid) != 0)
+		return true;
+	if (is_fdset_changed(pc, leader, ctl->sockets_only))
+		changed = true;
+	if (changed || !ctl->threads)
+		goto done;
+
+	/* The tasks follow the leader in the list, see read_process(). */
+	for (p = leader->procs.next; p != procs; p = p->next) {
+		if (list_entry(p, struct proc, procs)->leader != leader)
+			break;
+		ntasks++;
+	}
+
+	while (procfs_process_next_tid(pc, &sub, &tid) == 0) {
+		struct proc *task;
+
+		if (tid == leader->pid)
+			continue;
+		task = get_proc(tid);
+		if (!task || task->leader != leader) {
+			changed = true;
+			closedir(sub);
+			break;
+		}
+		n++;
+	}
+	if (n != ntasks)
+		changed = true;
+ done:
+	ul_path_close_dirfd(pc);
+	return changed;
+}
+
+/* Moves @leader and its tasks from @procs to @dest. */
+static void move_proc_group(struct list_head *procs, struct proc *leader,
+			    struct list_head *dest)
+{
+	struct list_head *p = &leader->procs;
+
+	do {
+		struct list_head *next = p->next;
+
+		list_del(p);
+		list_add_tail(p, dest);
+		p = next;
+	} while (p != procs && list_entry(p, struct proc, procs)->leader == leader);
+}
+
+static struct proc *find_proc_in_list(struct list_head *procs, pid_t pid)
+{
+	struct list_head *p;
+
+	list_for_each(p, procs) {
+		struct proc *proc = list_entry(p, struct proc, procs);
+		if (proc->pid == pid)
+			return proc;
+	}
+	return NULL;
+}
+
+static void forget_procs(struct list_head *procs)
+{
+	struct list_head *p;
+
+	list_for_each(p, procs) {
+		struct proc *proc = list_entry(p, struct proc, procs);
+		tdelete(proc, &proc_tree, proc_tree_compare);
+	}
+}
+
+static void emit_events(struct lsfd_control *ctl, struct watch_events *ev)
+{
+	for (size_t i = 0; i < ev->nfiles; i++)
+		convert_proc_file(ev->files[i]->proc, ev->files[i], ctl);
+
+	if (scols_table_get_nlines(ctl->tb) == 0)
+		return;
+
+	if (ctl->nsort_cols
+	    && scols_sort_table_by_columns(ctl->tb, ctl->sort_cols,
+					   ctl->sort_orders, ctl->nsort_cols))
+		errx(EXIT_FAILURE, _("failed to sort output"));
+
+	scols_print_table(ctl->tb);
+	fflush(stdout);
+	scols_table_remove_lines(ctl->tb);
+
+	/* The stream of events has one header only. */
+	scols_table_enable_noheadings(ctl->tb, 1);
+}
+
+static void refresh_processes(struct lsfd_control *ctl,
+			      const pid_t pids[], int n_pids)
+{
+	struct watch_events ev = { .nfiles = 0 };
+	struct proc_slot *slots;
+	struct path_cxt *pc;
+	struct list_head old, *p;
+	size_t nslots, i;
+
+	INIT_LIST_HEAD(&old);
+	list_splice(&ctl->procs, &old);
+	INIT_LIST_HEAD(&ctl->procs);
+
+	nslots = read_proc_slots(&slots, pids, n_pids, getpid());
+
+	pc = ul_new_path(NULL);
+	if (!pc)
+		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
+
+	for (i = 0; i < nslots; i++) {
+		struct proc *leader = get_proc(slots[i].pid);
+
+		if (!leader || leader->leader != leader)
+			continue;
+		if (!is_proc_changed(ctl, pc, &old, leader)) {
+			slots[i].keep = true;
+			continue;
+		}
+		move_proc_group(&old, leader, &slots[i].old_procs);
+		forget_procs(&slots[i].old_procs);
+	}
+	ul_unref_path(pc);
+
+	collect_slots(ctl, slots, nslots);
+
+	for (i = 0; i < nslots; i++) {
+		struct proc_slot *slot = &slots[i];
+
+		if (slot->keep) {
+			move_proc_group(&old, get_proc(slot->pid), &ctl->procs);
+			continue;
+		}
+
+		attach_xinfos(&slot->procs);
+		if (ctl->show_xmode)
+			set_multiplexed_flags(&slot->procs);
+
+		list_for_each(p, &slot->procs) {
+			struct proc *proc = list_entry(p, struct proc, procs);
+			diff_opened_files(find_proc_in_list(&slot->old_procs, proc->pid),
+					  proc, &ev);
+		}
+		list_for_each(p, &slot->old_procs) {
+			struct proc *proc = list_entry(p, struct proc, procs);
+			if (!find_proc_in_list(&slot->procs, proc->pid))
+				diff_opened_files(proc, NULL, &ev);
+		}
+		list_splice(&slot->procs, ctl->procs.prev);
+	}
+
+	/* terminated processes */
+	list_for_each(p, &old)
+		diff_opened_files(list_entry(p, struct proc, procs), NULL, &ev);
+	forget_procs(&old);
+
+	emit_events(ctl, &ev);
+
+	for (i = 0; i < nslots; i++)
+		list_free(&slots[i].old_procs, struct proc, procs, free_proc);
+	list_free(&old, struct proc, procs, free_proc);
+
+	free(ev.files);
+	free(slots);
+}
+
+static void __attribute__((__noreturn__)) watch_processes(struct lsfd_control *ctl,
+							  const pid_t pids[], int n_pids)
+{
+	for (;;) {
+		nanosleep(&ctl->watch_interval, NULL);
+		refresh_processes(ctl, pids, n_pids);
+	}
+}
+
 /* Filter expressions for implementing -i option.
  *
  * To list up the protocol names, use the following command line
@@ -2523,7 +3451,7 @@ int main(int argc, char *argv[])
 {
 	int c, collist = 0;
 	size_t i;
-	char *outarg = NULL;
+	char *outarg = NULL, *sortarg = NULL;
 	char  *filter_expr = NULL;
 	bool debug_filter = false;
 	bool dump_counters = false;
@@ -2532,7 +3460,9 @@ int main(int argc, char *argv[])
 	struct list_head counter_specs;
 
 	struct lsfd_control ctl = {
-		.show_main = 1
+		.show_main = 1,
+		.workers = get_default_workers(),
+		.watch_interval = { .tv_sec = 1 }
 	};
 
 	INIT_LIST_HEAD(&counter_specs);
@@ -2542,7 +3472,9 @@ int main(int argc, char *argv[])
 		OPT_SUMMARY,
 		OPT_DUMP_COUNTERS,
 		OPT_DROP_PRIVILEGE,
-		OPT_HYPERLINK
+		OPT_HYPERLINK,
+		OPT_WORKERS,
+		OPT_WATCH
 	};
 	static const struct option longopts[] = {
 		{ "noheadings", no_argument, NULL, 'n' },
@@ -2563,6 +3495,9 @@ int main(int argc, char *argv[])
 		{ "list-columns",no_argument, NULL, 'H' },
 		{ "_drop-privilege",no_argument,NULL,OPT_DROP_PRIVILEGE },
 		{ "hyperlink",  optional_argument, NULL, OPT_HYPERLINK },
+		{ "sort",       required_argument, NULL, 'x' },
+		{ "workers",    required_argument, NULL, OPT_WORKERS },
+		{ "watch",      optional_argument, NULL, OPT_WATCH },
 		{ NULL, 0, NULL, 0 },
 	};
 
@@ -2573,7 +3508,7 @@ int main(int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "no:JrVhluQ:p:i::C:sH", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "no:JrVhluQ:p:i::C:sHx:", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'n':
 			ctl.noheadings = 1;
@@ -2619,6 +3554,9 @@ int main(int argc, char *argv[])
 		case 'Q':
 			append_filter_expr(&filter_expr, optarg, true);
 			break;
+		case 'x':
+			sortarg = optarg;
+			break;
 		case 'C': {
 			struct counter_spec *c = new_counter_spec(optarg);
 			list_add_tail(&c->specs, &counter_specs);
@@ -2628,17 +3566,9 @@ int main(int argc, char *argv[])
 			debug_filter = true;
 			break;
 		case OPT_SUMMARY:
-			if (optarg) {
-				if (strcmp(optarg, "never") == 0)
-					ctl.show_summary = 0, ctl.show_main = 1;
-				else if (strcmp(optarg, "only") == 0)
-					ctl.show_summary = 1, ctl.show_main = 0;
-				else if (strcmp(optarg, "append") == 0)
-					ctl.show_summary = 1, ctl.show_main = 1;
-				else
-					errx(EXIT_FAILURE, _("unsupported --summary argument"));
-			} else
-				ctl.show_summary = 1, ctl.show_main = 0;
+			ctl.show_summary = 1, ctl.show_main = 0;
+			if (optarg)
+				parse_summary_argument(&ctl, optarg);
 			break;
 		case OPT_DUMP_COUNTERS:
 			dump_counters = true;
@@ -2651,6 +3581,15 @@ int main(int argc, char *argv[])
 			if (hyperlinkwanted(optarg))
 				ctl.uri = xgethosturi(NULL);
 			break;
+		case OPT_WORKERS:
+			ctl.workers = strtou32_or_err(optarg, _("invalid number of workers"));
+			break;
+		case OPT_WATCH:
+			ctl.watch = true;
+			if (optarg)
+				strtotimespec_or_err(optarg, &ctl.watch_interval,
+						     _("invalid watch interval"));
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -2669,10 +3608,15 @@ int main(int argc, char *argv[])
 	if (argv[optind])
 		errtryhelp(EXIT_FAILURE);
 
+	if (ctl.watch && ctl.show_summary)
+		errx(EXIT_FAILURE, _("--watch and --summary are mutually exclusive"));
+
 #define INITIALIZE_COLUMNS(COLUMN_SPEC)				\
 	for (i = 0; i < ARRAY_SIZE(COLUMN_SPEC); i++)	\
 		columns[ncolumns++] = COLUMN_SPEC[i]
 	if (!ncolumns) {
+		if (ctl.watch)
+			columns[ncolumns++] = COL_EVENT;
 		if (ctl.threads)
 			INITIALIZE_COLUMNS(default_threads_columns);
 		else
@@ -2694,7 +3638,11 @@ int main(int argc, char *argv[])
 
 	scols_table_enable_noheadings(ctl.tb, ctl.noheadings);
 	scols_table_enable_raw(ctl.tb, ctl.raw);
-	scols_table_enable_json(ctl.tb, ctl.json);
+	if (ctl.watch)
+		/* a line per event */
+		scols_table_enable_ndjson(ctl.tb, ctl.json);
+	else
+		scols_table_enable_json(ctl.tb, ctl.json);
 	if (ctl.json)
 		scols_table_set_name(ctl.tb, "lsfd");
 
@@ -2712,6 +3660,9 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (sortarg)
+		parse_sort_argument(&ctl, sortarg);
+
 	/* make filter */
 	if (filter_expr) {
 		ctl.filter = new_filter(filter_expr, debug_filter, &ctl);
@@ -2760,15 +3711,23 @@ int main(int argc, char *argv[])
 	initialize_devdrvs();
 
 	collect_processes(&ctl, pids, n_pids);
-	free(pids);
 
 	attach_xinfos(&ctl.procs);
 	if (ctl.show_xmode)
 		set_multiplexed_flags(&ctl.procs);
 
+	if (ctl.watch)
+		watch_processes(&ctl, pids, n_pids);
+	free(pids);
+
 
 	convert(&ctl.procs, &ctl);
 
+	if (ctl.nsort_cols
+	    && scols_sort_table_by_columns(ctl.tb, ctl.sort_cols,
+					   ctl.sort_orders, ctl.nsort_cols))
+		errx(EXIT_FAILURE, _("failed to sort output"));
+
 	/* print */
 	if (ctl.show_main)
 		emit(&ctl);
@@ -72,6 +72,7 @@ enum {
 	COL_DEV,
 	COL_DEVTYPE,
 	COL_ENDPOINTS,
+	COL_EVENT,
 	COL_EVENTFD_ID,
 	COL_EVENTPOLL_TFDS,
 	COL_FD,
@@ -181,6 +182,7 @@ struct proc {
 	char *command;
 	uid_t uid;
 	struct mnt_namespace *mnt_ns;
+	ino_t netns_inode;
 	struct list_head procs;
 	struct list_head files;
 	unsigned int kthread: 1;
@@ -192,6 +194,12 @@ struct proc *get_proc(pid_t pid);
 /*
  * File class
  */
+enum file_event {
+	FILE_EVENT_NONE = 0,
+	FILE_EVENT_OPEN,	/* opened since the previous --watch iteration */
+	FILE_EVENT_CLOSE,	/* closed since the previous --watch iteration */
+};
+
 struct file {
 	struct list_head files;
 	const struct file_class *class;
@@ -218,6 +226,8 @@ struct file {
 		locked_write,
 		multiplexed,
 		is_error;
+
+	enum file_event event;
 };
 
 #define is_opened_file(_f) ((_f)->association >= 0)
@@ -272,6 +282,7 @@ struct ipc *get_ipc(struct file *file);
 void add_ipc(struct ipc *ipc, unsigned int hash);
 void init_endpoint(struct ipc_endpoint *endpoint);
 void add_endpoint(struct ipc_endpoint *endpoint, struct ipc *ipc);
+void del_endpoint(struct ipc_endpoint *endpoint);
 #define foreach_endpoint(E,ENDPOINT) list_for_each_backwardly(E, &((ENDPOINT).ipc->endpoints))
 
 enum decode_source_bit {
@@ -307,12 +318,17 @@ const char *get_miscdev(unsigned long minor);
 const char *get_nodev_filesystem(unsigned long minor);
 void add_nodev(unsigned long minor, const char *filesystem);
 
+/*
+ * Collector lock, see collect_processes()
+ */
+void lock_collector(void);
+void unlock_collector(void);
+
 /*
  * Net namespace
  */
-void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns);
+void add_sock_netns(struct path_cxt *pc, const char *name, ino_t netns);
 bool is_nsfs_dev(dev_t dev);
-void load_fdsk_xinfo(struct proc *proc, int fd);
 
 /*
  * POSIX Mqueue
@@ -71,8 +71,28 @@ static void fill_peers_of_unix_oneway_ipcs(void);
 static int self_netns_fd = -1;
 static struct stat self_netns_sb;
 
-static void *xinfo_tree;	/* for tsearch/tfind */
-static void *netns_tree;
+/*
+ * Socket information is loaded lazily: a network namespace is only
+ * registered while collecting processes, and the information for a
+ * family of sockets in the namespace is loaded the first time a socket
+ * of the family is attached. See get_sock_xinfo_lazily().
+ */
+enum {
+	SOCK_FAMILY_UNIX    = 1 << 0,
+	SOCK_FAMILY_INET    = 1 << 1,
+	SOCK_FAMILY_INET6   = 1 << 2,
+	SOCK_FAMILY_NETLINK = 1 << 3,
+	SOCK_FAMILY_PACKET  = 1 << 4,
+	SOCK_FAMILY_VSOCK   = 1 << 5,
+
+	SOCK_FAMILY_ALL     = (1 << 6) - 1,
+};
+
+#define XINFO_TABLE_SIZE 8191
+static struct list_head xinfo_table[XINFO_TABLE_SIZE];
+
+static void *netns_tree;	/* for tsearch/tfind */
+static struct list_head netnses;
 
 static struct list_head unix_ipcs;
 static void *unix_oneway_ipc_tree;	/* for tsearch/tfind */
@@ -87,6 +107,9 @@ static const char *get_iface_name(ino_t netns, unsigned int iface_index);
 struct netns {
 	ino_t inode;
 	struct iface *ifaces;
+	unsigned int loaded;	/* SOCK_FAMILY_* already loaded */
+	char *path;		/* for entering the namespace, or NULL */
+	struct list_head netnses;
 };
 
 static int netns_compare(const void *a, const void *b)
@@ -102,6 +125,7 @@ static void netns_free(void *netns)
 	struct netns *nsobj = netns;
 
 	free(nsobj->ifaces);
+	free(nsobj->path);
 	free(netns);
 }
 
@@ -136,132 +160,295 @@ static void load_ifaces_from_getifaddrs(struct netns *nsobj)
 	return;
 }
 
-static const char *get_iface_name(ino_t netns, unsigned int iface_index)
+static struct netns *get_netns(ino_t netns)
 {
 	struct netns key = { .inode = netns };
 	struct netns **nsobj = tfind(&key, &netns_tree, netns_compare);
-	if (!nsobj)
+
+	return nsobj? *nsobj: NULL;
+}
+
+static const char *get_iface_name(ino_t netns, unsigned int iface_index)
+{
+	struct netns *nsobj = get_netns(netns);
+
+	if (!nsobj || !nsobj->ifaces)
 		return NULL;
 
-	for (size_t i = 0; (*nsobj)->ifaces[i].index; i++) {
-		if ((*nsobj)->ifaces[i].index == iface_index)
-			return (*nsobj)->ifaces[i].name;
+	for (size_t i = 0; nsobj->ifaces[i].index; i++) {
+		if (nsobj->ifaces[i].index == iface_index)
+			return nsobj->ifaces[i].name;
 	}
 
 	return NULL;
 }
 
-static bool is_sock_xinfo_loaded(ino_t netns)
-{
-	struct netns key = { .inode = netns };
-	return tfind(&key, &netns_tree, netns_compare)? true: false;
-}
-
-static struct netns *mark_sock_xinfo_loaded(ino_t ino)
+static struct netns *add_netns(ino_t ino, const char *path)
 {
-	struct netns *netns = xcalloc(1, sizeof(*netns));
+	struct netns *netns = get_netns(ino);
 	ino_t **tmp;
 
+	if (netns) {
+		if (!netns->path && path)
+			netns->path = xstrdup(path);
+		return netns;
+	}
+
+	netns = xcalloc(1, sizeof(*netns));
 	netns->inode = ino;
+	netns->path = path? xstrdup(path): NULL;
 	tmp = tsearch(netns, &netns_tree, netns_compare);
 	if (tmp == NULL)
 		errx(EXIT_FAILURE, _("failed to allocate memory"));
-	return *(struct netns **)tmp;
+	list_add_tail(&netns->netnses, &netnses);
+	return netns;
 }
 
-static void load_sock_xinfo_no_nsswitch(struct netns *nsobj)
+/* setns(CLONE_NEWNET) switches the namespace of the calling thread only,
+ * but /proc/net refers to the namespace of the thread group leader. Use
+ * /proc/thread-self/net if available as the caller may be a worker thread
+ * collecting processes.
+ */
+static FILE *fopen_proc_net(const char *name)
+{
+	char path[PATH_MAX];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "/proc/thread-self/net/%s", name);
+	fp = fopen(path, "r");
+	if (!fp && errno == ENOENT) {
+		snprintf(path, sizeof(path), "/proc/net/%s", name);
+		fp = fopen(path, "r");
+	}
+	return fp;
+}
+
+static void load_sock_xinfo_no_nsswitch(struct netns *nsobj, unsigned int families)
 {
 	ino_t netns = nsobj? nsobj->inode: 0;
-	int diagsd;
-	enum sysfs_byteorder byteorder = sysfs_get_byteorder(NULL);
-
-	load_xinfo_from_proc_unix(netns);
-	load_xinfo_from_proc_tcp(netns, byteorder);
-	load_xinfo_from_proc_udp(netns, byteorder);
-	load_xinfo_from_proc_udplite(netns, byteorder);
-	load_xinfo_from_proc_raw(netns, byteorder);
-	load_xinfo_from_proc_tcp6(netns, byteorder);
-	load_xinfo_from_proc_udp6(netns, byteorder);
-	load_xinfo_from_proc_udplite6(netns, byteorder);
-	load_xinfo_from_proc_raw6(netns, byteorder);
-	load_xinfo_from_proc_icmp(netns, byteorder);
-	load_xinfo_from_proc_icmp6(netns, byteorder);
-	load_xinfo_from_proc_netlink(netns);
-	load_xinfo_from_proc_packet(netns);
-
-	diagsd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_SOCK_DIAG);
-	DBG(ENDPOINTS, ul_debug("made a diagnose socket [fd=%d; %s]", diagsd,
-				(diagsd >= 0)? "successful": strerror(errno)));
-	if (diagsd >= 0) {
-		load_xinfo_from_diag_unix(diagsd, netns);
-		load_xinfo_from_diag_vsock(diagsd, netns);
-		close(diagsd);
-		DBG(ENDPOINTS, ul_debug("close the diagnose socket"));
+	enum sysfs_byteorder byteorder = SYSFS_BYTEORDER_LITTLE;
+
+	if (families & (SOCK_FAMILY_INET | SOCK_FAMILY_INET6))
+		byteorder = sysfs_get_byteorder(NULL);
+
+	if (families & SOCK_FAMILY_UNIX)
+		load_xinfo_from_proc_unix(netns);
+	if (families & SOCK_FAMILY_INET) {
+		load_xinfo_from_proc_tcp(netns, byteorder);
+		load_xinfo_from_proc_udp(netns, byteorder);
+		load_xinfo_from_proc_udplite(netns, byteorder);
+		load_xinfo_from_proc_raw(netns, byteorder);
+		load_xinfo_from_proc_icmp(netns, byteorder);
+	}
+	if (families & SOCK_FAMILY_INET6) {
+		load_xinfo_from_proc_tcp6(netns, byteorder);
+		load_xinfo_from_proc_udp6(netns, byteorder);
+		load_xinfo_from_proc_udplite6(netns, byteorder);
+		load_xinfo_from_proc_raw6(netns, byteorder);
+		load_xinfo_from_proc_icmp6(netns, byteorder);
+	}
+	if (families & SOCK_FAMILY_NETLINK)
+		load_xinfo_from_proc_netlink(netns);
+	if (families & SOCK_FAMILY_PACKET)
+		load_xinfo_from_proc_packet(netns);
+
+	if (families & (SOCK_FAMILY_UNIX | SOCK_FAMILY_VSOCK)) {
+		int diagsd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_SOCK_DIAG);
+
+		DBG(ENDPOINTS, ul_debug("made a diagnose socket [fd=%d; %s]", diagsd,
+					(diagsd >= 0)? "successful": strerror(errno)));
+		if (diagsd >= 0) {
+			if (families & SOCK_FAMILY_UNIX)
+				load_xinfo_from_diag_unix(diagsd, netns);
+			if (families & SOCK_FAMILY_VSOCK)
+				load_xinfo_from_diag_vsock(diagsd, netns);
+			close(diagsd);
+			DBG(ENDPOINTS, ul_debug("close the diagnose socket"));
+		}
 	}
 
-	if (nsobj)
+	if (nsobj && (families & SOCK_FAMILY_PACKET) && !nsobj->ifaces)
 		load_ifaces_from_getifaddrs(nsobj);
+
+	if (families & SOCK_FAMILY_UNIX)
+		fill_peers_of_unix_oneway_ipcs();
 }
 
-static void load_sock_xinfo_with_fd(int fd, struct netns *nsobj)
+/* Load the socket information of @families in @nsobj unless it is
+ * loaded already. @nsfd is a file descriptor for the namespace; if it is
+ * negative, nsobj->path is opened instead.
+ */
+static void load_netns_families(struct netns *nsobj, unsigned int families, int nsfd)
 {
-	if (setns(fd, CLONE_NEWNET) == 0) {
-		load_sock_xinfo_no_nsswitch(nsobj);
+	struct stat sb;
+	int fd = nsfd;
+
+	families &= ~nsobj->loaded;
+	if (!families)
+		return;
+
+	if (nsobj->inode == self_netns_sb.st_ino) {
+		nsobj->loaded |= families;
+		load_sock_xinfo_no_nsswitch(nsobj, families);
+		return;
+	}
+
+	if (fd < 0) {
+		if (!nsobj->path)
+			return;	/* may be loaded later via SIOCGSKNS */
+		fd = open(nsobj->path, O_RDONLY);
+	}
+
+	/* Don't try again even if entering the namespace fails. */
+	nsobj->loaded |= families;
+
+	/* The process owning the path may be gone and the pid reused. */
+	if (fd >= 0 && fstat(fd, &sb) == 0 && sb.st_ino == nsobj->inode
+	    && setns(fd, CLONE_NEWNET) == 0) {
+		DBG(ENDPOINTS, ul_debug("load families 0x%x of netns %llu",
+					families, (unsigned long long)nsobj->inode));
+		load_sock_xinfo_no_nsswitch(nsobj, families);
 		setns(self_netns_fd, CLONE_NEWNET);
 	}
+
+	if (fd >= 0 && fd != nsfd)
+		close(fd);
 }
 
-void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns)
+void add_sock_netns(struct path_cxt *pc, const char *name, ino_t netns)
 {
+	char path[PATH_MAX];
+
 	if (self_netns_fd == -1)
 		return;
 
-	if (!is_sock_xinfo_loaded(netns)) {
-		int fd;
-		struct netns *nsobj = mark_sock_xinfo_loaded(netns);
-		fd = ul_path_open(pc, O_RDONLY, name);
-		if (fd < 0)
-			return;
-
-		load_sock_xinfo_with_fd(fd, nsobj);
-		close(fd);
-	}
+	lock_collector();
+	add_netns(netns, ul_path_get_abspath(pc, path, sizeof(path), "%s", name));
+	unlock_collector();
 }
 
-void load_fdsk_xinfo(struct proc *proc, int fd)
+/* Find the network namespace that the socket opened as @fd by @proc
+ * belongs to. On success, an fd for the namespace is stored to @nsfd.
+ */
+static struct netns *get_fdsk_netns(struct proc *proc, int fd, int *nsfd)
 {
-	int pidfd, sk, nsfd;
-	struct netns *nsobj;
+	int pidfd, sk;
+	struct netns *nsobj = NULL;
 	struct stat sb;
 
 	/* This is additional/extra information, ignoring failures. */
 	pidfd = pidfd_open(proc->pid, 0);
 	if (pidfd < 0)
-		return;
+		return NULL;
 
 	sk = pidfd_getfd(pidfd, fd, 0);
 	if (sk < 0)
 		goto out_pidfd;
 
-	nsfd = ioctl(sk, SIOCGSKNS);
-	if (nsfd < 0)
+	*nsfd = ioctl(sk, SIOCGSKNS);
+	if (*nsfd < 0)
 		goto out_sk;
 
-	if (fstat(nsfd, &sb) < 0)
-		goto out_nsfd;
-
-	if (is_sock_xinfo_loaded(sb.st_ino))
-		goto out_nsfd;
-
-	nsobj = mark_sock_xinfo_loaded(sb.st_ino);
-	load_sock_xinfo_with_fd(nsfd, nsobj);
+	if (fstat(*nsfd, &sb) < 0) {
+		close(*nsfd);
+		*nsfd = -1;
+		goto out_sk;
+	}
+	nsobj = add_netns(sb.st_ino, NULL);
 
-out_nsfd:
-	close(nsfd);
 out_sk:
 	close(sk);
 out_pidfd:
 	close(pidfd);
+	return nsobj;
+}
+
+static const struct {
+	const char *protoname;
+	unsigned int families;
+} sock_proto_families[] = {
+	{ "UNIX",        SOCK_FAMILY_UNIX    },
+	{ "UNIX-STREAM", SOCK_FAMILY_UNIX    },
+	{ "TCP",         SOCK_FAMILY_INET    },
+	{ "UDP",         SOCK_FAMILY_INET    },
+	{ "UDP-Lite",    SOCK_FAMILY_INET    },
+	{ "RAW",         SOCK_FAMILY_INET    },
+	{ "PING",        SOCK_FAMILY_INET    },
+	{ "TCPv6",       SOCK_FAMILY_INET6   },
+	{ "UDPv6",       SOCK_FAMILY_INET6   },
+	{ "UDPLITEv6",   SOCK_FAMILY_INET6   },
+	{ "RAWv6",       SOCK_FAMILY_INET6   },
+	{ "PINGv6",      SOCK_FAMILY_INET6   },
+	{ "NETLINK",     SOCK_FAMILY_NETLINK },
+	{ "PACKET",      SOCK_FAMILY_PACKET  },
+	{ "AF_VSOCK",    SOCK_FAMILY_VSOCK   },
+};
+
+static unsigned int protoname_to_families(const char *protoname)
+{
+	if (protoname) {
+		for (size_t i = 0; i < ARRAY_SIZE(sock_proto_families); i++)
+			if (strcmp(sock_proto_families[i].protoname, protoname) == 0)
+				return sock_proto_families[i].families;
+	}
+	return SOCK_FAMILY_ALL;
+}
+
+/* Look up the extra information for @sock, loading only the socket family
+ * of @sock in the network namespaces where the socket may live:
+ *
+ *  1. the network namespace of the process,
+ *  2. the network namespace reported by SIOCGSKNS for the socket,
+ *  3. the other network namespaces known to lsfd.
+ *
+ * The last step is skipped if the family of the socket is unknown.
+ */
+struct sock_xinfo *get_sock_xinfo_lazily(struct sock *sock)
+{
+	struct file *file = &sock->file;
+	ino_t ino = file->stat.st_ino;
+	struct sock_xinfo *xinfo = get_sock_xinfo(ino);
+	unsigned int families;
+	struct netns *nsobj;
+	struct list_head *n;
+
+	if (xinfo || self_netns_fd == -1)
+		return xinfo;
+
+	families = protoname_to_families(sock->protoname);
+
+	nsobj = get_netns(file->proc->netns_inode);
+	if (nsobj && (families & ~nsobj->loaded)) {
+		load_netns_families(nsobj, families, -1);
+		if ((xinfo = get_sock_xinfo(ino)))
+			return xinfo;
+	}
+
+	if (file->association >= 0) {
+		int nsfd = -1;
+
+		nsobj = get_fdsk_netns(file->proc, file->association, &nsfd);
+		if (nsfd >= 0) {
+			load_netns_families(nsobj, families, nsfd);
+			close(nsfd);
+			if ((xinfo = get_sock_xinfo(ino)))
+				return xinfo;
+		}
+	}
+
+	if (families == SOCK_FAMILY_ALL)
+		return NULL;
+
+	list_for_each(n, &netnses) {
+		nsobj = list_entry(n, struct netns, netnses);
+		if (!(families & ~nsobj->loaded))
+			continue;
+		load_netns_families(nsobj, families, -1);
+		if ((xinfo = get_sock_xinfo(ino)))
+			return xinfo;
+	}
+
+	return NULL;
 }
 
 void initialize_sock_xinfos(void)
@@ -271,24 +458,30 @@ void initialize_sock_xinfos(void)
 	struct dirent *d;
 
 	INIT_LIST_HEAD(&unix_ipcs);
+	INIT_LIST_HEAD(&netnses);
+	for (int i = 0; i < XINFO_TABLE_SIZE; i++)
+		INIT_LIST_HEAD(&xinfo_table[i]);
 
 	self_netns_fd = open("/proc/self/ns/net", O_RDONLY);
 
-	if (self_netns_fd < 0)
-		load_sock_xinfo_no_nsswitch(NULL);
-	else {
-		if (fstat(self_netns_fd, &self_netns_sb) == 0) {
-			unsigned long m;
-			struct netns *nsobj = mark_sock_xinfo_loaded(self_netns_sb.st_ino);
-			load_sock_xinfo_no_nsswitch(nsobj);
+	if (self_netns_fd < 0) {
+		/* No way to switch namespaces; load everything at once. */
+		load_sock_xinfo_no_nsswitch(NULL, SOCK_FAMILY_ALL);
+		return;
+	}
 
-			m = minor(self_netns_sb.st_dev);
-			add_nodev(m, "nsfs");
-		}
+	if (fstat(self_netns_fd, &self_netns_sb) == 0) {
+		unsigned long m;
+
+		add_netns(self_netns_sb.st_ino, NULL);
+
+		m = minor(self_netns_sb.st_dev);
+		add_nodev(m, "nsfs");
 	}
 
-	/* Load /proc/net/{unix,...} of the network namespace
-	 * specified with netns files under /var/run/netns/.
+	/* Register the network namespaces specified with netns files
+	 * under /var/run/netns/ so that sockets in them can be found
+	 * even if no process in the namespaces is collected.
 	 *
 	 * `ip netns' command pins a network namespace on
 	 * /var/run/netns.
@@ -301,32 +494,25 @@ void initialize_sock_xinfos(void)
 		goto out;
 	while ((d = readdir(dir))) {
 		struct stat sb;
-		int fd;
-		struct netns *nsobj;
+		char path[PATH_MAX];
+
 		if (ul_path_stat(pc, &sb, 0, d->d_name) < 0)
 			continue;
-		if (is_sock_xinfo_loaded(sb.st_ino))
+		if (!is_nsfs_dev(sb.st_dev))
 			continue;
-		nsobj = mark_sock_xinfo_loaded(sb.st_ino);
-		fd = ul_path_open(pc, O_RDONLY, d->d_name);
-		if (fd < 0)
-			continue;
-		load_sock_xinfo_with_fd(fd, nsobj);
-		close(fd);
+		add_netns(sb.st_ino, ul_path_get_abspath(pc, path, sizeof(path),
+							 "%s", d->d_name));
 	}
 	closedir(dir);
  out:
 	ul_unref_path(pc);
-
-	fill_peers_of_unix_oneway_ipcs();
 }
 
-static void free_sock_xinfo(void *node)
+static void free_sock_xinfo(struct sock_xinfo *xinfo)
 {
-	struct sock_xinfo *xinfo = node;
 	if (xinfo->class->free)
 		xinfo->class->free(xinfo);
-	free(node);
+	free(xinfo);
 }
 
 static void do_nothing(void *node __attribute__((__unused__)))
@@ -338,30 +524,29 @@ void finalize_sock_xinfos(void)
 	if (self_netns_fd != -1)
 		close(self_netns_fd);
 	tdestroy(netns_tree, netns_free);
-	tdestroy(xinfo_tree, free_sock_xinfo);
-	tdestroy(unix_oneway_ipc_tree, do_nothing);
-}
+	for (int i = 0; i < XINFO_TABLE_SIZE; i++) {
+		struct list_head *x, *xnext;
 
-static int xinfo_compare(const void *a, const void *b)
-{
-	return ((struct sock_xinfo *)a)->inode - ((struct sock_xinfo *)b)->inode;
+		list_for_each_safe(x, xnext, &xinfo_table[i])
+			free_sock_xinfo(list_entry(x, struct sock_xinfo, xinfos));
+	}
+	tdestroy(unix_oneway_ipc_tree, do_nothing);
 }
 
 static void add_sock_info(struct sock_xinfo *xinfo)
 {
-	struct sock_xinfo **tmp = tsearch(xinfo, &xinfo_tree, xinfo_compare);
-
-	if (tmp == NULL)
-		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	list_add_tail(&xinfo->xinfos, &xinfo_table[xinfo->inode % XINFO_TABLE_SIZE]);
 }
 
 struct sock_xinfo *get_sock_xinfo(ino_t inode)
 {
-	struct sock_xinfo key = { .inode = inode };
-	struct sock_xinfo **xinfo = tfind(&key, &xinfo_tree, xinfo_compare);
+	struct list_head *x;
 
-	if (xinfo)
-		return *xinfo;
+	list_for_each(x, &xinfo_table[inode % XINFO_TABLE_SIZE]) {
+		struct sock_xinfo *xinfo = list_entry(x, struct sock_xinfo, xinfos);
+		if (xinfo->inode == inode)
+			return xinfo;
+	}
 	return NULL;
 }
 
@@ -740,7 +925,7 @@ static void load_xinfo_from_proc_unix(ino_t netns_inode)
 	char line[UNIX_LINE_LEN];
 	FILE *unix_fp;
 
-	unix_fp = fopen("/proc/net/unix", "r");
+	unix_fp = fopen_proc_net("unix");
 	DBG(ENDPOINTS, ul_debug("open /proc/net/unix [fp=%p; %s]", unix_fp,
 				unix_fp? "successful": strerror(errno)));
 	if (!unix_fp)
@@ -949,13 +1134,17 @@ static void fill_peers_of_unix_oneway_ipcs(void)
 		struct unix_ipc *unix_ipc = list_entry(e, struct unix_ipc, unix_ipcs);
 		struct unix_ipc *unix_oneway_ipc;
 
-		list_del_init(e);
-		if (unix_ipc->ipeer == 0)
+		if (unix_ipc->ipeer == 0) {
+			list_del_init(e);
 			continue;
+		}
 
+		/* The peer may be in a network namespace not loaded yet;
+		 * keep the ipc in the list for trying again later. */
 		unix_oneway_ipc = get_unix_oneway_ipc(unix_ipc->ipeer);
 		if (unix_oneway_ipc == NULL)
 			continue;
+		list_del_init(e);
 		list_add(e, &unix_oneway_ipc->unix_ipcs);
 	};
 }
@@ -1285,7 +1474,7 @@ static void load_xinfo_from_proc_inet_L4(ino_t netns_inode, const char *proc_fil
 	char line[TCP_LINE_LEN];
 	FILE *tcp_fp;
 
-	tcp_fp = fopen(proc_file, "r");
+	tcp_fp = fopen_proc_net(proc_file);
 	if (!tcp_fp)
 		return;
 
@@ -1308,7 +1497,7 @@ static void load_xinfo_from_proc_inet_L4(ino_t netns_inode, const char *proc_fil
 static void load_xinfo_from_proc_tcp(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/tcp",
+				     "tcp",
 				     &tcp_xinfo_class,
 				     byteorder);
 }
@@ -1384,7 +1573,7 @@ static const struct l4_xinfo_class udp_xinfo_class = {
 static void load_xinfo_from_proc_udp(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/udp",
+				     "udp",
 				     &udp_xinfo_class,
 				     byteorder);
 }
@@ -1423,7 +1612,7 @@ static const struct l4_xinfo_class udplite_xinfo_class = {
 static void load_xinfo_from_proc_udplite(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/udplite",
+				     "udplite",
 				     &udplite_xinfo_class,
 				     byteorder);
 }
@@ -1553,7 +1742,7 @@ static const struct l4_xinfo_class raw_xinfo_class = {
 static void load_xinfo_from_proc_raw(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/raw",
+				     "raw",
 				     &raw_xinfo_class,
 				     byteorder);
 }
@@ -1612,7 +1801,7 @@ static const struct l4_xinfo_class ping_xinfo_class = {
 static void load_xinfo_from_proc_icmp(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/icmp",
+				     "icmp",
 				     &ping_xinfo_class,
 				     byteorder);
 }
@@ -1708,7 +1897,7 @@ static const struct l4_xinfo_class tcp6_xinfo_class = {
 static void load_xinfo_from_proc_tcp6(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/tcp6",
+				     "tcp6",
 				     &tcp6_xinfo_class,
 				     byteorder);
 }
@@ -1747,7 +1936,7 @@ static const struct l4_xinfo_class udp6_xinfo_class = {
 static void load_xinfo_from_proc_udp6(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/udp6",
+				     "udp6",
 				     &udp6_xinfo_class,
 				     byteorder);
 }
@@ -1786,7 +1975,7 @@ static const struct l4_xinfo_class udplite6_xinfo_class = {
 static void load_xinfo_from_proc_udplite6(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/udplite6",
+				     "udplite6",
 				     &udplite6_xinfo_class,
 				     byteorder);
 }
@@ -1878,7 +2067,7 @@ static const struct l4_xinfo_class raw6_xinfo_class = {
 static void load_xinfo_from_proc_raw6(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/raw6",
+				     "raw6",
 				     &raw6_xinfo_class,
 				     byteorder);
 }
@@ -1925,7 +2114,7 @@ static const struct l4_xinfo_class ping6_xinfo_class = {
 static void load_xinfo_from_proc_icmp6(ino_t netns_inode, enum sysfs_byteorder byteorder)
 {
 	load_xinfo_from_proc_inet_L4(netns_inode,
-				     "/proc/net/icmp6",
+				     "icmp6",
 				     &ping6_xinfo_class,
 				     byteorder);
 }
@@ -2057,7 +2246,7 @@ static void load_xinfo_from_proc_netlink(ino_t netns_inode)
 	char line[BUFSIZ];
 	FILE *netlink_fp;
 
-	netlink_fp = fopen("/proc/net/netlink", "r");
+	netlink_fp = fopen_proc_net("netlink");
 	if (!netlink_fp)
 		return;
 
@@ -2462,7 +2651,7 @@ static void load_xinfo_from_proc_packet(ino_t netns_inode)
 	char line[BUFSIZ];
 	FILE *packet_fp;
 
-	packet_fp = fopen("/proc/net/packet", "r");
+	packet_fp = fopen_proc_net("packet");
 	if (!packet_fp)
 		return;
 
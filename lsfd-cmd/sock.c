@@ -29,7 +29,7 @@ static void attach_sock_xinfo(struct file *file)
 {
 	struct sock *sock = (struct sock *)file;
 
-	sock->xinfo = get_sock_xinfo(file->stat.st_ino);
+	sock->xinfo = get_sock_xinfo_lazily(sock);
 	if (sock->xinfo) {
 		struct ipc *ipc = get_ipc(file);
 		if (ipc)
@@ -177,6 +177,7 @@ static void free_sock_content(struct file *file)
 		free(sock->protoname);
 		sock->protoname = NULL;
 	}
+	del_endpoint(&sock->endpoint);
 }
 
 static void initialize_sock_class(void)
@@ -37,6 +37,7 @@ struct sock_xinfo {
 	ino_t netns_inode;	/* inode of netns where
 				   the socket belongs to */
 	const struct sock_xinfo_class *class;
+	struct list_head xinfos;	/* hash chain, see get_sock_xinfo() */
 };
 
 struct sock {
@@ -70,5 +71,6 @@ void initialize_sock_xinfos(void);
 void finalize_sock_xinfos(void);
 
 struct sock_xinfo *get_sock_xinfo(ino_t inode);
+struct sock_xinfo *get_sock_xinfo_lazily(struct sock *sock);
 
 #endif /* UTIL_LINUX_LSFD_SOCK_H */
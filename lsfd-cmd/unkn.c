@@ -300,7 +300,10 @@ static void anon_eventfd_init(struct unkn *unkn)
 
 static void anon_eventfd_free(struct unkn *unkn)
 {
-	free(unkn->anon_data);
+	struct anon_eventfd_data *data = (struct anon_eventfd_data *)unkn->anon_data;
+
+	del_endpoint(&data->endpoint);
+	free(data);
 }
 
 static void anon_eventfd_attach_xinfo(struct unkn *unkn)
@@ -24,20 +24,22 @@
  * THE SOFTWARE.
  */
 #define _POSIX_C_SOURCE 200112L	/* POSIX functions */
-#define _XOPEN_SOURCE      600	/* nftw() */
 
 #include <sys/types.h>		/* stat */
 #include <sys/stat.h>		/* stat */
 #include <sys/time.h>		/* getrlimit, getrusage */
 #include <sys/resource.h>	/* getrlimit, getrusage */
 #include <fcntl.h>		/* posix_fadvise */
-#include <ftw.h>		/* ftw */
 #include <search.h>		/* tsearch() and friends */
 #include <signal.h>		/* SIG*, sigaction */
 #include <getopt.h>		/* getopt_long() */
 #include <ctype.h>		/* tolower() */
 #include <sys/ioctl.h>
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
 #if defined(HAVE_LINUX_FIEMAP_H) && defined(HAVE_SYS_VFS_H)
 # include <linux/fs.h>
 # include <linux/fiemap.h>
@@ -46,10 +48,6 @@
 # endif
 #endif
 
-#if defined(FTW_ACTIONRETVAL) && defined(FTW_SKIP_SUBTREE)
-# define USE_SKIP_SUBTREE 1
-#endif
-
 #include "nls.h"
 #include "c.h"
 #include "xalloc.h"
@@ -57,6 +55,9 @@
 #include "monotonic.h"
 #include "optutils.h"
 #include "fileeq.h"
+#include "fileutils.h"
+#include "closestream.h"
+#include "dirwalk.h"
 
 #ifdef USE_REFLINK
 # include "statfs_magic.h"
@@ -70,7 +71,7 @@
 #endif
 
 static int quiet;		/* don't print anything */
-static int rootbasesz;		/* size of the directory for nftw() */
+static int rootbasesz;		/* size of the directory for ul_dirwalk() */
 
 static unsigned short curr_tree;	/* seq. number of the current top-level directory */
 
@@ -90,6 +91,11 @@ static struct ul_fileeq fileeq;
  * struct file - Information about a file
  * @st:       The stat buffer associated with the file
  * @next:     Next file with the same size
+ * @eqmaster: The first file with the same content, see compare_groups()
+ * @digest:   Digests of the content for the digest cache
+ * @fiemap:   The extents map, only when compared by compare_group()
+ * @extmaster: The master the extents has been compared with
+ * @is_shared: Whether the file shares all extents with @extmaster
  * @basename: The offset off the basename in the filename
  * @path:     The path of the file
  *
@@ -100,6 +106,14 @@ struct file {
 	struct ul_fileeq_data data;
 
 	struct file *next;
+	struct file *eqmaster;
+	struct hdl_digest *digest;
+#ifdef USE_REFLINK
+	struct fiemap *fiemap;
+	struct file *extmaster;
+	bool fiemap_done;
+	bool is_shared;
+#endif
 	struct link {
 		struct link *next;
 		int basename;
@@ -176,6 +190,7 @@ struct hdl_regex {
  * @dry_run: Specifies whether hardlink should not link files (default = FALSE)
  * @min_size: Minimum size of files to consider. (default = 1 byte)
  * @max_size: Maximum size of files to consider, 0 means umlimited. (default = 0 byte)
+ * @digest_cache: Path to the file with cached content digests (default = NULL)
  */
 static struct options {
 	struct hdl_regex *include;
@@ -183,6 +198,7 @@ static struct options {
 	struct hdl_regex *exclude_subtree;
 
 	const char *method;
+	const char *digest_cache;
 	short int verbosity;
 
 	bool respect_mode;
@@ -234,7 +250,7 @@ static void *files_by_ino;
  * last_signal
  *
  * The last signal we received. We store the signal here in order to be able
- * to break out of loops gracefully and to return from our nftw() handler.
+ * to break out of loops gracefully and to return from our ul_dirwalk() handler.
  */
 static volatile sig_atomic_t last_signal;
 
@@ -642,14 +658,15 @@ static int file_xattrs_equal(const struct file *a, const struct file *b)
 #endif /* USE_XATTR */
 
 /**
- * file_may_link_to - Check whether a file may replace another one
+ * file_stat_may_link_to - Check whether a file may replace another one
  * @a: The first file
  * @b: The second file
  *
- * Check whether the two files are considered equal attributes and can be
- * linked. This function does not compare content od the files!
+ * The same as file_may_link_to(), but extended attributes are not compared.
+ * This function does not use any global state and it's safe to call it from
+ * compare_groups() threads.
  */
-static inline int file_may_link_to(const struct file *a, const struct file *b)
+static inline int file_stat_may_link_to(const struct file *a, const struct file *b)
 {
 	return (a->st.st_size == b->st.st_size &&
 		a->links != NULL && b->links != NULL &&
@@ -660,7 +677,20 @@ static inline int file_may_link_to(const struct file *a, const struct file *b)
 		(!opts.respect_owner || a->st.st_gid == b->st.st_gid) &&
 		(!opts.respect_time || a->st.st_mtime == b->st.st_mtime) &&
 		(!opts.respect_name || filename_strcmp(a, b) == 0) &&
-		(!opts.respect_dir || dirname_strcmp(a, b) == 0) &&
+		(!opts.respect_dir || dirname_strcmp(a, b) == 0));
+}
+
+/**
+ * file_may_link_to - Check whether a file may replace another one
+ * @a: The first file
+ * @b: The second file
+ *
+ * Check whether the two files are considered equal attributes and can be
+ * linked. This function does not compare content od the files!
+ */
+static inline int file_may_link_to(const struct file *a, const struct file *b)
+{
+	return (file_stat_may_link_to(a, b) &&
 		(!opts.respect_xattrs || file_xattrs_equal(a, b)));
 }
 
@@ -695,6 +725,65 @@ static inline int file_compare(const struct file *a, const struct file *b)
 }
 
 #ifdef USE_REFLINK
+/**
+ * dedupe_file - Share extents of the files by FIDEDUPERANGE
+ * @a: The source file
+ * @b: The destination file
+ *
+ * The kernel compares the content and shares the extents only if the
+ * content is the same. The destination file is modified in place, so all
+ * links of the file are deduplicated at once.
+ *
+ * Returns 1 on success, 0 if not supported (use FICLONE), or -EBADE if the
+ * content differs.
+ */
+static int dedupe_file(struct file *a, struct file *b)
+{
+	struct file_dedupe_range *range;
+	off_t off = 0, size = a->st.st_size;
+	int src, dest, rc = 0;
+
+	src = open(a->links->path, O_RDONLY);
+	if (src < 0)
+		return 0;
+	dest = open(b->links->path, O_RDWR);
+	if (dest < 0 && errno == EACCES)
+		/* the owner is allowed to dedupe read-only file (since 4.19) */
+		dest = open(b->links->path, O_RDONLY);
+	if (dest < 0) {
+		close(src);
+		return 0;
+	}
+
+	range = xcalloc(1, sizeof(*range) + sizeof(struct file_dedupe_range_info));
+	range->dest_count = 1;
+	range->info[0].dest_fd = dest;
+
+	while (off < size) {
+		range->src_offset = off;
+		range->src_length = size - off;
+		range->info[0].dest_offset = off;
+		range->info[0].bytes_deduped = 0;
+
+		if (ioctl(src, FIDEDUPERANGE, range) != 0 ||
+		    range->info[0].status < 0)
+			goto done;
+		if (range->info[0].status == FILE_DEDUPE_RANGE_DIFFERS) {
+			rc = -EBADE;
+			goto done;
+		}
+		if (range->info[0].bytes_deduped == 0)
+			goto done;
+
+		off += range->info[0].bytes_deduped;
+	}
+	rc = 1;
+done:
+	free(range);
+	close(dest);
+	close(src);
+	return rc;
+}
 static inline int do_link(struct file *a, struct file *b,
 			  const char *new_name, int reflink)
 {
@@ -752,6 +841,9 @@ static inline int do_link(struct file *a,
  */
 static int file_link(struct file *a, struct file *b, int reflink)
 {
+#ifdef USE_REFLINK
+	int deduped = 0;
+#endif
 
  file_link:
 	assert(a->links != NULL);
@@ -769,7 +861,23 @@ static int file_link(struct file *a, struct file *b, int reflink)
 		free(ssz);
 	}
 
+#ifdef USE_REFLINK
+	/* all links of b are deduplicated at once */
+	if (reflink && !opts.dry_run && !deduped) {
+		int rc = dedupe_file(a, b);
+
+		if (rc == -EBADE) {
+			jlog(VERBOSE2, printf(_("Skipped (content changed) %s"),
+						b->links->path));
+			errno = 0;
+			return FALSE;
+		}
+		deduped = rc == 1;
+	}
+	if (!opts.dry_run && !deduped) {
+#else
 	if (!opts.dry_run) {
+#endif
 		char *new_path;
 		int failed = 1;
 
@@ -829,18 +937,19 @@ static inline int has_fpath(struct file *node, const char *path)
 
 
 /**
- * inserter - Callback function for nftw()
- * @fpath: The path of the file being visited
- * @sb:    The stat information of the file
- * @typeflag: The type flag
- * @ftwbuf:   Contains current level of nesting and offset of basename
+ * inserter - Callback function for ul_dirwalk()
+ * @ent:   The file being visited
+ * @data:  Unused
  *
- * Called by nftw() for the files. See the manual page for nftw() for
- * further information.
+ * Called by ul_dirwalk() for the files, never concurrently. See
+ * lib/dirwalk.c for further information.
  */
-static int inserter(const char *fpath, const struct stat *sb,
-		    int typeflag, struct FTW *ftwbuf)
+static int inserter(struct ul_dirwalk_entry *ent,
+		    void *data __attribute__((__unused__)))
 {
+	const char *fpath = ent->path;
+	const struct stat *sb = &ent->st;
+	struct link **pl;
 	struct file *fil;
 	struct file **node;
 	size_t pathlen;
@@ -848,18 +957,18 @@ static int inserter(const char *fpath, const struct stat *sb,
 	int excluded;
 
 	handle_interrupt();
-	if (typeflag == FTW_DNR || typeflag == FTW_NS)
+	if (ent->type == UL_DIRWALK_DNR || ent->type == UL_DIRWALK_NS) {
+		errno = ent->err;
 		warn(_("cannot read %s"), fpath);
-#ifdef USE_SKIP_SUBTREE
+	}
 	if (opts.exclude_subtree
-	    && typeflag == FTW_D
+	    && ent->type == UL_DIRWALK_DIR
 	    && match_any_regex(opts.exclude_subtree, fpath)) {
 		jlog(VERBOSE1,
 			printf(_("Skipped (excluded subtree) %s"), fpath));
-		return FTW_SKIP_SUBTREE;
+		return UL_DIRWALK_SKIP;
 	}
-#endif
-	if (typeflag != FTW_F || !S_ISREG(sb->st_mode))
+	if (ent->type != UL_DIRWALK_FILE || !S_ISREG(sb->st_mode))
 		return 0;
 
 	included = match_any_regex(opts.include, fpath);
@@ -896,7 +1005,7 @@ static int inserter(const char *fpath, const struct stat *sb,
 	fil->links = xcalloc(1, sizeof(struct link) + pathlen);
 
 	fil->st = *sb;
-	fil->links->basename = ftwbuf->base;
+	fil->links->basename = ent->base;
 	fil->links->dirname = rootbasesz;
 	fil->links->next = NULL;
 	fil->tree_seqnum = curr_tree;
@@ -918,8 +1027,14 @@ static int inserter(const char *fpath, const struct stat *sb,
 				printf(_("Skipped (specified more than once) %s"), fpath));
 			free(fil->links);
 		} else {
-			fil->links->next = (*node)->links;
-			(*node)->links = fil->links;
+			/* keep the links sorted, the order of the files
+			 * from ul_dirwalk() is not stable */
+			for (pl = &(*node)->links; *pl; pl = &(*pl)->next) {
+				if (strcmp((*pl)->path, fpath) > 0)
+					break;
+			}
+			fil->links->next = *pl;
+			*pl = fil->links;
 		}
 
 		free(fil);
@@ -961,8 +1076,9 @@ static int inserter(const char *fpath, const struct stat *sb,
 #ifdef USE_REFLINK
 static int is_reflink_compatible(dev_t devno, const char *filename)
 {
-	static dev_t last_dev = 0;
-	static int last_status = 0;
+	/* per-thread, called by compare_groups() workers */
+	THREAD_LOCAL dev_t last_dev = 0;
+	THREAD_LOCAL int last_status = 0;
 
 	if (last_dev != devno) {
 		struct statfs vfs;
@@ -1048,6 +1164,120 @@ done:
 		close(bf);
 	return rc;
 }
+
+/* extents which don't describe data on the device, or where the physical
+ * address does not identify the data (for example, btrfs reports the start
+ * of the whole compressed extent for any range cloned from it) */
+#define HDL_EXTENT_BADFLAGS	(FIEMAP_EXTENT_UNKNOWN | \
+				 FIEMAP_EXTENT_DELALLOC | \
+				 FIEMAP_EXTENT_ENCODED | \
+				 FIEMAP_EXTENT_DATA_INLINE | \
+				 FIEMAP_EXTENT_DATA_TAIL | \
+				 FIEMAP_EXTENT_UNWRITTEN | \
+				 FIEMAP_EXTENT_NOT_ALIGNED)
+
+/**
+ * read_fiemap - Read all extents of the file
+ * @fs: The file
+ *
+ * Returns the map or NULL if not available (or the file has been modified
+ * in the meantime).
+ */
+static struct fiemap *read_fiemap(struct file *fs)
+{
+	struct fiemap hdr = { .fm_length = ~0ULL, .fm_flags = FIEMAP_FLAG_SYNC },
+		      *map = NULL;
+	int fd = open(fs->links->path, O_RDONLY);
+
+	if (fd < 0)
+		return NULL;
+
+	/* get number of extents */
+	if (ioctl(fd, FS_IOC_FIEMAP, (unsigned long) &hdr) < 0)
+		goto done;
+
+	map = xcalloc(1, sizeof(*map) +
+			hdr.fm_mapped_extents * sizeof(struct fiemap_extent));
+	map->fm_length = ~0ULL;
+	map->fm_extent_count = hdr.fm_mapped_extents;
+
+	if (map->fm_extent_count &&
+	    (ioctl(fd, FS_IOC_FIEMAP, (unsigned long) map) < 0 ||
+	     map->fm_mapped_extents != map->fm_extent_count ||
+	     !(map->fm_extents[map->fm_mapped_extents - 1].fe_flags & FIEMAP_EXTENT_LAST))) {
+		free(map);
+		map = NULL;
+	}
+done:
+	close(fd);
+	return map;
+}
+
+static struct fiemap *get_fiemap(struct file *fs)
+{
+	if (!fs->fiemap_done) {
+		fs->fiemap = read_fiemap(fs);
+		fs->fiemap_done = 1;
+	}
+	return fs->fiemap;
+}
+
+/**
+ * compare_extents - Compare the files by extents maps
+ * @master: The first file
+ * @other: The second file
+ *
+ * Returns 1 if the files share all extents or if both files are only holes,
+ * the content is equal in this case and it's unnecessary to read it. The
+ * files sharing all extents are also marked for visitor() (see
+ * --skip-reflinks). Returns 0 if it's necessary to compare the content.
+ */
+static int compare_extents(struct file *master, struct file *other)
+{
+	struct fiemap *a = get_fiemap(master), *b = get_fiemap(other);
+	size_t i;
+
+	if (!a || !b)
+		return 0;
+
+	other->extmaster = master;
+	other->is_shared = 0;
+
+	if (a->fm_mapped_extents != b->fm_mapped_extents)
+		return 0;
+
+	for (i = 0; i < a->fm_mapped_extents; i++) {
+		struct fiemap_extent *ea = &a->fm_extents[i];
+		struct fiemap_extent *eb = &b->fm_extents[i];
+
+		if (ea->fe_logical != eb->fe_logical ||
+		    ea->fe_length != eb->fe_length ||
+		    ea->fe_physical != eb->fe_physical ||
+		    ea->fe_flags != eb->fe_flags ||
+		    (ea->fe_flags & HDL_EXTENT_BADFLAGS) ||
+		    !(ea->fe_flags & FIEMAP_EXTENT_SHARED))
+			return 0;
+	}
+
+	/* there is nothing to share if there are no extents */
+	other->is_shared = a->fm_mapped_extents > 0;
+	return 1;
+}
+
+/**
+ * is_shared - Check whether the files already share extents
+ * @master: The first file
+ * @other: The second file
+ *
+ * Use the result from compare_extents() if available.
+ */
+static int is_shared(struct file *master, struct file *other)
+{
+	if (other->extmaster == master)
+		return other->is_shared;
+	return is_reflink(master, other);
+}
+
 #endif /* USE_REFLINK */
 
 static inline size_t count_nodes(struct file *x)
@@ -1068,7 +1298,8 @@ static inline size_t count_nodes(struct file *x)
  *
  * Visit the nodes in the binary tree. For each node, call hardlinker()
  * on each #struct file in the linked list of #struct file instances located
- * at that node.
+ * at that node. The content of the files is already compared by
+ * compare_groups().
  */
 static void visitor(const void *nodep, const VISIT which, const int depth)
 {
@@ -1082,23 +1313,12 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 		return;
 
 	for (; master != NULL; master = master->next) {
-		size_t nnodes, memsiz;
 		int may_reflink = 0;
 
 		handle_interrupt();
 		if (master->links == NULL)
 			continue;
 
-		/* calculate per file max memory use */
-		nnodes = count_nodes(master);
-		if (!nnodes)
-			continue;
-
-		/* per-file cache size */
-		memsiz = opts.cache_size / nnodes;
-		/*                                filesiz,      readsiz,      memsiz */
-		ul_fileeq_set_size(&fileeq, master->st.st_size, opts.io_size, memsiz);
-
 #ifdef USE_REFLINK
 		if (reflink_mode || reflinks_skip) {
 			may_reflink =
@@ -1125,24 +1345,15 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 				continue;
 			}
 #ifdef USE_REFLINK
-			if (may_reflink && reflinks_skip && is_reflink(master, other)) {
+			if (may_reflink && reflinks_skip && is_shared(master, other)) {
 				jlog(VERBOSE2,
 				     printf(_("Skipped (already reflink) %s"), other->links->path));
 				stats.ignored_reflinks++;
 				continue;
 			}
 #endif
-			/* initialize content comparison */
-			if (!ul_fileeq_data_associated(&master->data))
-				ul_fileeq_data_set_file(&master->data, master->links->path);
-			if (!ul_fileeq_data_associated(&other->data))
-				ul_fileeq_data_set_file(&other->data, other->links->path);
-
 			/* compare files */
-			eq = ul_fileeq(&fileeq, &master->data, &other->data);
-
-			/* reduce number of open files, keep only master open */
-			ul_fileeq_data_close_file(&other->data);
+			eq = master->eqmaster && master->eqmaster == other->eqmaster;
 
 			stats.comparisons++;
 
@@ -1153,14 +1364,9 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 			}
 
 			/* link files */
-			if (!file_link(master, other, may_reflink) && errno == EMLINK) {
-				ul_fileeq_data_deinit(&master->data);
+			if (!file_link(master, other, may_reflink) && errno == EMLINK)
 				master = other;
-			}
 		}
-
-		/* don't keep master data in memory */
-		ul_fileeq_data_deinit(&master->data);
 	}
 
 	/* final cleanup */
@@ -1168,10 +1374,560 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 		if (opts.list_duplicates && other->st.st_nlink > 1)
 			for (struct link *l = other->links; l; l = l->next)
 				printf("%016zu\t%s%c", (size_t)other, l->path, opts.line_delim);
+	}
+}
+
+/**
+ * struct hdl_digest - Cached digests of the file content
+ * @dev:      The device of the file
+ * @ino:      The inode of the file
+ * @size:     The size of the file
+ * @mtime:    The modification time of the file (in nanoseconds)
+ * @ctime:    The status change time of the file (in nanoseconds)
+ * @readsiz:  The size of the block hashed to one digest
+ * @is_eof:   Whether the digests cover the whole file
+ * @ndigests: The number of the digests
+ * @intro:    The first bytes of the file
+ * @digests:  The digests of the blocks
+ *
+ * The digests are valid only as long as the file is not modified, this is
+ * checked by the size and the timestamps. Note that ctime cannot be set by
+ * userspace, so it's updated on any modification.
+ */
+struct hdl_digest {
+	dev_t dev;
+	ino_t ino;
+	uintmax_t size;
+	uint64_t mtime;
+	uint64_t ctime;
+	size_t readsiz;
+	bool is_eof;
+	size_t ndigests;
+	unsigned char intro[UL_FILEEQ_INTROSIZ];
+	unsigned char digests[];
+};
+
+#define HDL_DIGEST_CACHE_MAGIC	"# hardlink digest cache v1"
+
+/*
+ * The digests read from --digest-cache file, indexed by dev and ino. The tree
+ * is read-only when compare_groups() threads are running.
+ */
+static void *digest_cache;
+static size_t digest_cache_siz;		/* size of one digest */
+static time_t digest_cache_cutoff;	/* don't save digests of the files changed later */
+static FILE *digest_cache_out;
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts)
+{
+	return (uint64_t) ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int compare_digests(const void *_a, const void *_b)
+{
+	const struct hdl_digest *a = _a;
+	const struct hdl_digest *b = _b;
+	int diff = CMP(a->dev, b->dev);
+
+	if (diff == 0)
+		diff = CMP(a->ino, b->ino);
+	return diff;
+}
+
+static int digest_is_valid(const struct hdl_digest *d, const struct stat *st)
+{
+	return d->size == (uintmax_t) st->st_size
+	       && d->mtime == timespec_to_ns(&st->st_mtim)
+	       && d->ctime == timespec_to_ns(&st->st_ctim);
+}
+
+static int hex_to_bytes(const char *str, size_t len, unsigned char *buf)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++, str += 2) {
+		unsigned int x;
+
+		if (!isxdigit((unsigned char) str[0])
+		    || !isxdigit((unsigned char) str[1])
+		    || sscanf(str, "%2x", &x) != 1)
+			return -EINVAL;
+		buf[i] = x;
+	}
+	return 0;
+}
+
+static void fputs_hex(const unsigned char *buf, size_t len, FILE *f)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		fprintf(f, "%02x", buf[i]);
+}
+
+/*
+ * Parses one line of the cache file:
+ *
+ *   <dev> <ino> <size> <mtime> <ctime> <readsiz> <eof> <intro> <digests>
+ *
+ * the intro and the digests are in hex, the digests are "-" if none.
+ */
+static struct hdl_digest *parse_digest(const char *line)
+{
+	struct hdl_digest *d;
+	uintmax_t dev, ino, size;
+	uint64_t mtime, ctime;
+	size_t readsiz, len, ndigests = 0;
+	const char *intro, *digs;
+	int eof, n = 0;
+
+	if (sscanf(line, "%ju %ju %ju %" SCNu64 " %" SCNu64 " %zu %d %n",
+		   &dev, &ino, &size, &mtime, &ctime, &readsiz, &eof, &n) != 7 || !n)
+		return NULL;
+
+	intro = line + n;
+	len = strcspn(intro, " ");
+	if (len != UL_FILEEQ_INTROSIZ * 2 || intro[len] != ' ')
+		return NULL;
+
+	digs = intro + len + 1;
+	len = strcspn(digs, " \n");
+	if (len == 1 && *digs == '-')
+		len = 0;
+	else if (len % (digest_cache_siz * 2))
+		return NULL;
+	else
+		ndigests = len / (digest_cache_siz * 2);
+
+	d = xmalloc(sizeof(*d) + ndigests * digest_cache_siz);
+	d->dev = dev;
+	d->ino = ino;
+	d->size = size;
+	d->mtime = mtime;
+	d->ctime = ctime;
+	d->readsiz = readsiz;
+	d->is_eof = eof ? 1 : 0;
+	d->ndigests = ndigests;
+
+	if (hex_to_bytes(intro, UL_FILEEQ_INTROSIZ, d->intro) != 0
+	    || hex_to_bytes(digs, ndigests * digest_cache_siz, d->digests) != 0) {
+		free(d);
+		return NULL;
+	}
+	return d;
+}
+
+/**
+ * digest_cache_load - Read --digest-cache file
+ *
+ * The file is optional, it's silently ignored if it does not exist or if it
+ * has been created for another comparison method.
+ */
+static void digest_cache_load(void)
+{
+	struct timespec now;
+	char *line = NULL, *magic = NULL;
+	size_t sz = 0, ct = 0;
+	FILE *f;
+
+	digest_cache_siz = ul_fileeq_get_digest_size(&fileeq);
+	if (!digest_cache_siz) {
+		jlog(INFO, printf(_("digest cache is not supported by '%s' method"),
+					opts.method));
+		opts.digest_cache = NULL;
+		return;
+	}
+
+	/* The timestamps may have coarse granularity, so a file modified
+	 * after stat() may have the same ctime. Don't save digests of the
+	 * files changed shortly before the scan. */
+	clock_gettime(CLOCK_REALTIME, &now);
+	digest_cache_cutoff = now.tv_sec - 2;
 
-		if (ul_fileeq_data_associated(&other->data))
+	f = fopen(opts.digest_cache, "r" UL_CLOEXECSTR);
+	if (!f) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), opts.digest_cache);
+		return;
+	}
+
+	xasprintf(&magic, "%s %s\n", HDL_DIGEST_CACHE_MAGIC, opts.method);
+
+	if (getline(&line, &sz, f) < 0 || strcmp(line, magic) != 0) {
+		jlog(INFO, printf(_("ignore digest cache %s (unsupported format or method)"),
+					opts.digest_cache));
+		goto done;
+	}
+
+	while (getline(&line, &sz, f) >= 0) {
+		struct hdl_digest *d = parse_digest(line), **x;
+
+		if (!d) {
+			warnx(_("%s: parse error, ignore the rest of the cache"),
+					opts.digest_cache);
+			break;
+		}
+		x = tsearch(d, &digest_cache, compare_digests);
+		if (!x)
+			err(EXIT_FAILURE, _("failed to allocate memory"));
+		if (*x != d)
+			free(d);	/* duplicate */
+		else
+			ct++;
+	}
+	jlog(INFO, printf(_("Loaded %zu digests from %s"), ct, opts.digest_cache));
+done:
+	free(magic);
+	free(line);
+	fclose(f);
+}
+
+/**
+ * digest_cache_fetch - Use cached digests for the file
+ * @eq: The files comparer
+ * @fs: The file with already associated data
+ */
+static void digest_cache_fetch(struct ul_fileeq *eq, struct file *fs)
+{
+	struct hdl_digest key = { .dev = fs->st.st_dev, .ino = fs->st.st_ino };
+	struct hdl_digest **x, *d;
+
+	if (!digest_cache)
+		return;
+
+	x = tfind(&key, &digest_cache, compare_digests);
+	if (!x)
+		return;
+
+	d = *x;
+	if (digest_is_valid(d, &fs->st))
+		ul_fileeq_data_set_digests(eq, &fs->data, d->intro, d->digests,
+				d->ndigests, d->readsiz, d->is_eof);
+}
+
+/**
+ * digest_cache_update - Remember digests of the file for the digest cache
+ * @eq: The files comparer
+ * @fs: The file with associated data
+ *
+ * This has to be called before the data are deinitialized.
+ */
+static void digest_cache_update(struct ul_fileeq *eq, struct file *fs)
+{
+	const unsigned char *intro, *digests;
+	struct hdl_digest *d;
+	size_t readsiz;
+	ssize_t ndigests;
+	bool is_eof;
+
+	if (!opts.digest_cache || fs->st.st_ctim.tv_sec >= digest_cache_cutoff)
+		return;
+
+	ndigests = ul_fileeq_data_get_digests(eq, &fs->data, &intro, &digests,
+					&readsiz, &is_eof);
+	if (ndigests < 0)
+		return;
+
+	d = xmalloc(sizeof(*d) + ndigests * digest_cache_siz);
+	d->dev = fs->st.st_dev;
+	d->ino = fs->st.st_ino;
+	d->size = fs->st.st_size;
+	d->mtime = timespec_to_ns(&fs->st.st_mtim);
+	d->ctime = timespec_to_ns(&fs->st.st_ctim);
+	d->readsiz = readsiz;
+	d->is_eof = is_eof;
+	d->ndigests = ndigests;
+	memcpy(d->intro, intro, sizeof(d->intro));
+	if (ndigests)
+		memcpy(d->digests, digests, ndigests * digest_cache_siz);
+
+	free(fs->digest);
+	fs->digest = d;
+}
+
+static void digest_cache_writer(const void *nodep, const VISIT which, const int depth)
+{
+	struct file *fs = *(struct file **)nodep;
+
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	for (; fs != NULL; fs = fs->next) {
+		struct hdl_digest *d = fs->digest;
+
+		/* unchanged files not compared in this run */
+		if (!d && digest_cache) {
+			struct hdl_digest key = { .dev = fs->st.st_dev, .ino = fs->st.st_ino };
+			struct hdl_digest **x = tfind(&key, &digest_cache, compare_digests);
+
+			if (x && digest_is_valid(*x, &fs->st))
+				d = *x;
+		}
+		if (!d)
+			continue;
+
+		fprintf(digest_cache_out, "%ju %ju %ju %" PRIu64 " %" PRIu64 " %zu %d ",
+				(uintmax_t) d->dev, (uintmax_t) d->ino, d->size,
+				d->mtime, d->ctime, d->readsiz, d->is_eof ? 1 : 0);
+		fputs_hex(d->intro, sizeof(d->intro), digest_cache_out);
+		fputc(' ', digest_cache_out);
+		if (d->ndigests)
+			fputs_hex(d->digests, d->ndigests * digest_cache_siz, digest_cache_out);
+		else
+			fputc('-', digest_cache_out);
+		fputc('\n', digest_cache_out);
+	}
+}
+
+/**
+ * digest_cache_save - Write --digest-cache file
+ *
+ * The new file contains digests of all the scanned files, and it atomically
+ * replaces the old one.
+ */
+static void digest_cache_save(void)
+{
+	char *dir, *name, *tmpname = NULL;
+
+	dir = xstrdup(opts.digest_cache);
+	name = stripoff_last_component(dir);
+	if (!name)
+		name = dir;
+
+	digest_cache_out = xfmkstemp(&tmpname, name == dir ? "." : *dir ? dir : "/", name);
+	if (!digest_cache_out) {
+		warn(_("cannot create temporary file for %s"), opts.digest_cache);
+		goto done;
+	}
+
+	fprintf(digest_cache_out, "%s %s\n", HDL_DIGEST_CACHE_MAGIC, opts.method);
+	twalk(files, digest_cache_writer);
+
+	if (close_stream(digest_cache_out) != 0) {
+		warn(_("write failed: %s"), tmpname);
+		unlink(tmpname);
+	} else if (rename(tmpname, opts.digest_cache) != 0) {
+		warn(_("cannot rename %s to %s"), tmpname, opts.digest_cache);
+		unlink(tmpname);
+	}
+done:
+	digest_cache_out = NULL;
+	free(tmpname);
+	free(dir);
+}
+
+/* upper limit for compare_groups() threads */
+#define HDL_MAX_WORKERS	16
+
+/*
+ * Lists of files with the same size for compare_groups()
+ */
+static struct file_groups {
+	struct file **groups;
+	size_t ngroups;
+	size_t next;
+	size_t nworkers;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t mutex;
+#endif
+} file_groups = {
+#ifdef HAVE_LIBPTHREAD
+	.mutex = PTHREAD_MUTEX_INITIALIZER
+#endif
+};
+
+static void group_collector(const void *nodep, const VISIT which, const int depth)
+{
+	struct file *begin = *(struct file **)nodep;
+	struct file_groups *gr = &file_groups;
+	static size_t allocated;
+
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+	if (!begin->next)
+		return;		/* nothing to compare */
+
+	if (gr->ngroups == allocated) {
+		allocated = allocated ? allocated * 2 : 64;
+		gr->groups = xreallocarray(gr->groups, allocated, sizeof(*gr->groups));
+	}
+	gr->groups[gr->ngroups++] = begin;
+}
+
+/**
+ * compare_group - Compare content of files with the same size
+ * @eq: The files comparer
+ * @begin: The first file in the list
+ * @nworkers: Number of threads, used to split the cache size
+ *
+ * Compare the files in the same order as visitor() does, but don't link
+ * anything. The files with equal content get the same &struct file.eqmaster.
+ * The content comparison is transitive, and the attributes (without xattrs)
+ * are compared in the same way as visitor() does, so visitor() gets the
+ * same result from eqmaster as from calling ul_fileeq() for any pair of the
+ * files it's going to link.
+ */
+static void compare_group(struct ul_fileeq *eq, struct file *begin, size_t nworkers)
+{
+	struct file *master, *other;
+#ifdef USE_REFLINK
+	int use_extents = (reflink_mode || reflinks_skip) && begin->links &&
+			  (reflink_mode == REFLINK_ALWAYS ||
+			   is_reflink_compatible(begin->st.st_dev, begin->links->path));
+#endif
+
+	for (master = begin; master != NULL; master = master->next) {
+		size_t nnodes, memsiz;
+
+		if (master->links == NULL || master->eqmaster)
+			continue;
+
+		master->eqmaster = master;
+
+		/* calculate per file max memory use */
+		nnodes = count_nodes(master);
+
+		/* per-file cache size; the saved digests must not depend on
+		 * the number of the threads and of the files of the same size,
+		 * they are all kept in memory for the digest cache anyway */
+		if (opts.digest_cache)
+			memsiz = opts.cache_size;
+		else
+			memsiz = opts.cache_size / nworkers / nnodes;
+		/*                           filesiz,      readsiz,      memsiz */
+		ul_fileeq_set_size(eq, master->st.st_size, opts.io_size, memsiz);
+
+		for (other = master->next; other != NULL; other = other->next) {
+			if (!other->links || other->eqmaster)
+				continue;
+			if (!file_stat_may_link_to(master, other))
+				continue;
+#ifdef USE_REFLINK
+			/* already shared or holes only, don't read the content */
+			if (use_extents && compare_extents(master, other)) {
+				other->eqmaster = master;
+				continue;
+			}
+#endif
+
+			/* initialize content comparison */
+			if (!ul_fileeq_data_associated(&master->data)) {
+				ul_fileeq_data_set_file(&master->data, master->links->path);
+				digest_cache_fetch(eq, master);
+			}
+			if (!ul_fileeq_data_associated(&other->data)) {
+				ul_fileeq_data_set_file(&other->data, other->links->path);
+				digest_cache_fetch(eq, other);
+			}
+
+			/* compare files */
+			if (ul_fileeq(eq, &master->data, &other->data))
+				other->eqmaster = master;
+
+			/* reduce number of open files, keep only master open */
+			ul_fileeq_data_close_file(&other->data);
+		}
+
+		/* don't keep master data in memory (note that the data are
+		 * zeroized by calloc() if never used, so fd is 0) */
+		if (ul_fileeq_data_associated(&master->data)) {
+			digest_cache_update(eq, master);
+			ul_fileeq_data_deinit(&master->data);
+		}
+	}
+
+	for (other = begin; other != NULL; other = other->next) {
+		if (ul_fileeq_data_associated(&other->data)) {
+			digest_cache_update(eq, other);
 			ul_fileeq_data_deinit(&other->data);
+		}
+#ifdef USE_REFLINK
+		free(other->fiemap);
+		other->fiemap = NULL;
+#endif
+	}
+}
+
+static struct file *next_group(struct file_groups *gr)
+{
+	struct file *begin = NULL;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&gr->mutex);
+#endif
+	if (gr->next < gr->ngroups)
+		begin = gr->groups[gr->next++];
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&gr->mutex);
+#endif
+	return begin;
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *compare_worker(void *data)
+{
+	struct file_groups *gr = data;
+	struct ul_fileeq eq;
+	struct file *begin;
+
+	/* the method has been already successfully initialized in main() */
+	if (ul_fileeq_init(&eq, opts.method) != 0)
+		return NULL;
+
+	while ((begin = next_group(gr)))
+		compare_group(&eq, begin, gr->nworkers);
+
+	ul_fileeq_deinit(&eq);
+	return NULL;
+}
+#endif
+
+/**
+ * compare_groups - Compare content of the files
+ *
+ * The lists of files with the same size are independent, so they are
+ * compared by a pool of threads. The main thread works too. The linking is
+ * done later by visitor() in one thread.
+ */
+static void compare_groups(void)
+{
+	struct file_groups *gr = &file_groups;
+	struct file *begin;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t *threads = NULL;
+	size_t i, nthreads = 0;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	twalk(files, group_collector);
+	gr->nworkers = 1;
+
+#ifdef HAVE_LIBPTHREAD
+	if (ncpus > 1 && gr->ngroups > 1) {
+		nthreads = min(gr->ngroups, min((size_t) ncpus, (size_t) HDL_MAX_WORKERS)) - 1;
+		threads = xcalloc(nthreads, sizeof(*threads));
+		gr->nworkers += nthreads;
+	}
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, compare_worker, gr) != 0)
+			break;
+	}
+	nthreads = i;
+#endif
+	while ((begin = next_group(gr))) {
+		handle_interrupt();
+		compare_group(&fileeq, begin, gr->nworkers);
 	}
+#ifdef HAVE_LIBPTHREAD
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+#endif
+	free(gr->groups);
 }
 
 /**
@@ -1209,6 +1965,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --ignore-mode          ignore changes of file mode\n"), out);
 	fputs(_(" -q, --quiet                quiet mode - don't print anything\n"), out);
 	fputs(_(" -r, --cache-size <size>    memory limit for cached file content data\n"), out);
+	fputs(_("     --digest-cache <file>  file to keep content digests between runs\n"), out);
 #ifdef USE_REFLINK
 	fputs(_("     --reflink[=<when>]     create clone/CoW copies (auto, always, never)\n"), out);
 	fputs(_("     --skip-reflinks        skip already cloned files (enabled on --reflink)\n"), out);
@@ -1218,9 +1975,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -t, --ignore-time          ignore timestamps (when testing for equality)\n"), out);
 	fputs(_(" -v, --verbose              verbose output (repeat for more verbosity)\n"), out);
 	fputs(_(" -x, --exclude <regex>      regular expression to exclude files\n"), out);
-#ifdef USE_SKIP_SUBTREE
 	fputs(_("     --exclude-subtree <regex>  regular expression to exclude directories\n"), out);
-#endif
 #ifdef USE_XATTR
 	fputs(_(" -X, --respect-xattrs       respect extended attributes\n"), out);
 #endif
@@ -1245,7 +2000,8 @@ static int parse_options(int argc, char *argv[])
 		OPT_REFLINK = CHAR_MAX + 1,
 		OPT_SKIP_RELINKS,
 		OPT_EXCLUDE_SUBTREE,
-		OPT_MOUNT
+		OPT_MOUNT,
+		OPT_DIGEST_CACHE
 	};
 	static const char optstr[] = "VhvndfpotXcmMFOlzx:y:i:r:S:s:b:q";
 	static const struct option long_options[] = {
@@ -1265,9 +2021,7 @@ static int parse_options(int argc, char *argv[])
 		{"keep-oldest", no_argument, NULL, 'O'},
 		{"exclude", required_argument, NULL, 'x'},
 		{"include", required_argument, NULL, 'i'},
-#ifdef USE_SKIP_SUBTREE
 		{"exclude-subtree", required_argument, NULL, OPT_EXCLUDE_SUBTREE},
-#endif
 		{"mount", no_argument, NULL, OPT_MOUNT},
 		{"method", required_argument, NULL, 'y' },
 		{"minimum-size", required_argument, NULL, 's'},
@@ -1280,6 +2034,7 @@ static int parse_options(int argc, char *argv[])
 		{"content", no_argument, NULL, 'c'},
 		{"quiet", no_argument, NULL, 'q'},
 		{"cache-size", required_argument, NULL, 'r'},
+		{"digest-cache", required_argument, NULL, OPT_DIGEST_CACHE},
 		{"list-duplicates", no_argument, NULL, 'l'},
 		{"zero", no_argument, NULL, 'z'},
 		{NULL, 0, NULL, 0}
@@ -1341,11 +2096,9 @@ static int parse_options(int argc, char *argv[])
 		case 'x':
 			register_regex(&opts.exclude, optarg);
 			break;
-#ifdef USE_SKIP_SUBTREE
 		case OPT_EXCLUDE_SUBTREE:
 			register_regex(&opts.exclude_subtree, optarg);
 			break;
-#endif
 		case 'y':
 			opts.method = optarg;
 			break;
@@ -1395,6 +2148,9 @@ static int parse_options(int argc, char *argv[])
 		case OPT_MOUNT:
 			opts.within_mount = 1;
 			break;
+		case OPT_DIGEST_CACHE:
+			opts.digest_cache = optarg;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1406,9 +2162,7 @@ static int parse_options(int argc, char *argv[])
 #ifdef USE_FILEEQ_CRYPTOAPI
 				"cryptoapi",
 #endif
-#ifdef USE_SKIP_SUBTREE
 				"ftw_skip_subtree",
-#endif
 				NULL
 			};
 			print_version_with_features(EXIT_SUCCESS, features);
@@ -1451,7 +2205,7 @@ int main(int argc, char *argv[])
 {
 	struct sigaction sa;
 	int rc;
-	int ftw_flags;
+	int walk_flags;
 
 	sa.sa_handler = sighandler;
 	sa.sa_flags = SA_RESTART;
@@ -1493,17 +2247,16 @@ int main(int argc, char *argv[])
 			opts.io_size = 1024*1024;
 	}
 
+	if (opts.digest_cache)
+		digest_cache_load();
+
 	stats.started = TRUE;
 
-	ftw_flags = FTW_PHYS;
+	walk_flags = UL_DIRWALK_REGONLY;
 
 	if (opts.within_mount)
-		ftw_flags |= FTW_MOUNT;
+		walk_flags |= UL_DIRWALK_MOUNT;
 
-#ifdef USE_SKIP_SUBTREE
-	if (opts.exclude_subtree)
-		ftw_flags |= FTW_ACTIONRETVAL;
-#endif
 	jlog(VERBOSE2, printf(_("Scanning [device/inode/links]:")));
 	for (; optind < argc; optind++) {
 		char *path = realpath(argv[optind], NULL);
@@ -1517,13 +2270,21 @@ int main(int argc, char *argv[])
 		if (opts.prio_trees)
 			++curr_tree;
 
-		if (nftw(path, inserter, 20, ftw_flags) == -1)
+		/* all the fields used by file_may_link_to() and the digest cache */
+		if (ul_dirwalk(path, walk_flags,
+			       STATX_TYPE | STATX_MODE | STATX_NLINK |
+			       STATX_UID | STATX_GID | STATX_INO |
+			       STATX_SIZE | STATX_MTIME | STATX_CTIME,
+			       0, inserter, NULL) != 0)
 			warn(_("cannot process %s"), path);
 
 		free(path);
 		rootbasesz = 0;
 	}
 
+	compare_groups();
+	if (opts.digest_cache)
+		digest_cache_save();
 	twalk(files, visitor);
 
 	ul_fileeq_deinit(&fileeq);
@@ -587,6 +587,7 @@ static int check_signal_handler(const struct kill_control *ctl)
 int main(int argc, char **argv)
 {
 	struct kill_control ctl = { .numsig = SIGTERM };
+	struct procfs_snapshot *procs = NULL;
 	int nerrs = 0, ct = 0;
 
 	setlocale(LC_ALL, "");
@@ -613,22 +614,22 @@ int main(int argc, char **argv)
 			ct++;
 		} else {
 			int found = 0;
-			struct dirent *d;
-			DIR *dir = opendir(_PATH_PROC);
 			uid_t uid = !ctl.check_all ? getuid() : 0;
+			size_t i;
 
-			if (!dir)
+			/* read /proc only once for all the names */
+			if (!procs)
+				procs = ul_new_procfs_snapshot(
+						PROCFS_SNAP_UID | PROCFS_SNAP_COMM, 0);
+			if (!procs)
 				continue;
 
-			while ((d = xreaddir(dir))) {
-				if (!ctl.check_all &&
-				    !procfs_dirent_match_uid(dir, d, uid))
+			for (i = 0; i < procs->nprocs; i++) {
+				if (!ctl.check_all && procs->uids[i] != uid)
 					continue;
-				if (ctl.arg &&
-				    !procfs_dirent_match_name(dir, d, ctl.arg))
-					continue;
-				if (procfs_dirent_get_pid(d, &ctl.pid) != 0)
+				if (ctl.arg && strcmp(procs->comms[i], ctl.arg) != 0)
 					continue;
+				ctl.pid = procs->pids[i];
 				if (check_signal_handler(&ctl) <= 0)
 					continue;
 
@@ -638,13 +639,13 @@ int main(int argc, char **argv)
 				found = 1;
 			}
 
-			closedir(dir);
 			if (!found) {
 				nerrs++, ct++;
 				warnx(_("cannot find process \"%s\""), ctl.arg);
 			}
 		}
 	}
+	ul_free_procfs_snapshot(procs);
 
 #ifdef USE_KILL_WITH_TIMEOUT
 	while (!list_empty(&ctl.follow_ups)) {
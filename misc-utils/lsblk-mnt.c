@@ -177,6 +177,16 @@ void lsblk_mnt_init(void)
 	mnt_init_debug(0);
 }
 
+/* Drops the cached mount and swap tables; the next lsblk_device_get_filesystems()
+ * call reads them again. Used by --watch after a mount table change.
+ */
+void lsblk_mnt_reset(void)
+{
+	mnt_unref_table(mtab);
+	mnt_unref_table(swaps);
+	mtab = swaps = NULL;
+}
+
 void lsblk_mnt_deinit(void)
 {
 	mnt_unref_table(mtab);
@@ -5,6 +5,10 @@
 # include <libudev.h>
 #endif
 
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+
 #include "c.h"
 #include "cctype.h"
 #include "xalloc.h"
@@ -16,7 +20,9 @@
 #include "lsblk.h"
 
 #ifdef HAVE_LIBUDEV
-static struct udev *udev;
+/* libudev context must not be shared between threads, see
+ * lsblk_prefetch_properties() */
+THREAD_LOCAL struct udev *udev;
 #endif
 
 void lsblk_device_free_properties(struct lsblk_devprop *p)
@@ -424,9 +430,98 @@ void lsblk_properties_deinit(void)
 {
 #ifdef HAVE_LIBUDEV
 	udev_unref(udev);
+	udev = NULL;
 #endif
 }
 
+#if defined(HAVE_LIBPTHREAD) && defined(HAVE_TLS)
+#define LSBLK_PREFETCH_WORKERS	16
+
+struct prefetch {
+	struct lsblk_device **devs;
+	size_t ndevs;
+	size_t next;
+	pthread_mutex_t mutex;
+};
+
+static void prefetch_devices(struct prefetch *pf)
+{
+	for (;;) {
+		struct lsblk_device *dev = NULL;
+
+		pthread_mutex_lock(&pf->mutex);
+		if (pf->next < pf->ndevs)
+			dev = pf->devs[pf->next++];
+		pthread_mutex_unlock(&pf->mutex);
+
+		if (!dev)
+			break;
+		lsblk_device_get_properties(dev);
+	}
+}
+
+static void *prefetch_worker(void *data)
+{
+	prefetch_devices(data);
+	lsblk_properties_deinit();	/* per-thread udev context */
+	return NULL;
+}
+
+/*
+ * Read properties (udev db, blkid probing, ...) of all devices in the tree by
+ * a pool of threads. The properties are cached in the devices, so the later
+ * lsblk_device_get_properties() calls from the main thread are cheap. Most of
+ * the time is spent in waiting for I/O, so the number of threads does not
+ * depend on the number of CPUs.
+ */
+void lsblk_prefetch_properties(struct lsblk_devtree *tr)
+{
+	struct prefetch pf = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+	struct lsblk_device *dev;
+	struct lsblk_iter itr;
+	pthread_t *threads;
+	size_t i, nthreads, allocated = 0;
+
+	if (lsblk->properties_by[0] == LSBLK_METHOD_NONE)
+		return;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0) {
+		if (pf.ndevs == allocated) {
+			allocated = allocated ? allocated * 2 : 64;
+			pf.devs = xreallocarray(pf.devs, allocated, sizeof(*pf.devs));
+		}
+		pf.devs[pf.ndevs++] = dev;
+	}
+
+	nthreads = min(pf.ndevs, (size_t) LSBLK_PREFETCH_WORKERS);
+	DBG(TREE, ul_debugobj(tr, "prefetching properties of %zu devices by %zu threads",
+				pf.ndevs, nthreads));
+	if (nthreads < 2)
+		goto done;
+
+	threads = xcalloc(nthreads - 1, sizeof(*threads));
+	for (i = 0; i < nthreads - 1; i++) {
+		if (pthread_create(&threads[i], NULL, prefetch_worker, &pf) != 0)
+			break;
+	}
+	nthreads = i;
+
+	/* the main thread works too */
+	prefetch_devices(&pf);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+done:
+	free(pf.devs);
+}
+#else
+void lsblk_prefetch_properties(struct lsblk_devtree *tr __attribute__((__unused__)))
+{
+}
+#endif /* HAVE_LIBPTHREAD && HAVE_TLS */
+
 
 
 /*
@@ -29,6 +29,9 @@
 #include <fcntl.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <linux/netlink.h>
 #include <stdarg.h>
 #include <locale.h>
 #include <pwd.h>
@@ -54,6 +57,7 @@
 #include "buffer.h"
 #include "colors.h"
 #include "column-list-table.h"
+#include "strv.h"
 
 #include "lsblk.h"
 
@@ -1428,6 +1432,43 @@ static void device_to_scols(
 	ul_path_close_dirfd(dev->sysfs);
 }
 
+/* Returns true if any column (including hidden ones for filters, sorting, ...)
+ * is always filled from device properties, see device_get_data(). */
+static bool has_properties_column(void)
+{
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++) {
+		switch (get_column_id(i)) {
+		case COL_FSTYPE:
+		case COL_FSVERSION:
+		case COL_LABEL:
+		case COL_UUID:
+		case COL_PTUUID:
+		case COL_PTTYPE:
+		case COL_PARTTYPE:
+		case COL_PARTTYPENAME:
+		case COL_PARTLABEL:
+		case COL_PARTUUID:
+		case COL_PARTFLAGS:
+		case COL_PARTN:
+		case COL_WWN:
+		case COL_IDLINK:
+		case COL_ID:
+			return true;
+		case COL_OWNER:
+		case COL_GROUP:
+		case COL_MODE:
+			if (lsblk->sysroot)
+				return true;
+			break;
+		default:
+			break;
+		}
+	}
+	return false;
+}
+
 /*
  * Walks on tree and adds one line for each device to the smartcols table
  */
@@ -2221,6 +2262,325 @@ static void print_counters(void)
 	scols_free_iter(itr);
 }
 
+/*
+ * Reads devices specified by @devnames (NULL terminated array) or all devices
+ * from sysfs into the devices tree. Returns exit status.
+ */
+static int process_devices(struct lsblk_devtree *tr, char **devnames)
+{
+	int cnt = 0, cnt_err = 0;
+
+	if (!devnames || !*devnames) {
+		int rc = lsblk->inverse ?
+			process_all_devices_inverse(tr) :
+			process_all_devices(tr);
+
+		return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	for (; *devnames; devnames++) {
+		if (process_one_device(tr, *devnames) != 0)
+			cnt_err++;
+		cnt++;
+	}
+	return	cnt == 0	? EXIT_FAILURE :	/* nothing */
+		cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
+		cnt_err		? LSBLK_EXIT_SOMEOK :	/* some ok */
+				  EXIT_SUCCESS;		/* all success */
+}
+
+static void print_devtree(struct lsblk_devtree *tr)
+{
+	if (has_properties_column())
+		lsblk_prefetch_properties(tr);
+
+	if (lsblk->dedup_id > -1) {
+		devtree_set_dedupkeys(tr, lsblk->dedup_id);
+		lsblk_devtree_deduplicate_devices(tr);
+	}
+
+	devtree_to_scols(tr, lsblk->table);
+
+	if (lsblk->sort_col)
+		scols_sort_table(lsblk->table, lsblk->sort_col);
+	if (lsblk->force_tree_order)
+		scols_sort_table_by_tree(lsblk->table);
+
+	scols_print_table(lsblk->table);
+
+	if (lsblk->ncts)
+		print_counters();
+}
+
+/*
+ * --watch
+ *
+ * The devices are monitored by kernel uevents (NETLINK_KOBJECT_UEVENT) and by
+ * libmount monitor for mount table changes. The devices tree is read from
+ * sysfs again after a change, but the expensive properties (udev, blkid) of
+ * the devices not mentioned by uevents are moved from the old tree.
+ */
+#define LSBLK_WATCH_SETTLE	100	/* ms to wait for more events in a burst */
+
+#define UEVENT_GROUP_KERNEL	1
+#define UEVENT_GROUP_UDEV	2	/* events re-sent by udevd after processing */
+
+/* header of the events sent by udevd, see systemd libudev-monitor.c */
+struct udev_monitor_header {
+	char prefix[8];			/* "libudev" */
+	unsigned int magic;
+	unsigned int header_size;
+	unsigned int properties_off;
+	unsigned int properties_len;
+};
+
+static int open_uevent_socket(void)
+{
+	struct sockaddr_nl sa = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = UEVENT_GROUP_KERNEL | UEVENT_GROUP_UDEV
+	};
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+		    NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+	if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) != 0) {
+		int rc = -errno;
+		close(fd);
+		return rc;
+	}
+	return fd;
+}
+
+/*
+ * Parses one uevent and adds name of the block device to @dirty.
+ */
+static void parse_uevent(char *buf, size_t sz, char ***dirty)
+{
+	const char *subsystem = NULL, *devname = NULL, *devpath = NULL;
+	size_t off = 0;
+
+	buf[sz] = '\0';	/* read_uevents() reserves space for it */
+
+	if (sz >= sizeof(struct udev_monitor_header)
+	    && strcmp(buf, "libudev") == 0) {
+		struct udev_monitor_header hdr;
+
+		memcpy(&hdr, buf, sizeof(hdr));
+		if (hdr.properties_off >= sz)
+			return;
+		off = hdr.properties_off;
+	} else if (!strchr(buf, '@'))
+		return;
+	else
+		off = strlen(buf) + 1;		/* skip "action@devpath" */
+
+	while (off < sz) {
+		const char *p = buf + off;
+
+		if (strncmp(p, "SUBSYSTEM=", 10) == 0)
+			subsystem = p + 10;
+		else if (strncmp(p, "DEVNAME=", 8) == 0)
+			devname = p + 8;
+		else if (strncmp(p, "DEVPATH=", 8) == 0)
+			devpath = p + 8;
+		off += strlen(p) + 1;
+	}
+
+	if (!subsystem || strcmp(subsystem, "block") != 0)
+		return;
+	if (devname) {
+		/* kernel uses "sda", udevd "/dev/sda" */
+		const char *x = strrchr(devname, '/');
+		devname = x ? x + 1 : devname;
+	} else if (devpath) {
+		const char *x = strrchr(devpath, '/');
+		devname = x ? x + 1 : devpath;
+	}
+	if (!devname || !*devname)
+		return;
+
+	{
+		char **s;
+
+		UL_STRV_FOREACH(s, *dirty) {
+			if (strcmp(*s, devname) == 0)
+				return;
+		}
+	}
+	DBG(DEV, ul_debug("watch: %s changed", devname));
+	ul_strv_extend(dirty, devname);
+}
+
+/* Returns number of read events */
+static int read_uevents(int fd, char ***dirty)
+{
+	char buf[8192];
+	int count = 0;
+
+	while (1) {
+		ssize_t sz = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			break;		/* EAGAIN or ENOBUFS */
+		}
+		if (sz == 0)
+			break;
+		parse_uevent(buf, sz, dirty);
+		count++;
+	}
+	return count;
+}
+
+static int is_dirty(struct lsblk_device *dev, char **dirty)
+{
+	char **s;
+
+	UL_STRV_FOREACH(s, dirty) {
+		if (strcmp(*s, dev->name) == 0)
+			return 1;
+		if (dev->wholedisk && strcmp(*s, dev->wholedisk->name) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Moves already gathered properties from @old tree to the same devices in the
+ * @tr tree, except devices where uevent has been reported.
+ */
+static void devtree_move_properties(struct lsblk_devtree *old,
+				    struct lsblk_devtree *tr, char **dirty)
+{
+	struct lsblk_iter itr;
+	struct lsblk_device *dev = NULL;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0) {
+		struct lsblk_device *x;
+
+		if (dev->properties || is_dirty(dev, dirty))
+			continue;
+		x = lsblk_devtree_get_device(old, dev->name);
+		if (!x || !x->properties
+		    || x->maj != dev->maj || x->min != dev->min)
+			continue;
+
+		dev->properties = x->properties;
+		dev->udev_requested = x->udev_requested;
+		dev->blkid_requested = x->blkid_requested;
+		dev->file_requested = x->file_requested;
+		x->properties = NULL;
+	}
+}
+
+/*
+ * Opens the uevent socket and the libmount monitor. It has to be done before
+ * the devices are read for the first time, the changes in the meantime would
+ * be lost otherwise.
+ */
+static int open_watch(int *ufd, struct libmnt_monitor **mn)
+{
+	*ufd = open_uevent_socket();
+	if (*ufd < 0) {
+		errno = -*ufd;
+		warn(_("cannot open uevent socket"));
+		return -1;
+	}
+
+	*mn = mnt_new_monitor();
+	if (!*mn || mnt_monitor_enable_kernel(*mn, 1) != 0
+	    || mnt_monitor_get_fd(*mn) < 0) {
+		warn(_("failed to initialize libmount monitor"));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Waits for changes and prints the devices again. The function returns on
+ * error only, including when none of the requested devices can be read
+ * anymore. Failures of some of the requested devices are reported by
+ * process_one_device() warnings only.
+ */
+static int watch_devices(struct lsblk_devtree **tree, char **devnames,
+			 int ufd, struct libmnt_monitor *mn)
+{
+	struct pollfd fds[2];
+	char **dirty = NULL;
+	int rc;
+
+	fds[0].fd = ufd;
+	fds[0].events = POLLIN;
+	fds[1].fd = mnt_monitor_get_fd(mn);
+	fds[1].events = POLLIN;
+
+	while (1) {
+		struct lsblk_devtree *tr;
+		int nevents = 0, timeout = -1;
+
+		/* wait for the first event, then collect the burst */
+		while (1) {
+			int n = poll(fds, ARRAY_SIZE(fds), timeout);
+
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				warn(_("poll() failed"));
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			if (n == 0)
+				break;	/* settled */
+
+			if (fds[0].revents & POLLIN)
+				nevents += read_uevents(ufd, &dirty);
+			if (fds[1].revents & POLLIN) {
+				while (mnt_monitor_next_change(mn, NULL, NULL) == 0)
+					nevents++;
+			}
+			if (nevents)
+				timeout = LSBLK_WATCH_SETTLE;
+		}
+
+		DBG(DEV, ul_debug("watch: %d event(s), refreshing", nevents));
+
+		tr = lsblk_new_devtree();
+		if (!tr)
+			err(EXIT_FAILURE, _("failed to allocate device tree"));
+
+		rc = process_devices(tr, devnames);
+		if (rc == EXIT_FAILURE || rc == LSBLK_EXIT_ALLFAILED) {
+			warnx(_("failed to read devices"));
+			lsblk_unref_devtree(tr);
+			goto done;
+		}
+		devtree_move_properties(*tree, tr, dirty);
+		lsblk_mnt_reset();
+
+		if (lsblk->rawdata)
+			unref_table_rawdata(lsblk->table);
+		scols_table_remove_lines(lsblk->table);
+		lsblk_unref_devtree(*tree);
+		*tree = tr;
+
+		fputc('\n', stdout);
+		print_devtree(tr);
+		fflush(stdout);
+
+		ul_strv_free(dirty);
+		dirty = NULL;
+	}
+done:
+	ul_strv_free(dirty);
+	return rc;
+}
+
 static void set_column_type(const struct colinfo *ci, struct libscols_column *cl, int fl)
 {
 	switch (ci->type) {
@@ -2351,6 +2711,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --sysroot <dir>  use specified directory as system root\n"), out);
 	fputs(_("     --properties-by <list>\n"
 		"                      methods used to gather data (default: file,udev,blkid)\n"), out);
+	fputs(_("     --watch          print the devices again after uevent or mount table change\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_(" -H, --list-columns   list the available columns\n"), out);
@@ -2407,7 +2768,8 @@ int main(int argc, char *argv[])
 				     LSBLK_METHOD_BLKID, LSBLK_METHOD_NONE }
 	};
 	struct lsblk_devtree *tr = NULL;
-	int c, status = EXIT_FAILURE, collist = 0;
+	struct libmnt_monitor *mn = NULL;
+	int c, status = EXIT_FAILURE, collist = 0, ufd = -1;
 	char *outarg = NULL;
 	size_t i;
 	unsigned int width = 0;
@@ -2419,7 +2781,8 @@ int main(int argc, char *argv[])
 		OPT_COUNTER,
 		OPT_HIGHLIGHT,
 		OPT_PROPERTIES_BY,
-		OPT_HYPERLINK
+		OPT_HYPERLINK,
+		OPT_WATCH
 	};
 
 	static const struct option longopts[] = {
@@ -2462,6 +2825,7 @@ int main(int argc, char *argv[])
 		{ "ct-filter",  required_argument, NULL, OPT_COUNTER_FILTER },
 		{ "ct",         required_argument, NULL, OPT_COUNTER },
 		{ "properties-by", required_argument, NULL, OPT_PROPERTIES_BY },
+		{ "watch",      no_argument,       NULL, OPT_WATCH },
 		{ "list-columns", no_argument,     NULL, 'H' },
 		{ NULL, 0, NULL, 0 },
 	};
@@ -2476,6 +2840,9 @@ int main(int argc, char *argv[])
 		{ 'O','o' },
 		{ 'O','t' },
 		{ 'P','T', 'l','r' },
+		{ OPT_SYSROOT, OPT_WATCH },
+		{ OPT_COUNTER_FILTER, OPT_WATCH },
+		{ OPT_COUNTER, OPT_WATCH },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -2684,6 +3051,9 @@ int main(int argc, char *argv[])
 			if (hyperlinkwanted(optarg))
 				lsblk->uri = xgethosturi(NULL);
 			break;
+		case OPT_WATCH:
+			lsblk->watch = 1;
+			break;
 		case 'H':
 			collist = 1;
 			break;
@@ -2827,47 +3197,29 @@ int main(int argc, char *argv[])
 	for (i = 0; i < lsblk->ncts; i++)
 		init_scols_filter(lsblk->table, lsblk->ct_filters[i]);
 
+	if (lsblk->watch && open_watch(&ufd, &mn) != 0) {
+		status = EXIT_FAILURE;
+		goto leave;
+	}
+
 	tr = lsblk_new_devtree();
 	if (!tr)
 		err(EXIT_FAILURE, _("failed to allocate device tree"));
 
-	if (optind == argc) {
-		int rc = lsblk->inverse ?
-			process_all_devices_inverse(tr) :
-			process_all_devices(tr);
+	status = process_devices(tr, optind < argc ? argv + optind : NULL);
+	print_devtree(tr);
 
-		status = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
-	} else {
-		int cnt = 0, cnt_err = 0;
-
-		while (optind < argc) {
-			if (process_one_device(tr, argv[optind++]) != 0)
-				cnt_err++;
-			cnt++;
-		}
-		status = cnt == 0	? EXIT_FAILURE :	/* nothing */
-			 cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
-			 cnt_err	? LSBLK_EXIT_SOMEOK :	/* some ok */
-					  EXIT_SUCCESS;		/* all success */
-	}
-
-	if (lsblk->dedup_id > -1) {
-		devtree_set_dedupkeys(tr, lsblk->dedup_id);
-		lsblk_devtree_deduplicate_devices(tr);
+	if (lsblk->watch
+	    && (status == EXIT_SUCCESS || status == LSBLK_EXIT_SOMEOK)) {
+		fflush(stdout);
+		status = watch_devices(&tr, optind < argc ? argv + optind : NULL,
+				       ufd, mn);
 	}
-
-	devtree_to_scols(tr, lsblk->table);
-
-	if (lsblk->sort_col)
-		scols_sort_table(lsblk->table, lsblk->sort_col);
-	if (lsblk->force_tree_order)
-		scols_sort_table_by_tree(lsblk->table);
-
-	scols_print_table(lsblk->table);
-
-	if (lsblk->ncts)
-		print_counters();
 leave:
+	if (ufd >= 0)
+		close(ufd);
+	mnt_unref_monitor(mn);
+
 	if (lsblk->rawdata)
 		unref_table_rawdata(lsblk->table);
 
@@ -79,6 +79,7 @@ struct lsblk {
 	bool dedup_hidden;	/* deduplication column not between output columns */
 	bool force_tree_order;	/* sort lines by parent->tree relation */
 	bool noempty;		/* hide empty devices */
+	bool watch;		/* monitor changes */
 };
 
 extern struct lsblk *lsblk;     /* global handler */
@@ -237,6 +238,7 @@ struct lsblk_iter {
 /* lsblk-mnt.c */
 extern void lsblk_mnt_init(void);
 extern void lsblk_mnt_deinit(void);
+extern void lsblk_mnt_reset(void);
 
 extern void lsblk_device_free_filesystems(struct lsblk_device *dev);
 extern const char *lsblk_device_get_mountpoint(struct lsblk_device *dev);
@@ -246,6 +248,7 @@ extern struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev,
 extern void lsblk_device_free_properties(struct lsblk_devprop *p);
 extern struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev);
 extern void lsblk_properties_deinit(void);
+extern void lsblk_prefetch_properties(struct lsblk_devtree *tr);
 
 extern const char *lsblk_parttype_code_to_string(const char *code, const char *pttype);
 
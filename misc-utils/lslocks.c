@@ -214,17 +214,135 @@ static char *get_fallback_filename(dev_t dev)
 }
 
 /*
- * Return the absolute path of a file from
- * a given inode number (and its size)
+ * Return the absolute path of a file opened as @fd by @pid (and its size)
+ * if the file still has the given inode number
  */
-static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+static char *get_fd_filename_sz(pid_t pid, int fd, ino_t inode, size_t *size)
 {
 	struct stat sb;
+	ssize_t len;
+	char path[PATH_MAX], sym[PATH_MAX];
+
+	snprintf(path, sizeof(path), "/proc/%d/fd/%d", pid, fd);
+	if (stat(path, &sb) != 0 || sb.st_ino != inode)
+		return NULL;
+
+	if ((len = readlink(path, sym, sizeof(sym) - 1)) < 1)
+		return NULL;
+	sym[len] = '\0';
+
+	*size = sb.st_size;
+	return xstrdup(sym);
+}
+
+/*
+ * (dev, inode) -> fd index of a process, built the first time a lock
+ * held by the process needs a file name.
+ */
+struct fd_inode {
+	ino_t inode;
+	dev_t dev;
+	int fd;
+};
+
+struct pid_fds {
+	pid_t pid;
+	size_t nfds;
+	struct fd_inode *fds;	/* sorted by inode */
+};
+
+static void *pid_fds_tree;
+
+static int pid_fds_compare(const void *a, const void *b)
+{
+	pid_t apid = ((struct pid_fds *)a)->pid;
+	pid_t bpid = ((struct pid_fds *)b)->pid;
+
+	return apid < bpid ? -1 : apid > bpid ? 1 : 0;
+}
+
+static int fd_inode_compare(const void *a, const void *b)
+{
+	const struct fd_inode *afd = a, *bfd = b;
+
+	if (afd->inode != bfd->inode)
+		return afd->inode < bfd->inode ? -1 : 1;
+	return afd->fd - bfd->fd;
+}
+
+static void rem_pid_fds(void *node)
+{
+	struct pid_fds *pf = node;
+
+	free(pf->fds);
+	free(pf);
+}
+
+static void index_pid_fds(struct pid_fds *pf)
+{
 	struct dirent *dp;
 	DIR *dirp;
-	int fd;
-	char path[PATH_MAX] = { 0 },
-	     sym[PATH_MAX] = { 0 }, *ret = NULL;
+	size_t allocated = 0;
+	char path[PATH_MAX];
+	int dfd;
+
+	snprintf(path, sizeof(path), "/proc/%d/fd/", pf->pid);
+	if (!(dirp = opendir(path)))
+		return;
+	if ((dfd = dirfd(dirp)) < 0)
+		goto out;
+
+	while ((dp = xreaddir(dirp))) {
+		struct stat sb;
+		int fd;
+
+		/* care only for numerical descriptors */
+		if (ul_strtos32(dp->d_name, &fd, 10) != 0 || fd < 0)
+			continue;
+		if (fstatat(dfd, dp->d_name, &sb, 0) != 0)
+			continue;
+
+		if (pf->nfds == allocated) {
+			allocated = allocated ? allocated * 2 : 64;
+			pf->fds = xreallocarray(pf->fds, allocated, sizeof(*pf->fds));
+		}
+		pf->fds[pf->nfds].inode = sb.st_ino;
+		pf->fds[pf->nfds].dev = sb.st_dev;
+		pf->fds[pf->nfds].fd = fd;
+		pf->nfds++;
+	}
+
+	qsort(pf->fds, pf->nfds, sizeof(*pf->fds), fd_inode_compare);
+out:
+	closedir(dirp);
+}
+
+static struct pid_fds *get_pid_fds(pid_t pid)
+{
+	struct pid_fds tmp = { .pid = pid }, *pf;
+	struct pid_fds **node = tfind(&tmp, &pid_fds_tree, pid_fds_compare);
+
+	if (node)
+		return *node;
+
+	pf = xcalloc(1, sizeof(*pf));
+	pf->pid = pid;
+	index_pid_fds(pf);
+
+	if (tsearch(pf, &pid_fds_tree, pid_fds_compare) == NULL)
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	return pf;
+}
+
+/*
+ * Return the absolute path of a file from
+ * a given inode number (and its size)
+ */
+static char *get_filename_sz(ino_t inode, dev_t dev, pid_t lock_pid, size_t *size)
+{
+	struct pid_fds *pf;
+	struct fd_inode *match = NULL;
+	size_t lo, hi;
 
 	*size = 0;
 
@@ -237,41 +355,33 @@ static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
 	 * iterate the *entire* filesystem searching
 	 * for the damn file.
 	 */
-	snprintf(path, sizeof(path), "/proc/%d/fd/", lock_pid);
-	if (!(dirp = opendir(path)))
-		return NULL;
-
-	if (strlen(path) >= (sizeof(path) - 2))
-		goto out;
-
-	if ((fd = dirfd(dirp)) < 0 )
-		goto out;
-
-	while ((dp = xreaddir(dirp))) {
-		ssize_t len;
-
-		errno = 0;
-
-		/* care only for numerical descriptors */
-		if (!strtol(dp->d_name, (char **) NULL, 10) || errno)
-			continue;
-
-		if (!fstatat(fd, dp->d_name, &sb, 0)
-		    && inode != sb.st_ino)
-			continue;
+	pf = get_pid_fds(lock_pid);
 
-		if ((len = readlinkat(fd, dp->d_name, sym, sizeof(sym) - 1)) < 1)
-			goto out;
+	/* the first entry for the inode */
+	for (lo = 0, hi = pf->nfds; lo < hi; ) {
+		size_t mid = lo + (hi - lo) / 2;
 
-		*size = sb.st_size;
-		sym[len] = '\0';
+		if (pf->fds[mid].inode < inode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-		ret = xstrdup(sym);
-		break;
+	/* /proc/locks reports the device of the superblock, which may
+	 * differ from st_dev (e.g. btrfs subvolumes); prefer an exact
+	 * match but accept the inode alone. */
+	for (; lo < pf->nfds && pf->fds[lo].inode == inode; lo++) {
+		if (!match)
+			match = &pf->fds[lo];
+		if (pf->fds[lo].dev == dev) {
+			match = &pf->fds[lo];
+			break;
+		}
 	}
-out:
-	closedir(dirp);
-	return ret;
+
+	if (!match)
+		return NULL;
+	return get_fd_filename_sz(lock_pid, match->fd, inode, size);
 }
 
 /*
@@ -292,6 +402,7 @@ static ino_t get_dev_inode(char *str, dev_t *dev)
 struct override_info {
 	pid_t pid;
 	const char *cmdname;
+	int fd;
 };
 
 static bool is_holder(struct lock *l, struct lock *m)
@@ -306,23 +417,33 @@ static bool is_holder(struct lock *l, struct lock *m)
 		strcmp(l->mode, m->mode) == 0);
 }
 
-static void patch_lock(struct lock *l, void *fallback)
+/* Find a lock taken from fdinfo, held by @pid (or by anyone if @pid is 0),
+ * that is the same as @l */
+static struct lock *find_holder(struct lock *l, void *fallback, pid_t pid)
 {
 	struct lock_tnode tmp = { .dev = l->dev, .inode = l->inode, };
 	struct lock_tnode **head = tfind(&tmp, fallback, lock_tnode_compare);
 	struct list_head *p;
 
 	if (!head)
-		return;
+		return NULL;
 
 	list_for_each(p, &(*head)->chain) {
 		struct lock *m = list_entry(p, struct lock, locks);
-		if (is_holder(l, m)) {
-			/* size and id can be ignored. */
-			l->pid = m->pid;
-			l->cmdname = xstrdup(m->cmdname);
-			break;
-		}
+		if (is_holder(l, m) && (!pid || m->pid == pid))
+			return m;
+	}
+	return NULL;
+}
+
+static void patch_lock(struct lock *l, void *fallback)
+{
+	struct lock *m = find_holder(l, fallback, 0);
+
+	if (m) {
+		/* size and id can be ignored. */
+		l->pid = m->pid;
+		l->cmdname = xstrdup(m->cmdname);
 	}
 }
 
@@ -335,7 +456,7 @@ static struct lock *get_lock(char *buf, struct override_info *oinfo, void *fallb
 {
 	int i;
 	char *tok = NULL;
-	size_t sz;
+	size_t sz = 0;
 	struct lock *l = xcalloc(1, sizeof(*l));
 	INIT_LIST_HEAD(&l->locks);
 	l->fd = -1;
@@ -421,7 +542,19 @@ static struct lock *get_lock(char *buf, struct override_info *oinfo, void *fallb
 		else
 			l->cmdname = xstrdup(_("(undefined)"));
 	}
-	l->path = get_filename_sz(l->inode, l->pid, &sz);
+
+	/* The fd is known for a lock taken from fdinfo, and also for a lock
+	 * in /proc/locks if it is found in fdinfo. Search the file among
+	 * the fds of the process only if neither works. */
+	if (oinfo && oinfo->fd >= 0)
+		l->path = get_fd_filename_sz(l->pid, oinfo->fd, l->inode, &sz);
+	else if (fallback && !l->blocked && l->pid > 0) {
+		struct lock *m = find_holder(l, fallback, l->pid);
+		if (m && m->fd >= 0)
+			l->path = get_fd_filename_sz(m->pid, m->fd, l->inode, &sz);
+	}
+	if (!l->path)
+		l->path = get_filename_sz(l->inode, l->dev, l->pid, &sz);
 
 	/* no permissions -- ignore */
 	if (!l->path && no_inaccessible) {
@@ -446,6 +579,7 @@ static int get_pid_lock(void *locks, void (*add_lock)(void *, struct lock *), FI
 	struct override_info oinfo = {
 		.pid = pid,
 		.cmdname = cmdname,
+		.fd = fd,
 	};
 
 	while (fgets(buf, sizeof(buf), fp)) {
@@ -969,6 +1103,7 @@ int main(int argc, char *argv[])
 		rc = show_locks(&proc_locks, target_pid, &pid_locks);
 
 	tdestroy(pid_locks, rem_tnode);
+	tdestroy(pid_fds_tree, rem_pid_fds);
 	rem_locks(&proc_locks);
 
 	mnt_unref_table(tab);
@@ -22,6 +22,13 @@
  * to overwrite the built-in default then use:
  *
  *	make uuidd uuidgen runstatedir=/var/run
+ *
+ * The test also works as a load generator, the latency of every UUID request
+ * is measured and the percentiles are reported at the end.
+ *
+ * With -s <socket> the test talks to the uuidd socket directly. It sends
+ * many bulk requests on each connection at once and reads the replies later,
+ * so uuidd has to keep the requests until the replies are sent.
  */
 #include <pthread.h>
 #include <stdio.h>
@@ -29,11 +36,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/shm.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
+#include <time.h>
 
 #include "uuid.h"
+#include "all-io.h"
 #include "c.h"
+#include "uuidd.h"
 #include "xalloc.h"
 #include "strutils.h"
 #include "nls.h"
@@ -44,6 +56,10 @@ static size_t nprocesses = 4;
 static size_t nthreads = 4;
 static size_t nobjects = 4096;
 static size_t loglev = 1;
+static size_t nrequests = 256;
+
+/* UUIDs per bulk request, the maximum of uuidd */
+#define PIPELINE_BULK	4096
 
 struct processentry {
 	pid_t		pid;
@@ -66,6 +82,7 @@ struct objectentry {
 	pthread_t	tid;
 	pid_t		pid;
 	size_t		idx;
+	uint32_t	latency;	/* in nanoseconds */
 };
 typedef struct objectentry object_t;
 
@@ -81,6 +98,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	printf("  -t <num>     number of nthreads (default:%zu)\n", nthreads);
 	printf("  -o <num>     number of nobjects (default:%zu)\n", nobjects);
 	printf("  -l <level>   log level (default:%zu)\n", loglev);
+	printf("  -s <path>    send pipelined requests to uuidd socket\n");
+	printf("  -r <num>     number of pipelined requests per connection (default:%zu)\n", nrequests);
 	printf("  -h           display help\n");
 
 	exit(EXIT_SUCCESS);
@@ -133,14 +152,24 @@ static int object_uuid_compare(const void *object1, const void *object2)
 	return uuid_compare(*uuid1, *uuid2);
 }
 
+static uint64_t get_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static void *create_uuids(thread_t *th)
 {
 	size_t i;
 
 	for (i = th->index; i < th->index + nobjects; i++) {
 		object_t *obj = &objects[i];
+		uint64_t start = get_nsec();
 
 		object_uuid_create(obj);
+		obj->latency = min(get_nsec() - start, (uint64_t) UINT32_MAX);
 		obj->tid = th->tid;
 		obj->pid = th->proc->pid;
 		obj->idx = th->index + i;
@@ -264,14 +293,142 @@ static void object_dump(size_t idx, object_t *obj)
 	fprintf(stderr, "}\n");
 }
 
+static int cmp_latency(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void report_latency(size_t nobjs, uint64_t elapsed)
+{
+	uint32_t *lat;
+	size_t i, n = 0;
+
+	lat = xcalloc(nobjs, sizeof(*lat));
+	for (i = 0; i < nobjs; i++) {
+		if (objects[i].tid)
+			lat[n++] = objects[i].latency;
+	}
+	if (n) {
+		qsort(lat, n, sizeof(*lat), cmp_latency);
+		printf("%zu UUIDs in %.3f s (%.0f UUIDs/s)\n", n,
+				elapsed / 1e9, n / (elapsed / 1e9));
+		printf("latency: p50 %u ns, p99 %u ns, p99.9 %u ns, max %u ns\n",
+				lat[n / 2],
+				lat[n * 99 / 100],
+				lat[n * 999 / 1000],
+				lat[n - 1]);
+	}
+	free(lat);
+}
+
+static int pipeline_connect(const char *socket_path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+		errx(EXIT_FAILURE, "socket path too long: %s", socket_path);
+	strcpy(addr.sun_path, socket_path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		err(EXIT_FAILURE, "socket failed");
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+		err(EXIT_FAILURE, "cannot connect to %s", socket_path);
+	return fd;
+}
+
+/*
+ * Write all the requests to all the connections, wait, and then read and
+ * check the replies. uuidd has to stop processing the requests when the
+ * replies are not read and continue when they are.
+ */
+static int pipeline_test(const char *socket_path, size_t nconns)
+{
+	const size_t reqsz = sizeof(uint8_t) + sizeof(int32_t);
+	const int32_t num = PIPELINE_BULK;
+	char *req, *reply;
+	size_t i, c, nfailed = 0;
+	int *fds;
+
+	req = xmalloc(nrequests * reqsz);
+	for (i = 0; i < nrequests; i++) {
+		req[i * reqsz] = UUIDD_OP_BULK_RANDOM_UUID;
+		memcpy(req + i * reqsz + 1, &num, sizeof(num));
+	}
+
+	fds = xcalloc(nconns, sizeof(*fds));
+	for (c = 0; c < nconns; c++) {
+		fds[c] = pipeline_connect(socket_path);
+		if (write_all(fds[c], req, nrequests * reqsz) != 0)
+			err(EXIT_FAILURE, "write failed");
+		shutdown(fds[c], SHUT_WR);
+	}
+
+	/* let uuidd fill the connection buffers */
+	xusleep(500000);
+
+	reply = xmalloc(sizeof(int32_t) + PIPELINE_BULK * sizeof(uuid_t));
+	for (c = 0; c < nconns; c++) {
+		size_t nreplies = 0;
+		int32_t len, n;
+
+		while (read_all(fds[c], (char *) &len, sizeof(len)) == sizeof(len)) {
+			if (len != (int32_t) (sizeof(n) + PIPELINE_BULK * sizeof(uuid_t))
+			    || read_all(fds[c], reply, len) != len) {
+				warnx("connection %zu: bad reply #%zu", c, nreplies);
+				nfailed++;
+				break;
+			}
+			memcpy(&n, reply, sizeof(n));
+			if (n != PIPELINE_BULK) {
+				warnx("connection %zu: reply #%zu has %d UUIDs", c, nreplies, n);
+				nfailed++;
+			}
+			for (i = 0; i < PIPELINE_BULK; i++) {
+				const unsigned char *uu = (unsigned char *) reply
+						+ sizeof(n) + i * sizeof(uuid_t);
+
+				if (uuid_type(uu) != UUID_TYPE_DCE_RANDOM) {
+					warnx("connection %zu: reply #%zu: bad UUID", c, nreplies);
+					nfailed++;
+					break;
+				}
+			}
+			nreplies++;
+		}
+		if (nreplies != nrequests) {
+			warnx("connection %zu: %zu replies for %zu requests",
+					c, nreplies, nrequests);
+			nfailed++;
+		}
+		close(fds[c]);
+	}
+
+	free(reply);
+	free(fds);
+	free(req);
+
+	if (!nfailed)
+		printf("test successful (%zu connections, %zu replies per connection)\n",
+				nconns, nrequests);
+	else
+		printf("test failed\n");
+	return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 #define MSG_TRY_HELP "Try '-h' for help."
 
 int main(int argc, char *argv[])
 {
 	size_t i, nfailed = 0, nignored = 0;
+	const char *socket_path = NULL;
+	uint64_t start;
 	int c;
 
-	while (((c = getopt(argc, argv, "p:t:o:l:h")) != -1)) {
+	while (((c = getopt(argc, argv, "p:t:o:l:s:r:h")) != -1)) {
 		switch (c) {
 		case 'p':
 			nprocesses = strtou32_or_err(optarg, "invalid nprocesses number argument");
@@ -285,6 +442,12 @@ int main(int argc, char *argv[])
 		case 'l':
 			loglev = strtou32_or_err(optarg, "invalid log level argument");
 			break;
+		case 's':
+			socket_path = optarg;
+			break;
+		case 'r':
+			nrequests = strtou32_or_err(optarg, "invalid nrequests number argument");
+			break;
 		case 'h':
 			usage();
 			break;
@@ -297,6 +460,10 @@ int main(int argc, char *argv[])
 	if (optind != argc)
 		errx(EXIT_FAILURE, "bad usage\n" MSG_TRY_HELP);
 
+	/* one connection for each thread of each process */
+	if (socket_path)
+		return pipeline_test(socket_path, nprocesses * nthreads);
+
 	if (loglev == 1)
 		fprintf(stderr, "requested: %zu processes, %zu threads, %zu objects per thread (%zu objects = %zu bytes)\n",
 				nprocesses, nthreads, nobjects,
@@ -306,7 +473,10 @@ int main(int argc, char *argv[])
 	allocate_segment(&shmem_id, (void **)&objects,
 			 nprocesses * nthreads * nobjects, sizeof(object_t));
 
+	start = get_nsec();
 	create_nprocesses();
+	if (loglev >= 1)
+		report_latency(nprocesses * nthreads * nobjects, get_nsec() - start);
 
 	if (loglev >= 3) {
 		for (i = 0; i < nprocesses * nthreads * nobjects; i++)
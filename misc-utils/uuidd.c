@@ -23,6 +23,9 @@
  * | reply length (4 bytes) | uuid reply (16 bytes) | number (4 bytes) time bulk |
  *   or
  * | reply length (4 bytes) | pid or maxop number string length in ascii (up to 7 bytes) |
+ *
+ * The client may send more requests over one connection, the replies are sent
+ * in the same order. The connection is closed after an invalid request.
  */
 
 #include <stdio.h>
@@ -40,7 +43,10 @@
 #include <string.h>
 #include <getopt.h>
 #include <sys/signalfd.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#ifdef HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
 
 #include "uuid.h"
 #include "uuidd.h"
@@ -51,6 +57,7 @@
 #include "optutils.h"
 #include "monotonic.h"
 #include "timer.h"
+#include "xalloc.h"
 
 #ifdef HAVE_LIBSYSTEMD
 # include <systemd/sd-daemon.h>
@@ -58,13 +65,28 @@
 
 #include "nls.h"
 
+#ifndef EPOLLEXCLUSIVE
+# define EPOLLEXCLUSIVE	0
+#endif
+
 /* Protocol segment lengths */
 typedef uint8_t	uuidd_prot_op_t;	/* client operation field */
 typedef int32_t	uuidd_prot_num_t;	/* number of requested uuids */
 
 enum {
+	/* maximal number of UUIDs in a random bulk reply */
+	UUIDD_PROT_MAX_BULK = 4096,
 	/* client - server buffer size */
-	UUIDD_PROT_BUFSZ = ((sizeof(uuidd_prot_num_t)) + (sizeof(uuid_t) * 63))
+	UUIDD_PROT_BUFSZ = ((sizeof(uuidd_prot_num_t)) + (sizeof(uuid_t) * UUIDD_PROT_MAX_BULK))
+};
+
+enum {
+	UUIDD_MAX_WORKERS = 16,			/* default max. number of threads */
+	UUIDD_MAX_EVENTS = 64,			/* events per epoll_wait() */
+	UUIDD_ACCEPT_BATCH = 16,		/* accept() calls per event */
+	UUIDD_ACCEPT_DELAY = 100,		/* ms without accept() if it failed */
+	UUIDD_MAX_CONNS = 1024,			/* max. number of connections */
+	UUIDD_MAX_PENDING = 4 * UUIDD_PROT_BUFSZ	/* don't read if more unsent data */
 };
 
 /* server loop control structure */
@@ -73,6 +95,10 @@ struct uuidd_cxt_t {
 	const char	*cleanup_socket;
 	uint32_t	timeout;
 	uint32_t	cont_clock_offset;
+	size_t		nworkers;
+	time_t		last_activity;	/* monotonic time of the last request */
+	size_t		nconns;		/* number of connections */
+	int		accept_warned;	/* accept() failure reported once */
 
 	unsigned int	debug: 1,
 			quiet: 1,
@@ -80,6 +106,56 @@ struct uuidd_cxt_t {
 			no_sock: 1;
 };
 
+/* file descriptor in epoll */
+enum {
+	UUIDD_FD_CLIENT = 0,
+	UUIDD_FD_LISTEN,
+	UUIDD_FD_SIGNAL
+};
+
+/* client connection */
+struct uuidd_conn {
+	int		fd;
+	int		kind;		/* UUIDD_FD_* */
+	uint32_t	events;		/* requested epoll events */
+
+	char		in[512];	/* unprocessed requests */
+	size_t		inlen;
+
+	char		*out;		/* unsent replies */
+	size_t		outsz;
+	size_t		outlen;
+	size_t		outpos;
+
+	unsigned int	eof : 1;	/* no more requests */
+};
+
+struct uuidd_worker {
+	struct uuidd_cxt_t	*cxt;
+	int			efd;	/* epoll */
+	int			sock;	/* listening socket */
+	int			sigfd;	/* signalfd, main thread only */
+	struct uuidd_conn	listen;	/* listening socket in epoll */
+	uint64_t		accept_resume;	/* when to accept again (ms), or 0 */
+#ifdef HAVE_LIBPTHREAD
+	pthread_t		thread;
+#endif
+	char			obuf[4 * UUIDD_PROT_BUFSZ];	/* replies */
+};
+
+/*
+ * The continuous clock in libuuid is not thread-safe, time-based UUIDs are
+ * generated by one thread at a time.
+ */
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t clock_lock = PTHREAD_MUTEX_INITIALIZER;
+# define lock_clock()	pthread_mutex_lock(&clock_lock)
+# define unlock_clock()	pthread_mutex_unlock(&clock_lock)
+#else
+# define lock_clock()
+# define unlock_clock()
+#endif
+
 struct uuidd_options_t {
 	const char	 *pidfile_path;
 	const char	 *socket_path;
@@ -110,6 +186,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -S, --socket-activation do not create listening socket\n"), out);
 	fputs(_(" -C, --cont-clock[=<number>[hd]]\n"
 		"                         activate continuous clock handling\n"), out);
+	fputs(_(" -w, --workers <num>     number of worker threads\n"), out);
 	fputs(_(" -d, --debug             run in debugging mode\n"), out);
 	fputs(_(" -q, --quiet             turn on quiet mode\n"), out);
 	fputs(USAGE_SEPARATOR, out);
@@ -341,28 +418,503 @@ static void timeout_handler(int sig __attribute__((__unused__)),
 		ul_sig_err(EXIT_FAILURE, "timed out");
 }
 
+/*
+ * Generate reply for the request @op to @reply_buf (UUIDD_PROT_BUFSZ bytes).
+ *
+ * Returns the reply length or -1 for unknown operation.
+ */
+static int32_t process_request(struct uuidd_cxt_t *uuidd_cxt, uuidd_prot_op_t op,
+			       uuidd_prot_num_t num, char *reply_buf)
+{
+	int32_t		reply_len;
+	uuid_t		uu;
+	char		str[UUID_STR_LEN], *cp;
+	int		i, ret;
+
+	if (uuidd_cxt->debug) {
+		if (op == UUIDD_OP_BULK_TIME_UUID || op == UUIDD_OP_BULK_RANDOM_UUID)
+			fprintf(stderr, _("operation %d, incoming num = %d\n"), op, num);
+		else
+			fprintf(stderr, _("operation %d\n"), op);
+	}
+
+	switch (op) {
+	case UUIDD_OP_GETPID:
+		snprintf(reply_buf, UUIDD_PROT_BUFSZ, "%d", getpid());
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_GET_MAXOP:
+		snprintf(reply_buf, UUIDD_PROT_BUFSZ, "%d", UUIDD_MAX_OP);
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_TIME_UUID:
+		num = 1;
+		lock_clock();
+		ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
+		unlock_clock();
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated time UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_RANDOM_UUID:
+		num = 1;
+		__uuid_generate_random(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated random UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_BULK_TIME_UUID:
+		lock_clock();
+		ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
+		unlock_clock();
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, P_("Generated time UUID %s "
+					   "and %d following\n",
+					   "Generated time UUID %s "
+					   "and %d following\n", num - 1),
+			       str, num - 1);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		memcpy(reply_buf + reply_len, &num, sizeof(num));
+		reply_len += sizeof(num);
+		break;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+		if (num < 0)
+			num = 1;
+		if (num > UUIDD_PROT_MAX_BULK)
+			num = UUIDD_PROT_MAX_BULK;
+		__uuid_generate_random((unsigned char *) reply_buf +
+				      sizeof(num), &num);
+		reply_len = sizeof(num) + (sizeof(uu) * num);
+		memcpy(reply_buf, &num, sizeof(num));
+		if (uuidd_cxt->debug) {
+			fprintf(stderr, P_("Generated %d UUID:\n",
+					   "Generated %d UUIDs:\n", num), num);
+			cp = reply_buf + sizeof(num);
+			for (i = 0; i < num; i++) {
+				uuid_unparse((unsigned char *)cp, str);
+				fprintf(stderr, "\t%s\n", str);
+				cp += sizeof(uu);
+			}
+		}
+		break;
+	default:
+		if (uuidd_cxt->debug)
+			fprintf(stderr, _("Invalid operation %d\n"), op);
+		return -1;
+	}
+	return reply_len;
+}
+
+static void update_activity(struct uuidd_cxt_t *uuidd_cxt)
+{
+	struct timeval now;
+
+	if (!uuidd_cxt->timeout)
+		return;
+	gettime_monotonic(&now);
+	__atomic_store_n(&uuidd_cxt->last_activity, now.tv_sec, __ATOMIC_RELAXED);
+}
+
+static void free_conn(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	epoll_ctl(wrk->efd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	free(conn->out);
+	free(conn);
+	__atomic_sub_fetch(&wrk->cxt->nconns, 1, __ATOMIC_RELAXED);
+}
+
+/* make sure @conn->out has space for @sz more bytes */
+static void conn_reserve(struct uuidd_conn *conn, size_t sz)
+{
+	if (conn->outpos) {
+		memmove(conn->out, conn->out + conn->outpos,
+			conn->outlen - conn->outpos);
+		conn->outlen -= conn->outpos;
+		conn->outpos = 0;
+	}
+	if (conn->outlen + sz > conn->outsz) {
+		conn->outsz = conn->outlen + sz;
+		conn->out = xrealloc(conn->out, conn->outsz);
+	}
+}
+
+/*
+ * Send the replies from @buf and the pending replies. The rest which
+ * cannot be sent now is kept in the connection buffer.
+ *
+ * Returns 0 on success, -1 if the connection is broken.
+ */
+static int conn_send(struct uuidd_conn *conn, const char *buf, size_t len)
+{
+	ssize_t ret;
+
+	if (len && conn->outlen == conn->outpos) {
+		/* nothing pending, try to send directly from the buffer */
+		ret = send(conn->fd, buf, len, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				return -1;
+			ret = 0;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	if (len) {
+		conn_reserve(conn, len);
+		memcpy(conn->out + conn->outlen, buf, len);
+		conn->outlen += len;
+	}
+
+	while (conn->outpos < conn->outlen) {
+		ret = send(conn->fd, conn->out + conn->outpos,
+			   conn->outlen - conn->outpos, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+		conn->outpos += ret;
+	}
+	if (conn->outpos == conn->outlen)
+		conn->outpos = conn->outlen = 0;
+	return 0;
+}
+
+/*
+ * Read requests from the client.
+ *
+ * Returns 0 on success, -1 if the connection has to be closed.
+ */
+static int conn_read(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	ssize_t ret;
+
+	if (conn->inlen == sizeof(conn->in))
+		return 0;	/* the requests wait for the replies */
+
+	ret = read(conn->fd, conn->in + conn->inlen, sizeof(conn->in) - conn->inlen);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return 0;
+		warn(_("read failed"));
+		return -1;
+	}
+	if (ret == 0) {
+		conn->eof = 1;
+		return 0;
+	}
+	conn->inlen += ret;
+	update_activity(wrk->cxt);
+	return 0;
+}
+
+/*
+ * Process the complete requests. The replies are collected in the worker
+ * buffer and sent together. The processing stops when UUIDD_MAX_PENDING
+ * bytes of the replies cannot be sent, the rest of the requests is kept
+ * for the next call (EPOLLOUT, when the client reads the replies).
+ *
+ * Returns 0 on success, -1 if the connection has to be closed.
+ */
+static int conn_process(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	size_t done = 0, olen = 0;
+
+	while (done < conn->inlen) {
+		uuidd_prot_op_t op = conn->in[done];
+		uuidd_prot_num_t num = 0;
+		size_t need = sizeof(op);
+		int32_t reply_len;
+
+		if (op == UUIDD_OP_BULK_TIME_UUID || op == UUIDD_OP_BULK_RANDOM_UUID)
+			need += sizeof(num);
+		if (conn->inlen - done < need)
+			break;
+		if (conn->outlen - conn->outpos + olen >= UUIDD_MAX_PENDING) {
+			/* stop only if the client does not read the replies */
+			if (conn_send(conn, wrk->obuf, olen) != 0)
+				return -1;
+			olen = 0;
+			if (conn->outlen - conn->outpos >= UUIDD_MAX_PENDING)
+				break;
+		}
+		if (need > sizeof(op))
+			memcpy(&num, conn->in + done + sizeof(op), sizeof(num));
+		done += need;
+
+		if (sizeof(wrk->obuf) - olen < sizeof(reply_len) + UUIDD_PROT_BUFSZ) {
+			if (conn_send(conn, wrk->obuf, olen) != 0)
+				return -1;
+			olen = 0;
+		}
+		reply_len = process_request(wrk->cxt, op, num,
+				wrk->obuf + olen + sizeof(reply_len));
+		if (reply_len < 0) {
+			/* invalid request, send the previous replies and close */
+			conn->eof = 1;
+			done = conn->inlen;
+			break;
+		}
+		memcpy(wrk->obuf + olen, &reply_len, sizeof(reply_len));
+		olen += sizeof(reply_len) + reply_len;
+	}
+
+	conn->inlen -= done;
+	if (conn->inlen)
+		memmove(conn->in, conn->in + done, conn->inlen);
+
+	return olen ? conn_send(conn, wrk->obuf, olen) : 0;
+}
+
+/* update epoll events according to the connection status */
+static int conn_update_events(struct uuidd_worker *wrk, struct uuidd_conn *conn)
+{
+	struct epoll_event ev = { .data.ptr = conn };
+	size_t pending = conn->outlen - conn->outpos;
+
+	if (conn->eof && !pending) {
+		/* all complete requests are processed if nothing is pending */
+		if (conn->inlen)
+			warnx(_("error reading from client, len = %zu"), conn->inlen);
+		return -1;		/* done */
+	}
+	if (!conn->eof && pending < UUIDD_MAX_PENDING
+	    && conn->inlen < sizeof(conn->in))
+		ev.events |= EPOLLIN;
+	if (pending)
+		ev.events |= EPOLLOUT;
+	if (ev.events == conn->events)
+		return 0;
+
+	conn->events = ev.events;
+	return epoll_ctl(wrk->efd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+static void worker_add_fd(struct uuidd_worker *wrk, struct uuidd_conn *conn,
+			  int fd, int kind, uint32_t events)
+{
+	struct epoll_event ev = { .events = events, .data.ptr = conn };
+
+	conn->fd = fd;
+	conn->kind = kind;
+	conn->events = events;
+	if (epoll_ctl(wrk->efd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		err(EXIT_FAILURE, _("epoll_ctl failed"));
+}
+
+/*
+ * Stop accepting new connections for UUIDD_ACCEPT_DELAY, the connected
+ * clients are still served. The listening socket has to be removed from
+ * epoll, it would be reported again and again otherwise.
+ */
+static uint64_t monotonic_ms(void)
+{
+	struct timeval now;
+
+	gettime_monotonic(&now);
+	return (uint64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+static void pause_accept(struct uuidd_worker *wrk, int errsv)
+{
+	struct uuidd_cxt_t *uuidd_cxt = wrk->cxt;
+
+	if (epoll_ctl(wrk->efd, EPOLL_CTL_DEL, wrk->sock, NULL) != 0)
+		err(EXIT_FAILURE, _("epoll_ctl failed"));
+	wrk->accept_resume = monotonic_ms() + UUIDD_ACCEPT_DELAY;
+
+	if (!uuidd_cxt->quiet
+	    && !__atomic_exchange_n(&uuidd_cxt->accept_warned, 1, __ATOMIC_RELAXED)) {
+		if (errsv) {
+			errno = errsv;
+			warn(_("cannot accept new connections"));
+		} else
+			warnx(_("too many connections, new connections wait"));
+	}
+}
+
+static void resume_accept(struct uuidd_worker *wrk)
+{
+	worker_add_fd(wrk, &wrk->listen, wrk->sock, UUIDD_FD_LISTEN,
+		      EPOLLIN | EPOLLEXCLUSIVE);
+	wrk->accept_resume = 0;
+}
+
+static void accept_clients(struct uuidd_worker *wrk)
+{
+	struct uuidd_cxt_t *uuidd_cxt = wrk->cxt;
+	int i;
+
+	for (i = 0; i < UUIDD_ACCEPT_BATCH; i++) {
+		struct epoll_event ev = { .events = EPOLLIN };
+		struct uuidd_conn *conn;
+		int ns;
+
+		if (__atomic_load_n(&uuidd_cxt->nconns, __ATOMIC_RELAXED) >= UUIDD_MAX_CONNS) {
+			pause_accept(wrk, 0);
+			return;
+		}
+		ns = accept4(wrk->sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (ns < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK ||
+			    errno == EINTR || errno == ECONNABORTED)
+				return;
+			/* out of file descriptors or memory, try it later */
+			if (errno == EMFILE || errno == ENFILE ||
+			    errno == ENOBUFS || errno == ENOMEM) {
+				pause_accept(wrk, errno);
+				return;
+			}
+			err(EXIT_FAILURE, "accept");
+		}
+		update_activity(uuidd_cxt);
+
+		conn = xcalloc(1, sizeof(*conn));
+		conn->kind = UUIDD_FD_CLIENT;
+		conn->fd = ns;
+		conn->events = ev.events;
+		ev.data.ptr = conn;
+		if (epoll_ctl(wrk->efd, EPOLL_CTL_ADD, ns, &ev) != 0) {
+			warn(_("epoll_ctl failed"));
+			close(ns);
+			free(conn);
+			continue;
+		}
+		__atomic_add_fetch(&uuidd_cxt->nconns, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * Wait for events and handle them. The first worker (the main thread) also
+ * handles signals and the inactivity timeout.
+ */
+static void *worker_loop(void *data)
+{
+	struct uuidd_worker *wrk = data;
+	struct uuidd_cxt_t *uuidd_cxt = wrk->cxt;
+	struct epoll_event events[UUIDD_MAX_EVENTS];
+	struct uuidd_conn signal_conn = { .fd = -1 };
+	int timeout = -1;
+
+	resume_accept(wrk);
+	if (wrk->sigfd >= 0)
+		worker_add_fd(wrk, &signal_conn, wrk->sigfd, UUIDD_FD_SIGNAL, EPOLLIN);
+
+	while (1) {
+		int i, n, tmo;
+
+		if (wrk->sigfd >= 0 && uuidd_cxt->timeout) {
+			struct timeval now;
+			time_t last = __atomic_load_n(&uuidd_cxt->last_activity,
+						      __ATOMIC_RELAXED);
+
+			gettime_monotonic(&now);
+			if (now.tv_sec - last >= (time_t) uuidd_cxt->timeout) {
+				if (uuidd_cxt->debug)
+					fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
+				all_done(uuidd_cxt, EXIT_SUCCESS);
+			}
+			timeout = (last + uuidd_cxt->timeout - now.tv_sec) * 1000;
+		}
+
+		tmo = timeout;
+		if (wrk->accept_resume) {
+			uint64_t now = monotonic_ms();
+			int delay = now < wrk->accept_resume ?
+					(int) (wrk->accept_resume - now) : 0;
+
+			if (tmo < 0 || tmo > delay)
+				tmo = delay;
+		}
+
+		n = epoll_wait(wrk->efd, events, ARRAY_SIZE(events), tmo);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			warn(_("epoll_wait failed"));
+			all_done(uuidd_cxt, EXIT_FAILURE);
+		}
+		/* try again after the delay, or when some connection is closed */
+		if (wrk->accept_resume && monotonic_ms() >= wrk->accept_resume)
+			resume_accept(wrk);
+
+		for (i = 0; i < n; i++) {
+			struct uuidd_conn *conn = events[i].data.ptr;
+			int rc = 0;
+
+			switch (conn->kind) {
+			case UUIDD_FD_SIGNAL:
+				handle_signal(uuidd_cxt, conn->fd);
+				continue;
+			case UUIDD_FD_LISTEN:
+				accept_clients(wrk);
+				continue;
+			}
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP)
+			    && !(events[i].events & EPOLLIN))
+				rc = -1;
+			if (!rc && (events[i].events & EPOLLOUT))
+				rc = conn_send(conn, NULL, 0);
+			if (!rc && (events[i].events & EPOLLIN))
+				rc = conn_read(wrk, conn);
+			/* new requests, or the old ones waiting for the replies */
+			if (!rc)
+				rc = conn_process(wrk, conn);
+			if (!rc)
+				rc = conn_update_events(wrk, conn);
+			if (rc) {
+				free_conn(wrk, conn);
+				if (wrk->accept_resume)
+					resume_accept(wrk);
+			}
+		}
+	}
+	return NULL;
+}
+
+static size_t get_nworkers(const struct uuidd_cxt_t *uuidd_cxt)
+{
+#ifdef HAVE_LIBPTHREAD
+	long ncpus;
+
+	if (uuidd_cxt->nworkers)
+		return uuidd_cxt->nworkers;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return ncpus > 0 ? min((size_t) ncpus, (size_t) UUIDD_MAX_WORKERS) : 1;
+#else
+	return 1;
+#endif
+}
+
 static void server_loop(const char *socket_path, const char *pidfile_path,
 			struct uuidd_cxt_t *uuidd_cxt)
 {
-	struct sockaddr_un	from_addr;
-	socklen_t		fromlen;
-	int32_t			reply_len = 0;
-	uuid_t			uu;
-	char			reply_buf[UUIDD_PROT_BUFSZ], *cp;
-	uuidd_prot_op_t 	op;
-	char			str[UUID_STR_LEN];
-	int			i, ns, len;
-	uuidd_prot_num_t	num;		/* intentionally uninitialized */
+	char			buf[64];
 	int			s = 0;
 	int			fd_pidfile = -1;
 	int			ret;
-	struct pollfd		pfd[2];
 	sigset_t		sigmask;
 	int			sigfd;
-	enum {
-				POLLFD_SIGNAL = 0,
-				POLLFD_SOCKET
-	};
+	size_t			i, nworkers;
+	struct uuidd_worker	*workers;
 
 #ifdef HAVE_LIBSYSTEMD
 	if (!uuidd_cxt->no_sock)	/* no_sock implies no_fork and no_pid */
@@ -377,13 +929,13 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 			err(EXIT_FAILURE, _("cannot set up timer"));
 		if (pidfile_path)
 			fd_pidfile = create_pidfile(uuidd_cxt, pidfile_path);
-		ret = call_daemon(socket_path, UUIDD_OP_GETPID, reply_buf,
-				  sizeof(reply_buf), 0, NULL);
+		ret = call_daemon(socket_path, UUIDD_OP_GETPID, buf,
+				  sizeof(buf), 0, NULL);
 		cancel_timer(&timer);
 		if (ret > 0) {
 			if (!uuidd_cxt->quiet)
 				warnx(_("uuidd daemon is already running at pid %s"),
-					reply_buf);
+					buf);
 			exit(EXIT_FAILURE);
 		}
 
@@ -399,10 +951,10 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 			create_daemon();
 
 		if (pidfile_path) {
-			snprintf(reply_buf, sizeof(reply_buf), "%8d\n", getpid());
+			snprintf(buf, sizeof(buf), "%8d\n", getpid());
 			if (ftruncate(fd_pidfile, 0))
 				err(EXIT_FAILURE, _("could not truncate file: %s"), pidfile_path);
-			write_all(fd_pidfile, reply_buf, strlen(reply_buf));
+			write_all(fd_pidfile, buf, strlen(buf));
 			if (fd_pidfile > 1 && close_fd(fd_pidfile) != 0)
 				err(EXIT_FAILURE, _("write failed: %s"), pidfile_path);
 		}
@@ -425,6 +977,8 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 		s = SD_LISTEN_FDS_START + 0;
 	}
 #endif
+	if (fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) < 0)
+		err(EXIT_FAILURE, _("cannot set non-blocking mode"));
 
 	sigemptyset(&sigmask);
 	sigaddset(&sigmask, SIGHUP);
@@ -433,138 +987,43 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	sigaddset(&sigmask, SIGALRM);
 	sigaddset(&sigmask, SIGPIPE);
 	/* Block signals so that they aren't handled according to their
-	 * default dispositions */
+	 * default dispositions (the workers inherit the mask) */
 	sigprocmask(SIG_BLOCK, &sigmask, NULL);
-	if ((sigfd = signalfd(-1, &sigmask, 0)) < 0)
+	if ((sigfd = signalfd(-1, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
 		err(EXIT_FAILURE, _("cannot set signal handler"));
 
-	pfd[POLLFD_SIGNAL].fd = sigfd;
-	pfd[POLLFD_SOCKET].fd = s;
-	pfd[POLLFD_SIGNAL].events = pfd[POLLFD_SOCKET].events = POLLIN | POLLERR | POLLHUP;
+	update_activity(uuidd_cxt);
 
-	while (1) {
-		ret = poll(pfd, ARRAY_SIZE(pfd),
-				uuidd_cxt->timeout ?
-					(int) uuidd_cxt->timeout * 1000 : -1);
-		if (ret < 0) {
-			if (errno == EAGAIN)
-				continue;
-			warn(_("poll failed"));
-			all_done(uuidd_cxt, EXIT_FAILURE);
-		}
-		if (ret == 0) {		/* true when poll() times out */
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
-			all_done(uuidd_cxt, EXIT_SUCCESS);
-		}
-		if (pfd[POLLFD_SIGNAL].revents != 0)
-			handle_signal(uuidd_cxt, sigfd);
-		if (pfd[POLLFD_SOCKET].revents == 0)
-			continue;
-		fromlen = sizeof(from_addr);
-		ns = accept(s, (struct sockaddr *) &from_addr, &fromlen);
-		if (ns < 0) {
-			if ((errno == EAGAIN) || (errno == EINTR))
-				continue;
-			err(EXIT_FAILURE, "accept");
-		}
-		len = read(ns, &op, sizeof(op));
-		if (len != sizeof(op)) {
-			if (len < 0)
-				warn(_("read failed"));
-			else
-				warnx(_("error reading from client, len = %d"),
-						len);
-			goto shutdown_socket;
-		}
-		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
-			if (read_all(ns, (char *) &num, sizeof(num)) != sizeof(num))
-				goto shutdown_socket;
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("operation %d, incoming num = %d\n"),
-				       op, num);
-		} else if (uuidd_cxt->debug)
-			fprintf(stderr, _("operation %d\n"), op);
+	nworkers = get_nworkers(uuidd_cxt);
+	workers = xcalloc(nworkers, sizeof(*workers));
 
-		switch (op) {
-		case UUIDD_OP_GETPID:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", getpid());
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_GET_MAXOP:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", UUIDD_MAX_OP);
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_TIME_UUID:
-			num = 1;
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated time UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_RANDOM_UUID:
-			num = 1;
-			__uuid_generate_random(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated random UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_BULK_TIME_UUID:
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, P_("Generated time UUID %s "
-						   "and %d following\n",
-						   "Generated time UUID %s "
-						   "and %d following\n", num - 1),
-				       str, num - 1);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			memcpy(reply_buf + reply_len, &num, sizeof(num));
-			reply_len += sizeof(num);
-			break;
-		case UUIDD_OP_BULK_RANDOM_UUID:
-			if (num < 0)
-				num = 1;
-			if ((sizeof(reply_buf) - sizeof(num)) < (size_t) (sizeof(uu) * num))
-				num = (sizeof(reply_buf) - sizeof(num)) / sizeof(uu);
-			__uuid_generate_random((unsigned char *) reply_buf +
-					      sizeof(num), &num);
-			reply_len = sizeof(num) + (sizeof(uu) * num);
-			memcpy(reply_buf, &num, sizeof(num));
-			if (uuidd_cxt->debug) {
-				fprintf(stderr, P_("Generated %d UUID:\n",
-						   "Generated %d UUIDs:\n", num), num);
-				cp = reply_buf + sizeof(num);
-				for (i = 0; i < num; i++) {
-					uuid_unparse((unsigned char *)cp, str);
-					fprintf(stderr, "\t%s\n", str);
-					cp += sizeof(uu);
-				}
-			}
+	for (i = 0; i < nworkers; i++) {
+		struct uuidd_worker *wrk = &workers[i];
+
+		wrk->cxt = uuidd_cxt;
+		wrk->sock = s;
+		wrk->sigfd = i == 0 ? sigfd : -1;
+		wrk->efd = epoll_create1(EPOLL_CLOEXEC);
+		if (wrk->efd < 0)
+			err(EXIT_FAILURE, _("cannot create epoll"));
+#ifdef HAVE_LIBPTHREAD
+		if (i == 0)
+			continue;
+		ret = pthread_create(&wrk->thread, NULL, worker_loop, wrk);
+		if (ret) {
+			errno = ret;
+			if (!uuidd_cxt->quiet)
+				warn(_("cannot create worker thread"));
+			close(wrk->efd);
 			break;
-		default:
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("Invalid operation %d\n"), op);
-			goto shutdown_socket;
 		}
-		write_all(ns, (char *) &reply_len, sizeof(num));
-		write_all(ns, reply_buf, reply_len);
-	shutdown_socket:
-		close(ns);
+#endif
 	}
+	if (uuidd_cxt->debug)
+		fprintf(stderr, P_("started %zu worker\n",
+				   "started %zu workers\n", i), i);
+
+	worker_loop(&workers[0]);
 }
 
 static void __attribute__ ((__noreturn__)) unexpected_size(int size)
@@ -608,6 +1067,7 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 		{"no-fork", no_argument, NULL, 'F'},
 		{"socket-activation", no_argument, NULL, 'S'},
 		{"cont-clock", optional_argument, NULL, 'C'},
+		{"workers", required_argument, NULL, 'w'},
 		{"debug", no_argument, NULL, 'd'},
 		{"quiet", no_argument, NULL, 'q'},
 		{"version", no_argument, NULL, 'V'},
@@ -623,7 +1083,7 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 	int c;
 
-	while ((c = getopt_long(argc, argv, "p:s:T:krtn:PFSC::dqVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "p:s:T:krtn:PFSC::dqw:Vh", longopts, NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
 		case 'C':
@@ -680,6 +1140,10 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 			uuidd_cxt->timeout = strtou32_or_err(optarg,
 						_("failed to parse --timeout"));
 			break;
+		case 'w':
+			uuidd_cxt->nworkers = str2num_or_err(optarg, 10,
+						_("failed to parse --workers"), 1, 1024);
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
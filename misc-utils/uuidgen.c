@@ -85,6 +85,26 @@ badstring:
 	return value2;
 }
 
+/* generate and print random or v7 uuids in chunks */
+static void print_bulk(int do_type, unsigned int count)
+{
+	uuid_t uus[256];
+	char str[ARRAY_SIZE(uus) * UUID_STR_LEN];
+
+	while (count > 0) {
+		size_t n = min((size_t) count, ARRAY_SIZE(uus));
+
+		if (do_type == UUID_TYPE_DCE_TIME_V7)
+			uuid_generate_time_v7_bulk(uus, n);
+		else
+			uuid_generate_random_bulk(uus, n);
+
+		uuid_unparse_bulk(uus, n, str, '\n');
+		fwrite(str, UUID_STR_LEN, n, stdout);
+		count -= n;
+	}
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -197,6 +217,12 @@ main (int argc, char *argv[])
 			name = unhex(name, &namelen);
 	}
 
+	if (count > 1 && (do_type == UUID_TYPE_DCE_RANDOM ||
+			  do_type == UUID_TYPE_DCE_TIME_V7)) {
+		print_bulk(do_type, count);
+		count = 0;
+	}
+
 	for (i = 0; i < count; i++) {
 		switch (do_type) {
 		case UUID_TYPE_DCE_TIME:
@@ -37,8 +37,10 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <getopt.h>
 #include <libsmartcols.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -86,7 +88,22 @@ static size_t ncolumns;
 struct control {
 	bool	json,
 		no_headings,
-		raw;
+		raw,
+		stream;
+};
+
+/* number of rows printed at once in --stream mode */
+#define STREAM_BATCH	1024
+
+struct stream {
+	struct libscols_table *tb;
+
+	/* valid-length input strings waiting for uuid_parse_bulk() */
+	char	str[STREAM_BATCH][UUID_STR_LEN];
+	uuid_t	uu[STREAM_BATCH];
+	size_t	nstr;
+
+	bool	printed;	/* the first batch (with headings) is out */
 };
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -101,6 +118,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputsln(_(" -n, --noheadings       don't print headings"), stdout);
 	fputsln(_(" -o, --output <list>    COLUMNS to display (see below)"), stdout);
 	fputsln(_(" -r, --raw              use the raw output format"), stdout);
+	fputsln(_(" -s, --stream           print the input in batches as it is read"), stdout);
 	fprintf(stdout, USAGE_HELP_OPTIONS(24));
 
 	fputs(USAGE_COLUMNS, stdout);
@@ -138,11 +156,12 @@ static const struct colinfo *get_column_info(int num)
 	return &infos[get_column_id(num)];
 }
 
-static void fill_table_row(struct libscols_table *tb, char const *const uuid)
+/* @buf is the parsed @uuid, or NULL if @uuid is invalid */
+static void add_table_row(struct libscols_table *tb, char const *const uuid,
+			  const uuid_t buf)
 {
 	static struct libscols_line *ln;
 	size_t i;
-	uuid_t buf;
 	int invalid = 0;
 	int variant = -1, type = -1;
 
@@ -153,7 +172,7 @@ static void fill_table_row(struct libscols_table *tb, char const *const uuid)
 	if (!ln)
 		errx(EXIT_FAILURE, _("failed to allocate output line"));
 
-	if (uuid_parse(uuid, buf))
+	if (!buf)
 		invalid = 1;
 	else {
 		variant = uuid_variant(buf);
@@ -255,6 +274,135 @@ static void fill_table_row(struct libscols_table *tb, char const *const uuid)
 	}
 }
 
+static void fill_table_row(struct libscols_table *tb, char const *const uuid)
+{
+	uuid_t buf;
+
+	add_table_row(tb, uuid, uuid_parse(uuid, buf) ? NULL : buf);
+}
+
+/* converts the pending strings to table rows */
+static void stream_add_rows(struct stream *st)
+{
+	size_t i = 0, n;
+
+	while (i < st->nstr) {
+		n = uuid_parse_bulk(st->str[i], st->nstr - i, &st->uu[i]);
+		for (n += i; i < n; i++)
+			add_table_row(st->tb, st->str[i], st->uu[i]);
+		if (i < st->nstr) {
+			add_table_row(st->tb, st->str[i], NULL);
+			i++;
+		}
+	}
+	st->nstr = 0;
+}
+
+/* prints and drops the rows collected so far */
+static void stream_print(struct stream *st)
+{
+	stream_add_rows(st);
+	if (st->printed && scols_table_get_nlines(st->tb) == 0)
+		return;
+
+	scols_print_table(st->tb);
+	scols_table_remove_lines(st->tb);
+	if (!st->printed) {
+		size_t i;
+
+		/* keep the columns of the next batches aligned with the first */
+		for (i = 0; i < ncolumns; i++) {
+			struct libscols_column *cl;
+
+			cl = scols_table_get_column(st->tb, i);
+			scols_column_set_whint(cl, scols_column_get_width(cl));
+		}
+		scols_table_enable_noheadings(st->tb, 1);
+		st->printed = 1;
+	}
+}
+
+static void stream_add(struct stream *st, const char *uuid, size_t len)
+{
+	if (len == UUID_STR_LEN - 1) {
+		memcpy(st->str[st->nstr], uuid, len);
+		st->str[st->nstr][len] = '\0';
+		st->nstr++;
+	} else {
+		/* keep the input order */
+		stream_add_rows(st);
+		add_table_row(st->tb, uuid, NULL);
+	}
+
+	if (st->nstr == STREAM_BATCH
+	    || scols_table_get_nlines(st->tb) >= STREAM_BATCH)
+		stream_print(st);
+}
+
+static int input_pending(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, 0) > 0;
+}
+
+/*
+ * Reads white-space separated UUIDs from @fd with constant memory. Rows are
+ * printed in batches, and whenever the next read(2) would block, so a slow
+ * producer does not delay the output.
+ */
+static void stream_input(struct stream *st, int fd)
+{
+	char buf[BUFSIZ * 8];
+	size_t len = 0;
+
+	for (;;) {
+		char *p, *end, *tok;
+		ssize_t rc;
+
+		if ((st->nstr || scols_table_get_nlines(st->tb))
+		    && !input_pending(fd)) {
+			stream_print(st);
+			fflush(stdout);
+		}
+
+		rc = read(fd, buf + len, sizeof(buf) - 1 - len);
+		if (rc < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			err(EXIT_FAILURE, _("read failed"));
+		}
+		if (rc == 0)
+			break;
+		len += rc;
+
+		end = buf + len;
+		for (p = tok = buf; p < end; p++) {
+			if (*p != ' ' && *p != '\t' && *p != '\n')
+				continue;
+			if (p > tok) {
+				*p = '\0';
+				stream_add(st, tok, p - tok);
+			}
+			tok = p + 1;
+		}
+
+		/* keep the incomplete token, unless it fills the buffer */
+		len = end - tok;
+		if (len == sizeof(buf) - 1) {
+			buf[len] = '\0';
+			stream_add(st, buf, len);
+			len = 0;
+		} else if (len)
+			memmove(buf, tok, len);
+	}
+
+	if (len) {
+		buf[len] = '\0';
+		stream_add(st, buf, len);
+	}
+}
+
 static void print_output(struct control const *const ctrl, int argc,
 			 char **argv)
 {
@@ -266,7 +414,9 @@ static void print_output(struct control const *const ctrl, int argc,
 	if (!tb)
 		err(EXIT_FAILURE, _("failed to allocate output table"));
 
-	if (ctrl->json) {
+	if (ctrl->json && ctrl->stream)
+		scols_table_enable_ndjson(tb, 1);
+	else if (ctrl->json) {
 		scols_table_enable_json(tb, 1);
 		scols_table_set_name(tb, "uuids");
 	}
@@ -282,6 +432,21 @@ static void print_output(struct control const *const ctrl, int argc,
 			    _("failed to initialize output column"));
 	}
 
+	if (ctrl->stream) {
+		struct stream *st = xcalloc(1, sizeof(*st));
+
+		st->tb = tb;
+		for (i = 0; i < (size_t) argc; i++)
+			stream_add(st, argv[i], strlen(argv[i]));
+		if (argc == 0)
+			stream_input(st, STDIN_FILENO);
+		stream_print(st);
+
+		free(st);
+		scols_unref_table(tb);
+		return;
+	}
+
 	for (i = 0; i < (size_t) argc; i++)
 		fill_table_row(tb, argv[i]);
 
@@ -306,6 +471,7 @@ int main(int argc, char **argv)
 		{"noheadings", no_argument,       NULL, 'n'},
 		{"output",     required_argument, NULL, 'o'},
 		{"raw",        no_argument,       NULL, 'r'},
+		{"stream",     no_argument,       NULL, 's'},
 		{"version",    no_argument,       NULL, 'V'},
 		{"help",       no_argument,       NULL, 'h'},
 		{NULL, 0, NULL, 0}
@@ -321,7 +487,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "Jno:rVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "Jno:rsVh", longopts, NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
 		case 'J':
@@ -336,6 +502,9 @@ int main(int argc, char **argv)
 		case 'r':
 			ctrl.raw = 1;
 			break;
+		case 's':
+			ctrl.stream = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
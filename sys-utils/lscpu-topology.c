@@ -444,6 +444,15 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 	size_t i, ncaches = 0;
+	struct ul_path_attr attrs[] = {
+		{ .name = "ways_of_associativity" },
+		{ .name = "physical_line_partition" },
+		{ .name = "number_of_sets" },
+		{ .name = "coherency_line_size" },
+		{ .name = "allocation_policy" },
+		{ .name = "write_policy" },
+		{ .name = "size" }
+	};
 
 	while (ul_path_accessf(sys, F_OK,
 				"cpu%d/cache/index%zu",
@@ -459,14 +468,22 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	for (i = 0; i < ncaches; i++) {
 		struct lscpu_cache *ca;
 		int id, level;
-
-		if (ul_path_readf_s32(sys, &id, "cpu%d/cache/index%zu/id", num, i) != 0)
+		struct ul_path_attr ids[] = {
+			{ .name = "id" },
+			{ .name = "level" },
+			{ .name = "type" }
+		};
+
+		if (ul_path_readf_attrs(sys, ids, ARRAY_SIZE(ids),
+					"cpu%d/cache/index%zu", num, i) < 0)
+			continue;
+		if (ul_path_attr_s32(&ids[0], &id) != 0)
 			id = -1;
-		if (ul_path_readf_s32(sys, &level, "cpu%d/cache/index%zu/level", num, i) != 0)
+		if (ul_path_attr_s32(&ids[1], &level) != 0)
 			continue;
-		if (ul_path_readf_buffer(sys, buf, sizeof(buf),
-                                        "cpu%d/cache/index%zu/type", num, i) <= 0)
+		if (ids[2].rc <= 0)
 			continue;
+		xstrncpy(buf, ids[2].value, sizeof(buf));
 
 		if (id == -1)
 			id = mk_cache_id(cxt, cpu, buf, level);
@@ -492,24 +509,22 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 
 			ca->name = xstrdup(buf);
 
-			ul_path_readf_u32(sys, &ca->ways_of_associativity,
-					"cpu%d/cache/index%zu/ways_of_associativity", num, i);
-			ul_path_readf_u32(sys, &ca->physical_line_partition,
-					"cpu%d/cache/index%zu/physical_line_partition", num, i);
-			ul_path_readf_u32(sys, &ca->number_of_sets,
-					"cpu%d/cache/index%zu/number_of_sets", num, i);
-			ul_path_readf_u32(sys, &ca->coherency_line_size,
-					"cpu%d/cache/index%zu/coherency_line_size", num, i);
+			ul_path_readf_attrs(sys, attrs, ARRAY_SIZE(attrs),
+					"cpu%d/cache/index%zu", num, i);
+
+			ul_path_attr_u32(&attrs[0], &ca->ways_of_associativity);
+			ul_path_attr_u32(&attrs[1], &ca->physical_line_partition);
+			ul_path_attr_u32(&attrs[2], &ca->number_of_sets);
+			ul_path_attr_u32(&attrs[3], &ca->coherency_line_size);
 
-			ul_path_readf_string(sys, &ca->allocation_policy,
-					"cpu%d/cache/index%zu/allocation_policy", num, i);
-			ul_path_readf_string(sys, &ca->write_policy,
-					"cpu%d/cache/index%zu/write_policy", num, i);
+			if (attrs[4].rc >= 0)
+				ca->allocation_policy = xstrdup(attrs[4].value);
+			if (attrs[5].rc >= 0)
+				ca->write_policy = xstrdup(attrs[5].value);
 
 			/* cache size */
-			if (ul_path_readf_buffer(sys, buf, sizeof(buf),
-					"cpu%d/cache/index%zu/size", num, i) > 0)
-				ul_parse_size(buf, &ca->size, NULL);
+			if (attrs[6].rc > 0)
+				ul_parse_size(attrs[6].value, &ca->size, NULL);
 			else
 				ca->size = 0;
 		}
@@ -528,18 +543,25 @@ static int read_ids(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 
-	if (ul_path_accessf(sys, F_OK, "cpu%d/topology", num) != 0)
+	struct ul_path_attr attrs[] = {
+		{ .name = "core_id" },
+		{ .name = "physical_package_id" },
+		{ .name = "book_id" },
+		{ .name = "drawer_id" }
+	};
+
+	if (ul_path_readf_attrs(sys, attrs, ARRAY_SIZE(attrs), "cpu%d/topology", num) < 0)
 		return 0;
 
 	DBG(CPU, ul_debugobj(cpu, "#%d reading IDs", num));
 
-	if (ul_path_readf_s32(sys, &cpu->coreid, "cpu%d/topology/core_id", num) != 0)
+	if (ul_path_attr_s32(&attrs[0], &cpu->coreid) != 0)
 		cpu->coreid = -1;
-	if (ul_path_readf_s32(sys, &cpu->socketid, "cpu%d/topology/physical_package_id", num) != 0)
+	if (ul_path_attr_s32(&attrs[1], &cpu->socketid) != 0)
 		cpu->socketid = -1;
-	if (ul_path_readf_s32(sys, &cpu->bookid, "cpu%d/topology/book_id", num) != 0)
+	if (ul_path_attr_s32(&attrs[2], &cpu->bookid) != 0)
 		cpu->bookid = -1;
-	if (ul_path_readf_s32(sys, &cpu->drawerid, "cpu%d/topology/drawer_id", num) != 0)
+	if (ul_path_attr_s32(&attrs[3], &cpu->drawerid) != 0)
 		cpu->drawerid = -1;
 
 	return 0;
@@ -611,12 +633,20 @@ static int read_mhz(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	struct path_cxt *sys = cxt->syscpu;
 	int num = cpu->logical_id;
 	int mhz;
+	struct ul_path_attr attrs[] = {
+		{ .name = "cpuinfo_max_freq" },
+		{ .name = "cpuinfo_min_freq" },
+		{ .name = "scaling_cur_freq" }
+	};
 
 	DBG(CPU, ul_debugobj(cpu, "#%d reading mhz", num));
 
-	if (ul_path_readf_s32(sys, &mhz, "cpu%d/cpufreq/cpuinfo_max_freq", num) == 0)
+	if (ul_path_readf_attrs(sys, attrs, ARRAY_SIZE(attrs), "cpu%d/cpufreq", num) <= 0)
+		return 0;
+
+	if (ul_path_attr_s32(&attrs[0], &mhz) == 0)
 		cpu->mhz_max_freq = (float) mhz / 1000;
-	if (ul_path_readf_s32(sys, &mhz, "cpu%d/cpufreq/cpuinfo_min_freq", num) == 0)
+	if (ul_path_attr_s32(&attrs[1], &mhz) == 0)
 		cpu->mhz_min_freq = (float) mhz / 1000;
 
 	/* The default current-frequency value comes is from /proc/cpuinfo (if
@@ -626,7 +656,7 @@ static int read_mhz(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	 * for the current policy. There is also cpuinfo_cur_freq in sysfs, but
 	 * it's not always available.
 	 */
-	if (ul_path_readf_s32(sys, &mhz, "cpu%d/cpufreq/scaling_cur_freq", num) == 0)
+	if (ul_path_attr_s32(&attrs[2], &mhz) == 0)
 		cpu->mhz_cur_freq = (float) mhz / 1000;
 
 	if (cpu->type && (cpu->mhz_min_freq || cpu->mhz_max_freq))
@@ -360,6 +360,11 @@ static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 {
 	char *line = NULL;
 	int i, x = 0, rc = 0;
+	struct ul_path_attr attrs[] = {
+		{ .name = "removable" },
+		{ .name = "state" },
+		{ .name = "valid_zones" }
+	};
 
 	memset(blk, 0, sizeof(*blk));
 
@@ -371,28 +376,33 @@ static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 	if (errno)
 		rc = -errno;
 
-	if (ul_path_readf_s32(lsmem->sysmem, &x, "%s/removable", name) == 0)
+	/* read all the attributes by one call, valid_zones only if needed */
+	ul_path_readf_attrs(lsmem->sysmem, attrs,
+			lsmem->have_zones ? 3 : 2, "%s", name);
+
+	if (ul_path_attr_s32(&attrs[0], &x) == 0)
 		blk->removable = x == 1;
 
-	if (ul_path_readf_string(lsmem->sysmem, &line, "%s/state", name) > 0 && line) {
-		if (strcmp(line, "offline") == 0)
+	if (attrs[1].rc > 0) {
+		const char *state = attrs[1].value;
+
+		if (strcmp(state, "offline") == 0)
 			blk->state = MEMORY_STATE_OFFLINE;
-		else if (strcmp(line, "online") == 0)
+		else if (strcmp(state, "online") == 0)
 			blk->state = MEMORY_STATE_ONLINE;
-		else if (strcmp(line, "going-offline") == 0)
+		else if (strcmp(state, "going-offline") == 0)
 			blk->state = MEMORY_STATE_GOING_OFFLINE;
-		free(line);
 	}
 
 	if (lsmem->have_nodes)
 		blk->node = memory_block_get_node(lsmem, name);
 
 	blk->nr_zones = 0;
-	if (lsmem->have_zones
-	    && ul_path_readf_string(lsmem->sysmem, &line, "%s/valid_zones", name) > 0
-	    && line) {
+	if (lsmem->have_zones && attrs[2].rc > 0) {
+		char *token;
 
-		char *token = strtok(line, " ");
+		line = xstrdup(attrs[2].value);
+		token = strtok(line, " ");
 
 		for (i = 0; token && i < MAX_NR_ZONES; i++) {
 			blk->zones[i] = zone_name_to_id(token);
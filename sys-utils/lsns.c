@@ -19,6 +19,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <search.h>
 #include <libsmartcols.h>
 #include <libmount.h>
 # include <stdbool.h>
@@ -155,6 +156,17 @@ static const char *const ns_names[] = {
 	[LSNS_TYPE_TIME] = "time"
 };
 
+static const int procfs_ns_types[] = {
+	[LSNS_TYPE_MNT] = PROCFS_NS_MNT,
+	[LSNS_TYPE_NET] = PROCFS_NS_NET,
+	[LSNS_TYPE_PID] = PROCFS_NS_PID,
+	[LSNS_TYPE_UTS] = PROCFS_NS_UTS,
+	[LSNS_TYPE_IPC] = PROCFS_NS_IPC,
+	[LSNS_TYPE_USER] = PROCFS_NS_USER,
+	[LSNS_TYPE_CGROUP] = PROCFS_NS_CGROUP,
+	[LSNS_TYPE_TIME] = PROCFS_NS_TIME
+};
+
 enum {
       RELA_PARENT,
       RELA_OWNER,
@@ -186,8 +198,6 @@ struct lsns_process {
 	uid_t uid;
 
 	ino_t            ns_ids[ARRAY_SIZE(ns_names)];
-	ino_t            ns_pids[ARRAY_SIZE(ns_names)];
-	ino_t            ns_oids[ARRAY_SIZE(ns_names)];
 
 	struct list_head ns_siblings[ARRAY_SIZE(ns_names)];
 
@@ -228,12 +238,26 @@ struct lsns {
 
 	struct libmnt_table *tab;
 	struct libscols_filter *filter;
+
+	void *ns_index;		/* tsearch() tree of namespaces by id */
 };
 
 struct netnsid_cache {
 	ino_t ino;
 	int   id;
-	struct list_head netnsids;
+};
+
+/* namespace file or socket opened by a process, see read_opened_namespaces() */
+struct opened_ns {
+	uint64_t fd;
+	ino_t ino;
+	bool is_sock;
+};
+
+/* all namespaces opened by a process; procfs_snapshot->priv[] */
+struct opened_nslist {
+	size_t nopened;
+	struct opened_ns opened[];
 };
 
 /* "userdata" used by callback for libsmartcols filter */
@@ -243,9 +267,10 @@ struct filler_data {
 	struct lsns_process *proc;
 };
 
-static struct list_head netnsids_cache;
+static void *netnsids_cache;	/* tsearch() tree of struct netnsid_cache */
 
 static int netlink_fd = -1;
+static uint32_t netlink_seq;
 
 static void lsns_init_debug(void)
 {
@@ -388,83 +413,72 @@ static int get_owner_ns_ino(int fd, ino_t *oino, int *ofd)
 }
 #endif
 
-static int get_ns_inos(struct path_cxt *pc, const char *nsname, ino_t *ino, ino_t *pino, ino_t *oino)
+/* Get the parent and owner of the namespace `ino' the process `pid' is a member
+ * of. It's called once per namespace rather than once per process. */
+static void get_related_ns_inos(pid_t pid, enum lsns_type lsns_type, ino_t ino,
+				ino_t *pino, ino_t *oino)
 {
-	struct stat st;
-
-	*ino = 0;
-	if (ul_path_statf(pc, &st, 0, "ns/%s", nsname) != 0)
-		return -errno;
-	*ino = st.st_ino;
-
 	*pino = 0;
 	*oino = 0;
 
 #ifdef USE_NS_GET_API
-	int r;
-	enum lsns_type lsns_type;
-	int fd = ul_path_openf(pc, 0, "ns/%s", nsname);
+	char path[sizeof(_PATH_PROC) + sizeof(stringify_value(INT_MAX)) + 16];
+	struct stat st;
+	int fd;
+
+	snprintf(path, sizeof(path), _PATH_PROC "/%d/ns/%s",
+		 (int) pid, ns_names[lsns_type]);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
 	if (fd < 0)
-		return -errno;
-	lsns_type = ns_name2type(nsname);
+		return;
 
-	r = get_parent_ns_ino(fd, lsns_type, pino, NULL);
-	if (r == 0)
-		r = get_owner_ns_ino(fd, oino, NULL);
+	/* the process may be gone since the /proc snapshot */
+	if (fstat(fd, &st) == 0 && st.st_ino == ino
+	    && get_parent_ns_ino(fd, lsns_type, pino, NULL) == 0)
+		get_owner_ns_ino(fd, oino, NULL);
 	close(fd);
-	return r;
+#else
+	(void) pid;
+	(void) lsns_type;
+	(void) ino;
 #endif
-	return 0;
 }
 
-static int parse_proc_stat(char *line, pid_t *pid, char *state, pid_t *ppid)
+static int cmp_namespace_ids(const void *a, const void *b)
 {
-	char *p;
-	int rc;
-
-	p = strrchr(line, ')');
-	if (p == NULL ||
-	    sscanf(line, "%d (", pid) != 1 ||
-	    sscanf(p, ") %c %d*[^\n]", state, ppid) != 2) {
-		rc = -EINVAL;
-		goto error;
-	}
-	rc = 0;
+	ino_t x = ((const struct lsns_namespace *) a)->id,
+	      y = ((const struct lsns_namespace *) b)->id;
 
-error:
-	return rc;
+	return x < y ? -1 : x > y ? 1 : 0;
 }
 
 static struct lsns_namespace *get_namespace(struct lsns *ls, ino_t ino)
 {
-	struct list_head *p;
+	struct lsns_namespace key = { .id = ino };
+	void **x = tfind(&key, &ls->ns_index, cmp_namespace_ids);
 
-	list_for_each(p, &ls->namespaces) {
-		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
-
-		if (ns->id == ino)
-			return ns;
-	}
-	return NULL;
+	return x ? *x : NULL;
 }
 
 
 #ifdef HAVE_LINUX_NET_NAMESPACE_H
-static int netnsid_cache_find(ino_t netino, int *netnsid)
+static int cmp_netnsid_caches(const void *a, const void *b)
 {
-	struct list_head *p;
+	ino_t x = ((const struct netnsid_cache *) a)->ino,
+	      y = ((const struct netnsid_cache *) b)->ino;
 
-	list_for_each(p, &netnsids_cache) {
-		struct netnsid_cache *e = list_entry(p,
-						     struct netnsid_cache,
-						     netnsids);
-		if (e->ino == netino) {
-			*netnsid = e->id;
-			return 1;
-		}
-	}
+	return x < y ? -1 : x > y ? 1 : 0;
+}
 
-	return 0;
+static int netnsid_cache_find(ino_t netino, int *netnsid)
+{
+	struct netnsid_cache key = { .ino = netino };
+	void **x = tfind(&key, &netnsids_cache, cmp_netnsid_caches);
+
+	if (!x)
+		return 0;
+	*netnsid = ((struct netnsid_cache *) *x)->id;
+	return 1;
 }
 
 static void netnsid_cache_add(ino_t netino, int netnsid)
@@ -474,166 +488,252 @@ static void netnsid_cache_add(ino_t netino, int netnsid)
 	e = xcalloc(1, sizeof(*e));
 	e->ino = netino;
 	e->id  = netnsid;
-	INIT_LIST_HEAD(&e->netnsids);
-	list_add(&e->netnsids, &netnsids_cache);
+	if (!tsearch(e, &netnsids_cache, cmp_netnsid_caches))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
 }
 
-static int get_netnsid_via_netlink_send_request(int target_fd)
-{
-	unsigned char req[NLMSG_SPACE(sizeof(struct rtgenmsg))
-			  + RTA_SPACE(sizeof(int32_t))];
+#define NETNSID_REQ_SIZE	(NLMSG_SPACE(sizeof(struct rtgenmsg)) \
+				 + RTA_SPACE(sizeof(int32_t)))
 
+static void netnsid_fill_request(unsigned char *req, int target_fd, uint32_t seq)
+{
 	struct nlmsghdr *nlh = (struct nlmsghdr *)req;
 	struct rtgenmsg *rt = NLMSG_DATA(req);
 	struct rtattr *rta = (struct rtattr *)
 		(req + NLMSG_SPACE(sizeof(struct rtgenmsg)));
 	int32_t *fd = RTA_DATA(rta);
 
-	nlh->nlmsg_len = sizeof(req);
+	nlh->nlmsg_len = NETNSID_REQ_SIZE;
 	nlh->nlmsg_flags = NLM_F_REQUEST;
 	nlh->nlmsg_type = RTM_GETNSID;
+	nlh->nlmsg_seq = seq;
 	rt->rtgen_family = AF_UNSPEC;
 	rta->rta_type = NETNSA_FD;
 	rta->rta_len = RTA_SPACE(sizeof(int32_t));
 	*fd = target_fd;
+}
+
+static int netnsid_parse_response(struct nlmsghdr *nlh, int *netnsid)
+{
+	struct rtattr *rta;
+	int rtalen;
 
-	if (send(netlink_fd, req, sizeof(req), 0) < 0)
+	if (nlh->nlmsg_type != RTM_NEWNSID
+	    || nlh->nlmsg_len < NLMSG_SPACE(sizeof(struct rtgenmsg)))
 		return -1;
-	return 0;
+
+	rtalen = NLMSG_PAYLOAD(nlh, sizeof(struct rtgenmsg));
+	rta = (struct rtattr *)((unsigned char *)nlh + NLMSG_SPACE(sizeof(struct rtgenmsg)));
+
+	for (; RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+		if (rta->rta_type == NETNSA_NSID) {
+			*netnsid = *(int *)RTA_DATA(rta);
+			return 0;
+		}
+	}
+	return -1;
 }
 
-static int get_netnsid_via_netlink_recv_response(int *netnsid)
+/*
+ * Resolves NETNSIDs for @n network namespace file descriptors. All the
+ * RTM_GETNSID requests are sent in one message, and the responses are matched
+ * to the requests by sequence numbers. The kernel handles the requests within
+ * send(), so the responses are already queued when it returns.
+ */
+static void get_netnsids_via_netlink(const int *target_fds, int *netnsids, size_t n)
 {
-	unsigned char res[NLMSG_SPACE(sizeof(struct rtgenmsg))
-			  + ((RTA_SPACE(sizeof(int32_t))
-			      < RTA_SPACE(sizeof(struct nlmsgerr)))
-			     ? RTA_SPACE(sizeof(struct nlmsgerr))
-			     : RTA_SPACE(sizeof(int32_t)))];
-	int rtalen;
-	ssize_t reslen;
+	unsigned char *req;
+	unsigned char res[8192] __attribute__((__aligned__(NLMSG_ALIGNTO)));
+	uint32_t seq0 = netlink_seq;
+	size_t i, nres = 0;
 
-	struct nlmsghdr *nlh;
-	struct rtattr *rta;
+	for (i = 0; i < n; i++)
+		netnsids[i] = LSNS_NETNS_UNUSABLE;
 
-	reslen = recv(netlink_fd, res, sizeof(res), 0);
-	if (reslen < 0)
-		return -1;
+	if (netlink_fd < 0 || n == 0)
+		return;
 
-	nlh = (struct nlmsghdr *)res;
-	if (!(NLMSG_OK(nlh, (size_t)reslen)
-	      && nlh->nlmsg_type == RTM_NEWNSID))
-		return -1;
+	req = xcalloc(n, NETNSID_REQ_SIZE);
+	for (i = 0; i < n; i++)
+		netnsid_fill_request(req + i * NETNSID_REQ_SIZE, target_fds[i],
+				     seq0 + i + 1);
+	netlink_seq += n;
 
-	rtalen = NLMSG_PAYLOAD(nlh, sizeof(struct rtgenmsg));
-	rta = (struct rtattr *)(res + NLMSG_SPACE(sizeof(struct rtgenmsg)));
-	if (!(RTA_OK(rta, rtalen)
-	      && rta->rta_type == NETNSA_NSID))
-		return -1;
+	if (send(netlink_fd, req, n * NETNSID_REQ_SIZE, 0) < 0)
+		goto done;
 
-	*netnsid = *(int *)RTA_DATA(rta);
+	while (nres < n) {
+		struct nlmsghdr *nlh;
+		ssize_t reslen;
+		int len;
 
-	return 0;
+		reslen = recv(netlink_fd, res, sizeof(res), MSG_DONTWAIT);
+		if (reslen < 0 && errno == EINTR)
+			continue;
+		if (reslen <= 0)
+			break;
+
+		len = reslen;
+		for (nlh = (struct nlmsghdr *)res; NLMSG_OK(nlh, len);
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			size_t idx = nlh->nlmsg_seq - seq0 - 1;
+
+			if (idx >= n)
+				continue;	/* stale response */
+			nres++;
+			netnsid_parse_response(nlh, &netnsids[idx]);
+		}
+	}
+done:
+	free(req);
 }
 
 static int get_netnsid_via_netlink(int target_fd)
 {
 	int netnsid;
 
-	if (netlink_fd < 0)
-		return LSNS_NETNS_UNUSABLE;
+	get_netnsids_via_netlink(&target_fd, &netnsid, 1);
+	return netnsid;
+}
 
-	if (get_netnsid_via_netlink_send_request(target_fd) < 0)
-		return LSNS_NETNS_UNUSABLE;
+#define NETNSID_BATCH	64
 
-	netnsid = LSNS_NETNS_UNUSABLE;
-	if (get_netnsid_via_netlink_recv_response(&netnsid) < 0)
-		return LSNS_NETNS_UNUSABLE;
+struct netnsid_batch {
+	ino_t inos[NETNSID_BATCH];
+	int fds[NETNSID_BATCH];
+	size_t n;
+};
 
-	return netnsid;
+static void netnsid_batch_flush(struct netnsid_batch *b)
+{
+	int netnsids[NETNSID_BATCH];
+	size_t i;
+
+	get_netnsids_via_netlink(b->fds, netnsids, b->n);
+	for (i = 0; i < b->n; i++) {
+		netnsid_cache_add(b->inos[i], netnsids[i]);
+		close(b->fds[i]);
+	}
+	b->n = 0;
 }
 
-static int get_netnsid_for_pc_via_netlink(struct path_cxt *pc, const char *path)
+/* Resolves NETNSIDs of the network namespaces used by the processes. */
+static void read_process_netnsids(struct lsns *ls)
 {
-	int netnsid;
-	int target_fd;
+	struct netnsid_batch b = { .n = 0 };
+	struct list_head *p;
 
 	if (netlink_fd < 0)
-		return LSNS_NETNS_UNUSABLE;
+		return;
 
-	target_fd = ul_path_open(pc, O_RDONLY, path);
-	if (target_fd < 0)
-		return LSNS_NETNS_UNUSABLE;
+	list_for_each(p, &ls->processes) {
+		struct lsns_process *proc = list_entry(p, struct lsns_process, processes);
+		ino_t ino = proc->ns_ids[LSNS_TYPE_NET];
+		char path[sizeof(_PATH_PROC) + sizeof(stringify_value(INT_MAX)) + 8];
+		int netnsid;
+		size_t i;
 
-	netnsid = get_netnsid_via_netlink(target_fd);
+		if (!ino || netnsid_cache_find(ino, &netnsid))
+			continue;
+		for (i = 0; i < b.n; i++) {
+			if (b.inos[i] == ino)
+				break;
+		}
+		if (i < b.n)
+			continue;	/* already in the batch */
 
-	close(target_fd);
-	return netnsid;
-}
+		snprintf(path, sizeof(path), _PATH_PROC "/%d/ns/net", proc->pid);
+		b.fds[b.n] = open(path, O_RDONLY | O_CLOEXEC);
+		if (b.fds[b.n] < 0) {
+			netnsid_cache_add(ino, LSNS_NETNS_UNUSABLE);
+			continue;
+		}
+		b.inos[b.n++] = ino;
+		if (b.n == NETNSID_BATCH)
+			netnsid_batch_flush(&b);
+	}
+	if (b.n)
+		netnsid_batch_flush(&b);
 
-static int get_netnsid_for_pc(struct path_cxt *pc, ino_t netino)
-{
-	int netnsid;
+	list_for_each(p, &ls->processes) {
+		struct lsns_process *proc = list_entry(p, struct lsns_process, processes);
 
-	if (!netnsid_cache_find(netino, &netnsid)) {
-		netnsid = get_netnsid_for_pc_via_netlink(pc, "ns/net");
-		netnsid_cache_add(netino, netnsid);
+		if (proc->ns_ids[LSNS_TYPE_NET])
+			netnsid_cache_find(proc->ns_ids[LSNS_TYPE_NET], &proc->netnsid);
 	}
-
-	return netnsid;
 }
 
-static void add_namespace_from_sock(struct lsns *ls, pid_t pid, uint64_t fd)
+/* Returns file descriptor of the network namespace of the socket @fd
+ * opened by the process @pid. */
+static int get_sock_netns_fd(pid_t pid, uint64_t fd)
 {
-	int pidfd, sk, nsfd;
-	struct stat sb;
+	int pidfd, sk, nsfd = -1;
 
-	/* This is additional/extra information, ignoring failures. */
 	pidfd = pidfd_open(pid, 0);
 	if (pidfd < 0)
-		return;
+		return -1;
 
 	sk = pidfd_getfd(pidfd, (int)fd, 0);
-	if (sk < 0)
-		goto out_pidfd;
-
-	nsfd = ioctl(sk, SIOCGSKNS);
-	if (nsfd < 0)
-		goto out_sk;
-
-	if (fstat(nsfd, &sb) < 0)
-		goto out_nsfd;
-
-	if (get_namespace(ls, sb.st_ino))
-		goto out_nsfd;
+	if (sk >= 0) {
+		nsfd = ioctl(sk, SIOCGSKNS);
+		close(sk);
+	}
+	close(pidfd);
+	return nsfd;
+}
 
-#ifdef USE_NS_GET_API
-	add_namespace_for_nsfd(ls, nsfd, sb.st_ino);
-#endif
+static ino_t get_sock_netns_ino(pid_t pid, uint64_t fd)
+{
+	struct stat sb;
+	int nsfd = get_sock_netns_fd(pid, fd);
+	ino_t ino = 0;
 
-out_nsfd:
+	if (nsfd < 0)
+		return 0;
+	if (fstat(nsfd, &sb) == 0)
+		ino = sb.st_ino;
 	close(nsfd);
-out_sk:
-	close(sk);
-out_pidfd:
-	close(pidfd);
+	return ino;
 }
 #else
-static int get_netnsid_for_pc(struct path_cxt *pc __attribute__((__unused__)),
-			      ino_t netino __attribute__((__unused__)))
+static void read_process_netnsids(struct lsns *ls __attribute__((__unused__)))
+{
+}
+
+static int get_sock_netns_fd(pid_t pid __attribute__((__unused__)),
+			     uint64_t fd __attribute__((__unused__)))
 {
-	return LSNS_NETNS_UNUSABLE;
+	return -1;
 }
 
-static void add_namespace_from_sock(struct lsns *ls __attribute__((__unused__)),
-				    pid_t pid __attribute__((__unused__)),
-				    uint64_t fd __attribute__((__unused__)))
+static ino_t get_sock_netns_ino(pid_t pid __attribute__((__unused__)),
+				uint64_t fd __attribute__((__unused__)))
 {
+	return 0;
 }
 #endif /* HAVE_LINUX_NET_NAMESPACE_H */
 
-/* Read namespaces open(2)ed explicitly by the process specified by `pc'. */
-static void read_opened_namespaces(struct lsns *ls, struct path_cxt *pc, pid_t pid)
+static void add_opened_ns(struct opened_nslist **list, uint64_t fd, ino_t ino, bool is_sock)
 {
+	size_t n = *list ? (*list)->nopened : 0;
+	struct opened_ns *o;
+
+	*list = xrealloc(*list, sizeof(**list) + (n + 1) * sizeof(struct opened_ns));
+	(*list)->nopened = n + 1;
+
+	o = &(*list)->opened[n];
+	o->fd = fd;
+	o->ino = ino;
+	o->is_sock = is_sock;
+}
+
+/* Read namespaces open(2)ed explicitly by the process specified by `pc'. It's
+ * called by the procfs snapshot walker threads, so the namespaces are only
+ * recorded; see add_opened_namespaces(). */
+static void *read_opened_namespaces(struct path_cxt *pc, pid_t pid, void *data)
+{
+	struct lsns *ls = data;
+	struct opened_nslist *list = NULL;
 	DIR *sub = NULL;
 	struct dirent *d = NULL;
 
@@ -648,126 +748,140 @@ static void read_opened_namespaces(struct lsns *ls, struct path_cxt *pc, pid_t p
 			continue;
 
 		if (st.st_dev == ls->nsfs_dev) {
-			if (get_namespace(ls, st.st_ino))
-				continue;
-#ifdef USE_NS_GET_API
-			int fd = ul_path_openf(pc, O_RDONLY, "fd/%ju", (uintmax_t) num);
-			if (fd >= 0) {
-				add_namespace_for_nsfd(ls, fd, st.st_ino);
-				close(fd);
-			}
-#endif
+			add_opened_ns(&list, num, st.st_ino, false);
 		} else if ((st.st_mode & S_IFMT) == S_IFSOCK) {
-			add_namespace_from_sock(ls, pid, num);
+			/* This is additional/extra information, ignoring failures. */
+			ino_t ino = get_sock_netns_ino(pid, num);
+			if (ino)
+				add_opened_ns(&list, num, ino, true);
 		}
 	}
+	return list;
 }
 
-static int read_process(struct lsns *ls, struct path_cxt *pc)
+#ifdef USE_NS_GET_API
+/* Add namespaces recorded by read_opened_namespaces(); called from the main
+ * thread only. */
+static void add_opened_namespaces(struct lsns *ls, pid_t pid,
+				  struct opened_nslist *list)
 {
-	struct lsns_process *p = NULL;
-	int rc = 0;
-	char buf[BUFSIZ];
 	size_t i;
 
-	p = xcalloc(1, sizeof(*p));
-	p->netnsid = LSNS_NETNS_UNUSABLE;
+	for (i = 0; i < list->nopened; i++) {
+		struct opened_ns *o = &list->opened[i];
+		struct stat st;
+		int fd;
 
-	if (procfs_process_get_uid(pc, &p->uid) == 0)
-		add_uid(uid_cache, p->uid);
+		if (get_namespace(ls, o->ino))
+			continue;
+		if (o->is_sock)
+			fd = get_sock_netns_fd(pid, o->fd);
+		else {
+			char path[sizeof(_PATH_PROC) + 2 * sizeof(stringify_value(UINT64_MAX)) + 8];
+
+			snprintf(path, sizeof(path), _PATH_PROC "/%d/fd/%ju",
+				 pid, (uintmax_t) o->fd);
+			fd = open(path, O_RDONLY | O_CLOEXEC);
+		}
+		if (fd < 0)
+			continue;
 
-	if ((rc = procfs_process_get_stat(pc, buf, sizeof(buf))) < 0) {
-		DBG(PROC, ul_debug("failed in procfs_process_get_stat() (rc: %d)", rc));
-		goto done;
-	}
-	if ((rc = parse_proc_stat(buf, &p->pid, &p->state, &p->ppid)) < 0) {
-		DBG(PROC, ul_debug("failed in parse_proc_stat() (rc: %d)", rc));
-		goto done;
+		/* the descriptor may be reused since read_opened_namespaces() */
+		if (fstat(fd, &st) == 0 && st.st_ino == o->ino)
+			add_namespace_for_nsfd(ls, fd, o->ino);
+		close(fd);
 	}
-	rc = 0;
-
-	for (i = 0; i < ARRAY_SIZE(p->ns_ids); i++) {
-		INIT_LIST_HEAD(&p->ns_siblings[i]);
+}
+#else
+static void add_opened_namespaces(struct lsns *ls __attribute__((__unused__)),
+				  pid_t pid __attribute__((__unused__)),
+				  struct opened_nslist *list __attribute__((__unused__)))
+{
+}
+#endif
 
-		if (!ls->fltr_types[i])
-			continue;
+static int cmp_processes_by_pid(const void *a, const void *b)
+{
+	pid_t x = (*(struct lsns_process * const *) a)->pid,
+	      y = (*(struct lsns_process * const *) b)->pid;
 
-		rc = get_ns_inos(pc, ns_names[i], &p->ns_ids[i],
-				 &p->ns_pids[i], &p->ns_oids[i]);
-		if (rc && rc != -EACCES && rc != -ENOENT && rc != ESRCH) {
-			DBG(PROC, ul_debug("failed in get_ns_inos (rc: %d)", rc));
-			goto done;
-		}
-		if (p->ns_ids[i] && i == LSNS_TYPE_NET)
-			p->netnsid = get_netnsid_for_pc(pc, p->ns_ids[i]);
-		rc = 0;
-	}
+	return x < y ? -1 : x > y ? 1 : 0;
+}
 
-	INIT_LIST_HEAD(&p->processes);
+/* Sets proc->parent for all processes. */
+static void connect_processes(struct lsns *ls, size_t nprocs)
+{
+	struct lsns_process **procs, *key, **parent;
+	struct lsns_process k;
+	struct list_head *p;
+	size_t i = 0;
 
-	DBG(PROC, ul_debugobj(p, "new pid=%d", p->pid));
-	list_add_tail(&p->processes, &ls->processes);
+	if (!nprocs)
+		return;
 
-	read_opened_namespaces(ls, pc, p->pid);
-done:
-	if (rc)
-		free(p);
-	return rc;
+	procs = xcalloc(nprocs, sizeof(*procs));
+	list_for_each(p, &ls->processes)
+		procs[i++] = list_entry(p, struct lsns_process, processes);
+	qsort(procs, nprocs, sizeof(*procs), cmp_processes_by_pid);
+
+	key = &k;
+	for (i = 0; i < nprocs; i++) {
+		k.pid = procs[i]->ppid;
+		parent = bsearch(&key, procs, nprocs, sizeof(*procs), cmp_processes_by_pid);
+		if (parent && *parent != procs[i])
+			procs[i]->parent = *parent;
+	}
+	free(procs);
 }
 
+/*
+ * The processes are read by one procfs snapshot; the snapshot walker threads
+ * also read the namespaces opened by the processes.
+ */
 static int read_processes(struct lsns *ls)
 {
-	DIR *dir;
-	struct dirent *d;
-	int rc = 0;
-	struct path_cxt *pc;
+	struct procfs_snapshot *snap;
+	size_t i, t;
 
-	DBG(PROC, ul_debug("opening /proc"));
+	DBG(PROC, ul_debug("reading /proc"));
 
-	dir = opendir(_PATH_PROC);
-	if (!dir)
+	snap = ul_new_procfs_snapshot_reader(
+			PROCFS_SNAP_STAT | PROCFS_SNAP_UID | PROCFS_SNAP_NS, 0,
+			read_opened_namespaces, ls);
+	if (!snap)
 		return -errno;
 
-	pc = ul_new_path(NULL);
-	if (!pc)
-		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
+	for (i = 0; i < snap->nprocs; i++) {
+		struct lsns_process *p = xcalloc(1, sizeof(*p));
 
-	while ((d = xreaddir(dir))) {
-		pid_t pid = 0;
+		p->pid = snap->pids[i];
+		p->ppid = snap->ppids[i];
+		p->state = snap->states[i];
+		p->uid = snap->uids[i];
+		p->netnsid = LSNS_NETNS_UNUSABLE;
 
-		if (procfs_dirent_get_pid(d, &pid) != 0)
-			continue;
-
-		DBG(PROC, ul_debug("reading %d", (int) pid));
-		rc = procfs_process_init_path(pc, pid);
-		if (rc < 0) {
-			DBG(PROC, ul_debug("failed in initializing path_cxt for /proc/%d (rc: %d)", (int) pid, rc));
-			/* This failure is acceptable. If a process ($pid) owning
-			 * a namespace is gone while running this lsns process,
-			 * procfs_process_init_path(pc, $pid) may fail.
-			 *
-			 * We must reset this `rc' here. If this `d' is the last
-			 * dentry in `dir', this read_processes() invocation
-			 * returns this `rc'. In the caller context, the
-			 * non-zero value returned from read_processes() makes
-			 * lsns prints nothing. We should avoid the behavior. */
-			rc = 0;
-			continue;
+		for (t = 0; t < ARRAY_SIZE(p->ns_ids); t++) {
+			INIT_LIST_HEAD(&p->ns_siblings[t]);
+			if (ls->fltr_types[t])
+				p->ns_ids[t] = snap->ns_inos[procfs_ns_types[t]][i];
 		}
+		INIT_LIST_HEAD(&p->processes);
 
-		rc = read_process(ls, pc);
-		if (rc && rc != -EACCES && rc != -ENOENT && rc != ESRCH) {
-			DBG(PROC, ul_debug("failed in read_process() (pid: %d, rc: %d)", (int) pid, rc));
-			break;
-		}
-		rc = 0;
+		DBG(PROC, ul_debugobj(p, "new pid=%d", p->pid));
+		list_add_tail(&p->processes, &ls->processes);
+		add_uid(uid_cache, p->uid);
 	}
 
-	ul_unref_path(pc);
+	connect_processes(ls, snap->nprocs);
+	read_process_netnsids(ls);
 
-	DBG(PROC, ul_debug("closing /proc"));
-	closedir(dir);
-	return rc;
+	for (i = 0; i < snap->nprocs; i++) {
+		if (snap->priv[i])
+			add_opened_namespaces(ls, snap->pids[i], snap->priv[i]);
+	}
+
+	ul_free_procfs_snapshot(snap);
+	return 0;
 }
 
 static int namespace_has_process(struct lsns_namespace *ns, pid_t pid)
@@ -803,25 +917,17 @@ static struct lsns_namespace *add_namespace(struct lsns *ls, enum lsns_type type
 	ns->netnsid = netnsid;
 
 	list_add_tail(&ns->namespaces, &ls->namespaces);
+	if (!tsearch(ns, &ls->ns_index, cmp_namespace_ids))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
 	return ns;
 }
 
-static int add_process_to_namespace(struct lsns *ls, struct lsns_namespace *ns, struct lsns_process *proc)
+static int add_process_to_namespace(struct lsns_namespace *ns, struct lsns_process *proc)
 {
-	struct list_head *p;
-
 	DBG(NS, ul_debugobj(ns, "add process [%p] pid=%d to %s[%ju]",
 		proc, proc->pid, ns_names[ns->type], (uintmax_t)ns->id));
 
-	list_for_each(p, &ls->processes) {
-		struct lsns_process *xproc = list_entry(p, struct lsns_process, processes);
-
-		if (xproc->pid == proc->ppid)		/* my parent */
-			proc->parent = xproc;
-		else if (xproc->ppid == proc->pid)	/* my child */
-			xproc->parent = proc;
-	}
-
+	/* proc->parent is set by connect_processes() */
 	list_add_tail(&proc->ns_siblings[ns->type], &ns->processes);
 	ns->nprocs++;
 
@@ -1082,13 +1188,16 @@ static int read_assigned_namespaces(struct lsns *ls)
 				int netnsid = (i == LSNS_TYPE_NET)
 					? proc->netnsid
 					: LSNS_NETNS_UNUSABLE;
+				ino_t pino, oino;
+
+				get_related_ns_inos(proc->pid, i, proc->ns_ids[i],
+						    &pino, &oino);
 				ns = add_namespace(ls, i, proc->ns_ids[i],
-						   proc->ns_pids[i], proc->ns_oids[i],
-						   netnsid);
+						   pino, oino, netnsid);
 				if (!ns)
 					return -ENOMEM;
 			}
-			add_process_to_namespace(ls, ns, proc);
+			add_process_to_namespace(ns, proc);
 		}
 	}
 	return 0;
@@ -1526,11 +1635,15 @@ static void free_lsns_process(struct lsns_process *lsns_p)
 	free(lsns_p);
 }
 
-static void free_netnsid_caches(struct netnsid_cache *cache)
+static void free_netnsid_cache(void *cache)
 {
 	free(cache);
 }
 
+static void free_nothing(void *data __attribute__((__unused__)))
+{
+}
+
 static void free_lsns_namespace(struct lsns_namespace *lsns_n)
 {
 	free(lsns_n);
@@ -1539,7 +1652,8 @@ static void free_lsns_namespace(struct lsns_namespace *lsns_n)
 static void free_all(struct lsns *ls)
 {
 	list_free(&ls->processes, struct lsns_process, processes, free_lsns_process);
-	list_free(&netnsids_cache, struct netnsid_cache, netnsids, free_netnsid_caches);
+	tdestroy(netnsids_cache, free_netnsid_cache);
+	tdestroy(ls->ns_index, free_nothing);
 	list_free(&ls->namespaces, struct lsns_namespace, namespaces, free_lsns_namespace);
 }
 
@@ -1664,7 +1778,6 @@ int main(int argc, char *argv[])
 
 	INIT_LIST_HEAD(&ls.processes);
 	INIT_LIST_HEAD(&ls.namespaces);
-	INIT_LIST_HEAD(&netnsids_cache);
 
 	while ((c = getopt_long(argc, argv,
 				"JlPp:o:nruhVt:T::WQ:H", long_opts, NULL)) != -1) {
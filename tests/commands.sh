@@ -6,6 +6,8 @@ TS_HELPER_BOILERPLATE="${ts_helpersdir}test_boilerplate"
 TS_HELPER_BYTESWAP="${ts_helpersdir}test_byteswap"
 TS_HELPER_CPUSET="${ts_helpersdir}test_cpuset"
 TS_HELPER_CAP="${ts_helpersdir}test_cap"
+TS_HELPER_CLONERANGE="${ts_helpersdir}test_clonerange"
+TS_HELPER_DIRWALK="${ts_helpersdir}test_dirwalk"
 TS_HELPER_DMESG="${ts_helpersdir}test_dmesg"
 TS_HELPER_ENOSYS="${ts_helpersdir}test_enosys"
 TS_HELPER_ISLOCAL="${ts_helpersdir}test_islocal"
@@ -44,6 +46,7 @@ TS_HELPER_SHA1="${ts_helpersdir}test_sha1"
 TS_HELPER_MKFS_MINIX="${ts_helpersdir}test_mkfs_minix"
 TS_HELPER_MORE=${TS_HELPER_MORE-"${ts_helpersdir}test_more"}
 TS_HELPER_PARTITIONS="${ts_helpersdir}sample-partitions"
+TS_HELPER_PATH="${ts_helpersdir}test_path"
 TS_HELPER_PATHS="${ts_helpersdir}test_pathnames"
 TS_HELPER_SCRIPT="${ts_helpersdir}test_script"
 TS_HELPER_SIGRECEIVE="${ts_helpersdir}test_sigreceive"
@@ -55,12 +58,14 @@ TS_HELPER_TIOCSTI="${ts_helpersdir}test_tiocsti"
 TS_HELPER_UUID_PARSER="${ts_helpersdir}test_uuid_parser"
 TS_HELPER_UUID_NAMESPACE="${ts_helpersdir}test_uuid_namespace"
 TS_HELPER_UUID_TIME="${ts_helpersdir}test_uuid_time"
+TS_HELPER_UUIDD="${ts_helpersdir}test_uuidd"
 TS_HELPER_MBSENCODE="${ts_helpersdir}test_mbsencode"
 TS_HELPER_CAL="${ts_helpersdir}test_cal"
 TS_HELPER_LAST_FUZZ="${ts_helpersdir}test_last_fuzz"
 TS_HELPER_MKFDS="${ts_helpersdir}test_mkfds"
 TS_HELPER_BLKID_FUZZ="${ts_helpersdir}test_blkid_fuzz"
 TS_HELPER_PROCFS="${ts_helpersdir}test_procfs"
+TS_HELPER_PROCFS_SNAPSHOT="${ts_helpersdir}test_procfs_snapshot"
 TS_HELPER_TIMEUTILS="${ts_helpersdir}test_timeutils"
 
 # paths to commands
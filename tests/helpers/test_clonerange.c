@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * test_clonerange - clone a range of a file to the beginning of another file
+ *
+ * This file is part of util-linux.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#include "c.h"
+#include "strutils.h"
+
+int main(int argc, char **argv)
+{
+#ifdef FICLONERANGE
+	struct file_clone_range range = { 0 };
+	int src, dst;
+
+	if (argc != 5)
+		errx(EXIT_FAILURE, "usage: %s <source> <offset> <length> <destination>",
+		     program_invocation_short_name);
+
+	src = open(argv[1], O_RDONLY);
+	if (src < 0)
+		err(EXIT_FAILURE, "cannot open %s", argv[1]);
+	dst = open(argv[4], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (dst < 0)
+		err(EXIT_FAILURE, "cannot open %s", argv[4]);
+
+	range.src_fd = src;
+	range.src_offset = strtou64_or_err(argv[2], "failed to parse offset");
+	range.src_length = strtou64_or_err(argv[3], "failed to parse length");
+
+	if (ioctl(dst, FICLONERANGE, &range) != 0)
+		err(EXIT_FAILURE, "FICLONERANGE failed");
+
+	close(src);
+	if (close(dst) != 0)
+		err(EXIT_FAILURE, "write failed: %s", argv[4]);
+	return EXIT_SUCCESS;
+#else
+	errx(EXIT_FAILURE, "FICLONERANGE is not supported");
+#endif
+}